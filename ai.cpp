@@ -1,5 +1,5 @@
 #include "chess.h"
-#include <unordered_map>
+#include <cmath>
 #include <mutex>
 #include <chrono>
 
@@ -14,186 +14,145 @@ struct TTEntry {
     Move bestMove;
 };
 
-static std::unordered_map<uint64_t, TTEntry> tt;
-static std::mutex ttMutex;
-static bool zobristInitialized = false;
-
-// Piece-square tables (from white's perspective). Mirror for black in evaluation.
-static const int PST_PAWN[8][8] = {
-    {  0,  0,  0,  0,  0,  0,  0,  0},
-    { 50, 50, 50, 50, 50, 50, 50, 50},
-    { 10, 10, 20, 30, 30, 20, 10, 10},
-    {  5,  5, 10, 25, 25, 10,  5,  5},
-    {  0,  0,  0, 20, 20,  0,  0,  0},
-    {  5, -5,-10,  0,  0,-10, -5,  5},
-    {  5, 10, 10,-20,-20, 10, 10,  5},
-    {  0,  0,  0,  0,  0,  0,  0,  0}
-};
-static const int PST_KNIGHT[8][8] = {
-    {-50,-40,-30,-30,-30,-30,-40,-50},
-    {-40,-20,  0,  0,  0,  0,-20,-40},
-    {-30,  0, 10, 15, 15, 10,  0,-30},
-    {-30,  5, 15, 20, 20, 15,  5,-30},
-    {-30,  0, 15, 20, 20, 15,  0,-30},
-    {-30,  5, 10, 15, 15, 10,  5,-30},
-    {-40,-20,  0,  5,  5,  0,-20,-40},
-    {-50,-40,-30,-30,-30,-30,-40,-50}
-};
-static const int PST_BISHOP[8][8] = {
-    {-20,-10,-10,-10,-10,-10,-10,-20},
-    {-10,  0,  0,  0,  0,  0,  0,-10},
-    {-10,  0,  5, 10, 10,  5,  0,-10},
-    {-10,  5,  5, 10, 10,  5,  5,-10},
-    {-10,  0, 10, 10, 10, 10,  0,-10},
-    {-10, 10, 10, 10, 10, 10, 10,-10},
-    {-10,  5,  0,  0,  0,  0,  5,-10},
-    {-20,-10,-10,-10,-10,-10,-10,-20}
-};
-static const int PST_ROOK[8][8] = {
-    {  0,  0,  0,  5,  5,  0,  0,  0},
-    {-5,  0,  0,  0,  0,  0,  0, -5},
-    {-5,  0,  0,  0,  0,  0,  0, -5},
-    {-5,  0,  0,  0,  0,  0,  0, -5},
-    {-5,  0,  0,  0,  0,  0,  0, -5},
-    {-5,  0,  0,  0,  0,  0,  0, -5},
-    {  5, 10, 10, 10, 10, 10, 10,  5},
-    {  0,  0,  0,  0,  0,  0,  0,  0}
-};
-static const int PST_QUEEN[8][8] = {
-    {-20,-10,-10, -5, -5,-10,-10,-20},
-    {-10,  0,  0,  0,  0,  0,  0,-10},
-    {-10,  0,  5,  5,  5,  5,  0,-10},
-    { -5,  0,  5,  5,  5,  5,  0, -5},
-    {  0,  0,  5,  5,  5,  5,  0, -5},
-    {-10,  5,  5,  5,  5,  5,  0,-10},
-    {-10,  0,  5,  0,  0,  0,  0,-10},
-    {-20,-10,-10, -5, -5,-10,-10,-20}
-};
-static const int PST_KING[8][8] = {
-    {-30,-40,-40,-50,-50,-40,-40,-30},
-    {-30,-40,-40,-50,-50,-40,-40,-30},
-    {-30,-40,-40,-50,-50,-40,-40,-30},
-    {-30,-40,-40,-50,-50,-40,-40,-30},
-    {-20,-30,-30,-40,-40,-30,-30,-20},
-    {-10,-20,-20,-20,-20,-20,-20,-10},
-    { 20, 20,  0,  0,  0,  0, 20, 20},
-    { 20, 30, 10,  0,  0, 10, 30, 20}
-};
+static TranspositionTable ttG;
+static std::once_flag zobristOnce, ttOnce;
+
+// Piece base values (centipawns)
+int pieceValue(PieceType t){ return evalWeightsG.piece[t]; }
 
-// Return PST value signed from perspective of side: positive for white advantage when white piece on a good square,
-// negative for black advantage (we'll add/subtract based on piece color in EvaluateBoard).
-inline int PSTValue(PieceType pt, int x, int y, Color col){
-    if(pt==PT_NONE) return 0;
-    int base = 0;
-    if(col==C_WHITE){
-        switch(pt){
-            case PT_PAWN:   base = PST_PAWN[y][x]; break;
-            case PT_KNIGHT: base = PST_KNIGHT[y][x]; break;
-            case PT_BISHOP: base = PST_BISHOP[y][x]; break;
-            case PT_ROOK:   base = PST_ROOK[y][x]; break;
-            case PT_QUEEN:  base = PST_QUEEN[y][x]; break;
-            case PT_KING:   base = PST_KING[y][x]; break;
-            default: break;
+// squares a piece attacks or can move to (cheap mobility approximation)
+static int PieceMobility(const Piece b[8][8], int x, int y){
+    Piece p = b[y][x];
+    int mob = 0;
+    if(p.type==PT_KNIGHT){
+        const int kx[8] = {1,2,2,1,-1,-2,-2,-1};
+        const int ky[8] = {-2,-1,1,2,2,1,-1,-2};
+        for(int i=0;i<8;i++){ int nx=x+kx[i], ny=y+ky[i]; if(nx>=0&&nx<8&&ny>=0&&ny<8) if(b[ny][nx].color!=p.color) mob++; }
+    } else if(p.type==PT_BISHOP || p.type==PT_ROOK || p.type==PT_QUEEN){
+        const std::vector<std::pair<int,int>> dirs = (p.type==PT_BISHOP? std::vector<std::pair<int,int>>{{1,1},{1,-1},{-1,1},{-1,-1}} :
+            (p.type==PT_ROOK? std::vector<std::pair<int,int>>{{1,0},{-1,0},{0,1},{0,-1}} :
+            std::vector<std::pair<int,int>>{{1,1},{1,-1},{-1,1},{-1,-1},{1,0},{-1,0},{0,1},{0,-1}}));
+        for(auto d: dirs){
+            int nx=x+d.first, ny=y+d.second;
+            while(nx>=0&&nx<8&&ny>=0&&ny<8){
+                if(b[ny][nx].type==PT_NONE) mob++;
+                else { if(b[ny][nx].color!=p.color) mob++; break; }
+                nx+=d.first; ny+=d.second;
+            }
         }
-        return base;
-    } else {
-        int my = 7 - y;
-        switch(pt){
-            case PT_PAWN:   base = PST_PAWN[my][x]; break;
-            case PT_KNIGHT: base = PST_KNIGHT[my][x]; break;
-            case PT_BISHOP: base = PST_BISHOP[my][x]; break;
-            case PT_ROOK:   base = PST_ROOK[my][x]; break;
-            case PT_QUEEN:  base = PST_QUEEN[my][x]; break;
-            case PT_KING:   base = PST_KING[my][x]; break;
-            default: break;
+    } else if(p.type==PT_PAWN){
+        int dir = (p.color==C_WHITE? -1: 1);
+        int ny = y + dir;
+        if(ny>=0 && ny<8){
+            if(x-1>=0 && b[ny][x-1].color!=p.color) mob++;
+            if(x+1<8  && b[ny][x+1].color!=p.color) mob++;
+            if(b[ny][x].type==PT_NONE) mob++;
+        }
+    } else if(p.type==PT_KING){
+        for(int dx=-1;dx<=1;dx++) for(int dy=-1;dy<=1;dy++){
+            if(dx==0 && dy==0) continue;
+            int nx=x+dx, ny=y+dy;
+            if(nx>=0&&nx<8&&ny>=0&&ny<8) if(b[ny][nx].color!=p.color) mob++;
         }
-        // For black pieces, a positive PST base is good for black — but EvaluateBoard handles sign by subtracting for black.
-        return base;
     }
+    return mob;
 }
 
-// Piece base values (centipawns)
-int pieceValue(PieceType t){
-    switch(t){ case PT_PAWN: return 100; case PT_KNIGHT: return 320; case PT_BISHOP: return 330;
-        case PT_ROOK: return 500; case PT_QUEEN: return 900; case PT_KING: return 20000; default: return 0; }
-}
-
-// Improved EvaluateBoard: clear, consistent sign handling and small improvements
-int EvaluateBoard(const Piece b[8][8]){
+// Material + piece-square tables + mobility, positive when White is better.
+// Linear in the weights: EvalFeatures below lists the coefficient of each one.
+// This square-by-square version is the reference the bitboard kernels (evalbb.cpp) must match.
+int EvaluateBoardReference(const Piece b[8][8], const EvalWeights &w){
     int score = 0;
     int mobilityWhite = 0, mobilityBlack = 0;
     for(int y=0;y<8;y++){
         for(int x=0;x<8;x++){
             Piece p = b[y][x];
             if(p.type==PT_NONE) continue;
-            int material = pieceValue(p.type);
-            int pst = PSTValue(p.type, x, y, p.color);
-            if(p.color==C_WHITE){
-                score += material;
-                score += pst;
-            } else {
-                score -= material;
-                score -= pst;
-            }
-
-            // mobility approximation (cheap)
-            int mob = 0;
-            if(p.type==PT_KNIGHT){
-                const int kx[8] = {1,2,2,1,-1,-2,-2,-1};
-                const int ky[8] = {-2,-1,1,2,2,1,-1,-2};
-                for(int i=0;i<8;i++){ int nx=x+kx[i], ny=y+ky[i]; if(nx>=0&&nx<8&&ny>=0&&ny<8) if(b[ny][nx].color!=p.color) mob++; }
-            } else if(p.type==PT_BISHOP || p.type==PT_ROOK || p.type==PT_QUEEN){
-                const std::vector<std::pair<int,int>> dirs = (p.type==PT_BISHOP? std::vector<std::pair<int,int>>{{1,1},{1,-1},{-1,1},{-1,-1}} :
-                    (p.type==PT_ROOK? std::vector<std::pair<int,int>>{{1,0},{-1,0},{0,1},{0,-1}} :
-                    std::vector<std::pair<int,int>>{{1,1},{1,-1},{-1,1},{-1,-1},{1,0},{-1,0},{0,1},{0,-1}}));
-                for(auto d: dirs){
-                    int nx=x+d.first, ny=y+d.second;
-                    while(nx>=0&&nx<8&&ny>=0&&ny<8){
-                        if(b[ny][nx].type==PT_NONE) mob++;
-                        else { if(b[ny][nx].color!=p.color) mob++; break; }
-                        nx+=d.first; ny+=d.second;
-                    }
-                }
-            } else if(p.type==PT_PAWN){
-                int dir = (p.color==C_WHITE? -1: 1);
-                int ny = y + dir;
-                if(ny>=0 && ny<8){
-                    if(x-1>=0 && b[ny][x-1].color!=p.color) mob++;
-                    if(x+1<8  && b[ny][x+1].color!=p.color) mob++;
-                    if(b[ny][x].type==PT_NONE) mob++;
-                }
-            } else if(p.type==PT_KING){
-                for(int dx=-1;dx<=1;dx++) for(int dy=-1;dy<=1;dy++){
-                    if(dx==0 && dy==0) continue;
-                    int nx=x+dx, ny=y+dy;
-                    if(nx>=0&&nx<8&&ny>=0&&ny<8) if(b[ny][nx].color!=p.color) mob++;
-                }
-            }
-            if(p.color==C_WHITE) mobilityWhite += mob; else mobilityBlack += mob;
+            int v = w.piece[p.type] + w.pst[p.type][p.color==C_WHITE ? y : 7-y][x];
+            int mob = PieceMobility(b, x, y);
+            if(p.color==C_WHITE){ score += v; mobilityWhite += mob; }
+            else { score -= v; mobilityBlack += mob; }
         }
     }
-    score += (mobilityWhite - mobilityBlack) * 4;
+    score += (mobilityWhite - mobilityBlack) * w.mobility;
     return score;
 }
 
-int EvalForSide(const Piece b[8][8], Color side){ int v = EvaluateBoard(b); return (side==C_WHITE)?v:-v; }
-
-// ---------------- Zobrist hashing ----------------
-
-// Initialize zobrist table once
-static void InitZobristIfNeeded() {
-    if (zobristInitialized) return;
-    std::uniform_int_distribution<uint64_t> dist(0, UINT64_MAX);
+// EvaluateBoardReference(b, w) == sum of count * EvalParam(w, param) over the returned pairs
+void EvalFeatures(const Piece b[8][8], std::vector<std::pair<int,int>> &out){
+    int counts[EVAL_PARAM_COUNT] = {};
     for(int y=0;y<8;y++){
         for(int x=0;x<8;x++){
-            for(int k=0;k<12;k++){
-                zobristTable[y][x][k] = dist(rng);
-            }
+            Piece p = b[y][x];
+            if(p.type==PT_NONE) continue;
+            int sign = p.color==C_WHITE ? 1 : -1;
+            counts[p.type] += sign;
+            counts[PST_PARAM + p.type*64 + (p.color==C_WHITE ? y : 7-y)*8 + x] += sign;
+            counts[MOBILITY_PARAM] += sign * PieceMobility(b, x, y);
         }
     }
-    zobristInitialized = true;
+    out.clear();
+    for(int i=0;i<EVAL_PARAM_COUNT;i++) if(counts[i]) out.push_back({i, counts[i]});
 }
 
+// Bitbase positions get a known score instead of the heuristic one. Wins carry a progress term
+// (pawn advance, lone king pushed to the edge and approached) so the search still converts them.
+static const int KNOWN_WIN = 10000;
+static int BitbaseScore(const Piece b[8][8], Color side, int result){
+    if(result==0) return 0;
+    Color strong = result>0 ? side : Opp(side);
+    int sx=0, sy=0, wx=0, wy=0, progress = 0;
+    FindKing(b, strong, sx, sy);
+    FindKing(b, Opp(strong), wx, wy);
+    for(int y=0;y<8;y++) for(int x=0;x<8;x++)
+        if(b[y][x].type==PT_PAWN) progress += 20 * (strong==C_WHITE ? 6-y : y-1);
+    progress += 10 * (std::max(3-wx, wx-4) + std::max(3-wy, wy-4));
+    progress += 5 * (7 - std::max(abs(sx-wx), abs(sy-wy)));
+    return result>0 ? KNOWN_WIN + progress : -(KNOWN_WIN + progress);
+}
+
+int EvalForSide(const Piece b[8][8], Color side, const EvalWeights &w){
+    int known;
+    if(ProbeBitbase(b, side, known)) return BitbaseScore(b, side, known);
+    int v = EvaluateBoard(b, w); return (side==C_WHITE)?v:-v;
+}
+
+// the evaluation a search uses: the bitbases when they cover the position, else its network
+// if it has one, else its classical weights through the dispatched kernel
+static int EvalCtx(SearchContext &ctx, const Piece b[8][8], Color side){
+    int known;
+    if(ProbeBitbase(b, side, known)) return BitbaseScore(b, side, known);
+    const NnueNet *net = ctx.net ? ctx.net : ActiveNnue();
+    if(net) return NnueEvaluate(*net, b, side);
+    int v = EvaluateBoard(b, ctx.weights ? *ctx.weights : evalWeightsG);
+    return side==C_WHITE ? v : -v;
+}
+
+// ---------------- Zobrist hashing ----------------
+
+// Keys come from a fixed seed, so hashes are the same in every run and a saved table stays
+// valid (mt19937_64 output is fixed by the standard, so every build agrees).
+static uint64_t zobristSeedG = 0x5EEDC0DE2024ULL;
+
+static void FillZobrist(uint64_t seed){
+    std::mt19937_64 gen(seed);
+    for(int y=0;y<8;y++) for(int x=0;x<8;x++) for(int k=0;k<12;k++) zobristTable[y][x][k] = gen();
+}
+
+// Initialize zobrist table once (several search threads may get here together)
+static void InitZobristIfNeeded() {
+    std::call_once(zobristOnce, [](){ FillZobrist(zobristSeedG); });
+}
+
+// Not while searching; existing table entries no longer match afterwards.
+void SetZobristSeed(uint64_t seed){
+    std::call_once(zobristOnce, [](){});
+    zobristSeedG = seed;
+    FillZobrist(seed);
+}
+
+uint64_t ZobristSeed(){ return zobristSeedG; }
+
 // Map piece (type+color) to index 0..11: white(PAWN..KING)=0..5, black = 6..11
 static inline int PieceIndex(const Piece &p){
     if(p.type==PT_NONE) return -1;
@@ -216,6 +175,240 @@ uint64_t ComputeZobrist(const Piece b[8][8], Color sideToMove){
     return h;
 }
 
+// ---------------- Transposition table ----------------
+
+// 18-bit move: valid 0, from 1-6, to 7-12, promotion 13-15, en passant 16, castle 17; 0 = none
+uint32_t PackMove(const Move &m){
+    if(m.fx==-1) return 0;
+    return 1 | (uint32_t)m.fx<<1 | (uint32_t)m.fy<<4 | (uint32_t)m.tx<<7 | (uint32_t)m.ty<<10 |
+           (uint32_t)m.promoteTo<<13 | (uint32_t)m.isEnPassant<<16 | (uint32_t)m.isCastle<<17;
+}
+
+Move UnpackMove(uint32_t mv){
+    Move m;
+    if(mv & 1){
+        m = Move((int)(mv>>1)&7, (int)(mv>>4)&7, (int)(mv>>7)&7, (int)(mv>>10)&7);
+        m.promoteTo = (PieceType)((mv>>13) & 7);
+        m.isEnPassant = (mv>>16) & 1;
+        m.isCastle = (mv>>17) & 1;
+    }
+    return m;
+}
+
+// Slot data layout: value 0-31, depth 32-39, flag 40-41, move 42-59, generation 60-63
+static const uint32_t TT_FILE_VERSION = 1; // of saved and shared tables; bump with the layout
+static uint64_t PackTT(const TTEntry &e, uint8_t gen){
+    uint64_t d = (uint32_t)e.value;
+    d |= (uint64_t)(uint8_t)std::max(0, std::min(255, e.depth)) << 32;
+    d |= (uint64_t)(e.flag & 3) << 40;
+    d |= (uint64_t)PackMove(e.bestMove) << 42;
+    d |= (uint64_t)(gen & 15) << 60;
+    return d;
+}
+
+static TTEntry UnpackTT(uint64_t d){
+    TTEntry e;
+    e.value = (int32_t)(uint32_t)d;
+    e.depth = (int)((d>>32) & 255);
+    e.flag = (uint8_t)((d>>40) & 3);
+    e.bestMove = UnpackMove((uint32_t)((d>>42) & 0x3FFFF));
+    return e;
+}
+
+static size_t SlotCountFor(size_t mb){
+    size_t want = std::max<size_t>(1, mb) * 1024 * 1024 / sizeof(TTSlot);
+    size_t count = 2;
+    while(count*2 <= want) count *= 2;
+    return count;
+}
+
+static int InitThreads(){ return parallelInitG ? (int)std::max(1u, std::thread::hardware_concurrency()) : 1; }
+
+// Makes the table private with this many empty slots (detaching it from any shared segment),
+// halving the count while the memory cannot be had. Zero bytes are empty slots, so a fresh
+// block needs no initialising; --parallel-init still writes it to place its pages.
+static void AllocateTT(TranspositionTable &table, size_t count){
+    table.shared.reset();
+    table.heap.reset();
+    std::unique_ptr<LargeMemory> mem(new LargeMemory);
+    while(!AllocateLarge(*mem, count*sizeof(TTSlot)) && count > 2) count /= 2;
+    if(parallelInitG) FirstTouch(*mem, InitThreads());
+    table.heap = std::move(mem);
+    table.slots = (TTSlot*)table.heap->data;
+    table.count = count;
+    table.generation = 0;
+}
+
+void ResizeTT(TranspositionTable &table, size_t mb){ AllocateTT(table, SlotCountFor(mb)); }
+
+// Shared table segment: this header, then the slots. The creating process fills the header in
+// and sets ready last; the others wait for that, then check they build the same keys.
+struct SharedTTHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t zobristSeed;
+    uint64_t count;
+    std::atomic<uint32_t> generation; // advanced by every search of every process
+    std::atomic<uint32_t> ready;
+    uint8_t reserved[32];
+};
+static_assert(sizeof(SharedTTHeader)==64, "slots start on a cache line");
+static_assert(sizeof(TTSlot)==16 && std::atomic<uint64_t>::is_always_lock_free, "slots are plain lock-free words, valid in any process");
+static const char SHARED_TT_MAGIC[4] = { 'C', 'T', 'S', '1' };
+
+static SharedTTHeader *SharedHeader(TranspositionTable &table){
+    return table.shared ? (SharedTTHeader*)table.shared->data : nullptr;
+}
+
+// A shared table is not wiped, since other processes are using it: a new generation just
+// marks everything in it as replaceable.
+void ClearTT(TranspositionTable &table){
+    if(SharedTTHeader *h = SharedHeader(table)){
+        table.generation = (uint8_t)(h->generation.fetch_add(1) + 1);
+        return;
+    }
+    if(table.heap) FirstTouch(*table.heap, InitThreads());
+    table.generation = 0;
+}
+
+std::string DescribeTT(const TranspositionTable &table){
+    if(table.shared) return std::to_string(table.count*sizeof(TTSlot) >> 20) + " MB in shared memory";
+    return table.heap ? DescribeLarge(*table.heap) : "none";
+}
+
+// Several threads may start searches on one table at once, so the bump is atomic either way.
+void NextTTGeneration(TranspositionTable &table){
+    if(SharedTTHeader *h = SharedHeader(table)) table.generation = (uint8_t)(h->generation.fetch_add(1) + 1);
+    else table.generation.fetch_add(1, std::memory_order_relaxed);
+}
+
+// Maps the table onto the named segment, creating it with mb megabytes if no process has yet;
+// otherwise the table takes the segment's size. A new segment's zero bytes are empty slots.
+// Fails, leaving the table as it was, when the segment was built for other Zobrist keys or
+// another slot layout.
+bool AttachSharedTT(TranspositionTable &table, const std::string &name, size_t mb){
+    size_t count = SlotCountFor(mb);
+    std::unique_ptr<SharedMemory> shm(new SharedMemory);
+    if(!OpenSharedMemory(*shm, name, sizeof(SharedTTHeader) + count*sizeof(TTSlot)) || shm->size < sizeof(SharedTTHeader)) return false;
+    SharedTTHeader *h = (SharedTTHeader*)shm->data;
+    if(shm->created){
+        std::memcpy(h->magic, SHARED_TT_MAGIC, 4);
+        h->version = TT_FILE_VERSION;
+        h->zobristSeed = ZobristSeed();
+        h->count = count;
+        h->ready.store(1, std::memory_order_release);
+    } else {
+        for(int i=0; i<2000 && !h->ready.load(std::memory_order_acquire); i++)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        if(!h->ready.load(std::memory_order_acquire) || std::memcmp(h->magic, SHARED_TT_MAGIC, 4) ||
+           h->version!=TT_FILE_VERSION || h->zobristSeed!=ZobristSeed()) return false;
+        count = (size_t)h->count;
+        if(count<2 || (count & (count-1)) || shm->size < sizeof(SharedTTHeader) + count*sizeof(TTSlot)) return false;
+    }
+    table.heap.reset();
+    table.slots = (TTSlot*)(shm->data + sizeof(SharedTTHeader));
+    table.count = count;
+    table.generation = (uint8_t)h->generation.load();
+    table.shared = std::move(shm);
+    return true;
+}
+
+bool RemoveSharedTT(const std::string &name){ return RemoveSharedMemory(name); }
+
+void ClearTT(){ std::call_once(ttOnce, [](){ ResizeTT(ttG, 16); }); ClearTT(ttG); }
+
+void SetHashSize(size_t mb){ std::call_once(ttOnce, [](){}); ResizeTT(ttG, mb); }
+
+// Snapshot file: this header, then every slot as stored (key^data, data), in native byte order.
+// A table is only valid with the keys it was built with, so the Zobrist seed must match.
+struct TTFileHeader {
+    char magic[4];
+    uint32_t version;
+    uint64_t zobristSeed;
+    uint64_t count;
+    uint32_t generation;
+    uint32_t reserved;
+};
+static const char TT_MAGIC[4] = { 'C', 'T', 'T', '1' };
+
+bool SaveTT(const TranspositionTable &table, const std::string &path){
+    FILE *f = std::fopen(path.c_str(), "wb");
+    if(!f) return false;
+    TTFileHeader h = {};
+    std::memcpy(h.magic, TT_MAGIC, 4);
+    h.version = TT_FILE_VERSION;
+    h.zobristSeed = ZobristSeed();
+    h.count = table.count;
+    h.generation = table.generation;
+    bool ok = std::fwrite(&h, sizeof(h), 1, f)==1;
+    std::vector<uint64_t> chunk;
+    for(size_t i=0, n; ok && i<table.count; i+=n){
+        n = std::min<size_t>(table.count - i, 1 << 16);
+        chunk.resize(n*2);
+        for(size_t j=0; j<n; j++){
+            chunk[2*j] = table.slots[i+j].keyXor.load(std::memory_order_relaxed);
+            chunk[2*j+1] = table.slots[i+j].data.load(std::memory_order_relaxed);
+        }
+        ok = std::fwrite(chunk.data(), sizeof(uint64_t), chunk.size(), f)==chunk.size();
+    }
+    return std::fclose(f)==0 && ok;
+}
+
+// The file is mapped rather than read, so a large table streams straight from the page cache.
+// The table takes the file's size.
+bool LoadTT(TranspositionTable &table, const std::string &path){
+    MappedFile file;
+    if(!MapFile(file, path) || file.size < sizeof(TTFileHeader)) return false;
+    TTFileHeader h;
+    std::memcpy(&h, file.data, sizeof(h));
+    if(std::memcmp(h.magic, TT_MAGIC, 4) || h.version!=TT_FILE_VERSION || h.zobristSeed!=ZobristSeed()) return false;
+    if(h.count<2 || (h.count & (h.count-1)) || file.size != sizeof(h) + h.count*2*sizeof(uint64_t)) return false;
+    if(table.count!=h.count) AllocateTT(table, (size_t)h.count);
+    const unsigned char *src = file.data + sizeof(h);
+    for(size_t i=0; i<table.count; i++){
+        uint64_t v[2];
+        std::memcpy(v, src + i*sizeof(v), sizeof(v));
+        table.slots[i].keyXor.store(v[0], std::memory_order_relaxed);
+        table.slots[i].data.store(v[1], std::memory_order_relaxed);
+    }
+    table.generation = (uint8_t)h.generation;
+    return true;
+}
+
+bool SaveTT(const std::string &path){ std::call_once(ttOnce, [](){ ResizeTT(ttG, 16); }); return SaveTT(ttG, path); }
+bool LoadTT(const std::string &path){ std::call_once(ttOnce, [](){ ResizeTT(ttG, 16); }); return LoadTT(ttG, path); }
+bool AttachSharedTT(const std::string &name, size_t mb){ std::call_once(ttOnce, [](){}); return AttachSharedTT(ttG, name, mb); }
+std::string DescribeTT(){ std::call_once(ttOnce, [](){ ResizeTT(ttG, 16); }); return DescribeTT(ttG); }
+
+static TranspositionTable &TableFor(SearchContext &ctx){
+    if(ctx.tt) return *ctx.tt;
+    std::call_once(ttOnce, [](){ ResizeTT(ttG, 16); });
+    return ttG;
+}
+
+static bool ProbeTT(TranspositionTable &table, uint64_t key, TTEntry &out){
+    TTSlot *bucket = &table.slots[key & (table.count-1) & ~(size_t)1];
+    for(int i=0;i<2;i++){
+        uint64_t d = bucket[i].data.load(std::memory_order_relaxed);
+        if((bucket[i].keyXor.load(std::memory_order_relaxed) ^ d) == key && d){ out = UnpackTT(d); return true; }
+    }
+    return false;
+}
+
+// Slot 0 keeps the deepest entry of the current search, slot 1 always takes the newest.
+static void StoreTT(TranspositionTable &table, uint64_t key, const TTEntry &e){
+    TTSlot *bucket = &table.slots[key & (table.count-1) & ~(size_t)1];
+    uint64_t d0 = bucket[0].data.load(std::memory_order_relaxed);
+    bool sameKey = (bucket[0].keyXor.load(std::memory_order_relaxed) ^ d0) == key;
+    int depth0 = (int)((d0>>32) & 255);
+    uint8_t gen0 = (uint8_t)(d0>>60);
+    uint8_t gen = table.generation.load(std::memory_order_relaxed);
+    TTSlot &slot = (sameKey || e.depth >= depth0 || gen0 != (gen & 15)) ? bucket[0] : bucket[1];
+    uint64_t d = PackTT(e, gen);
+    slot.data.store(d, std::memory_order_relaxed);
+    slot.keyXor.store(key ^ d, std::memory_order_relaxed);
+}
+
 // ---------------- Move ordering ----------------
 
 // MVV-LVA-ish priority for captures: victimValue * 100 - attackerValue
@@ -243,190 +436,803 @@ static int MoveHeuristicScore(const Piece cur[8][8], const Move &m, const Move *
     return score;
 }
 
-// ---------------- Quiescence search ----------------
+// Captures, promotions and en passant for the quiescence search, from the attack map: in the
+// order GeneratePseudoLegal lists them, then best first by MVV-LVA. Captures that lose material
+// by static exchange are left out.
+static const int QUEEN_DIRS[8][2] = { {1,1},{1,-1},{-1,1},{-1,-1},{1,0},{-1,0},{0,1},{0,-1} };
+static const int KNIGHT_STEPS[8][2] = { {1,-2},{2,-1},{2,1},{1,2},{-1,2},{-2,1},{-2,-1},{-1,-2} };
 
-int Quiescence(Piece b[8][8], Color side, const Move &lastMv, int alpha, int beta){
-    int stand = EvalForSide(b, side);
-    if(stand >= beta) return beta;
-    if(alpha < stand) alpha = stand;
+template<Color Us>
+static void QuiescenceMoves(const Piece b[8][8], const Move &lastMv, const AttackMap &a, std::vector<Move> &out){
+    typedef SideTraits<Us> S;
+    const int us = Us==C_BLACK, them = 1-us;
+    out.clear();
+    for(uint64_t own = a.occ[us]; own; own &= own-1){
+        int sq = LowestBit(own), x = sq%8, y = sq/8;
+        const Piece &p = b[y][x];
+        if(p.type==PT_PAWN){
+            int ny = y + S::Forward;
+            if(ny==S::PromotionRow && b[ny][x].type==PT_NONE) out.push_back(Move(x,y,x,ny));
+            for(int dx=-1; dx<=1; dx+=2){
+                int nx = x+dx;
+                if(!OnBoard(nx, ny)) continue;
+                if(b[ny][nx].type!=PT_NONE && b[ny][nx].color==S::Them) out.push_back(Move(x,y,nx,ny));
+                else if(y==S::EnPassantRow && lastMv.fx!=-1 && abs(lastMv.ty-lastMv.fy)==2 && lastMv.ty==y && lastMv.tx==nx &&
+                        b[y][nx].type==PT_PAWN && b[y][nx].color==S::Them){
+                    Move m(x,y,nx,ny); m.isEnPassant = true; out.push_back(m);
+                }
+            }
+            continue;
+        }
+        // the targets in the generator's order: its step or direction index for the piece
+        uint64_t targets = a.attacks[sq] & a.occ[them];
+        Move found[8];
+        int rank[8], n = 0;
+        for(; targets; targets &= targets-1){
+            int t = LowestBit(targets), dx = t%8 - x, dy = t/8 - y, r = 0;
+            if(p.type==PT_KNIGHT){ while(KNIGHT_STEPS[r][0]!=dx || KNIGHT_STEPS[r][1]!=dy) r++; }
+            else if(p.type==PT_KING) r = (dx+1)*3 + dy+1;
+            else {
+                int sx = (dx>0) - (dx<0), sy = (dy>0) - (dy<0);
+                while(QUEEN_DIRS[r][0]!=sx || QUEEN_DIRS[r][1]!=sy) r++;
+            }
+            int i = n++;
+            for(; i>0 && rank[i-1] > r; i--){ rank[i] = rank[i-1]; found[i] = found[i-1]; }
+            rank[i] = r;
+            found[i] = Move(x, y, t%8, t/8);
+        }
+        out.insert(out.end(), found, found+n);
+    }
+    std::sort(out.begin(), out.end(), [&](const Move &m, const Move &c){
+        return MoveHeuristicScore(b, m) > MoveHeuristicScore(b, c);
+    });
+    out.erase(std::remove_if(out.begin(), out.end(), [&](const Move &m){
+        return !m.isEnPassant && b[m.ty][m.tx].type!=PT_NONE && StaticExchange(b, a, m) < 0;
+    }), out.end());
+}
 
-    // generate capture-like moves only (captures, promotions, en-passant)
-    auto pseudo = GeneratePseudoLegal(b, side, lastMv);
-    // filter to "noisy" moves
-    std::vector<Move> noisy;
-    for(auto &m : pseudo){
-        // consider only captures, en-passant, promotions
-        if(m.isEnPassant) noisy.push_back(m);
-        else if(b[m.ty][m.tx].type != PT_NONE) noisy.push_back(m);
-        else if(b[m.fy][m.fx].type == PT_PAWN && (m.ty==0 || m.ty==7)) noisy.push_back(m);
+// ---------------- Search control ----------------
+
+int64_t NowMs(){
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Levels 1..SKILL_LEVELS-1: budgets grow by 1.5x a level, from 200 nodes (about one ply)
+// to about 300 thousand; the spread shrinks by 20 cp a level, from 380 cp down to 20 cp.
+SkillLevel SkillFor(int level){
+    SkillLevel s = { 0, 1, 0 };
+    if(level<=0 || level>=SKILL_LEVELS) return s;
+    s.nodes = (uint64_t)std::llround(200 * std::pow(1.5, level-1));
+    s.multiPV = 4;
+    s.spread = 20 * (SKILL_LEVELS - level);
+    return s;
+}
+
+// A weakened search counts nodes instead of time, so it costs the same on any machine and load.
+static void ApplySkill(SearchLimits &limits){
+    SkillLevel s = SkillFor(limits.skill);
+    if(!s.nodes){ limits.skill = 0; return; }
+    limits.nodes = limits.nodes ? std::min(limits.nodes, s.nodes) : s.nodes;
+    limits.movetimeMs = 0;
+    limits.multiPV = std::max(limits.multiPV, s.multiPV);
+}
+
+void PrepareSearch(SearchContext &ctx, const SearchLimits &limits){
+    if(ctx.ageTT) NextTTGeneration(TableFor(ctx));
+    ctx.limits = limits;
+    if(limits.skill) ApplySkill(ctx.limits);
+    ctx.stop = false;
+    ctx.pondering = limits.ponder;
+    ctx.nodes = 0;
+    ctx.completedDepth = 0;
+    ctx.startMs = NowMs();
+}
+
+// The opponent played the expected move: the limits start counting from now.
+// If the ponder search is already past the depth limit there is nothing left to do.
+void PonderHit(SearchContext &ctx){
+    ctx.startMs = NowMs();
+    ctx.pondering = false;
+    if(ctx.limits.depth>0 && ctx.completedDepth >= ctx.limits.depth) ctx.stop = true;
+}
+
+// Simple clock allocation: an even share of the remaining time plus most of the increment.
+int AllocateMoveTime(int leftMs, int incMs, int movesToGo){
+    int share = leftMs / (movesToGo>0 ? movesToGo+1 : 30) + incMs*3/4;
+    return std::max(10, std::min(share, leftMs - 50));
+}
+
+// Count a node and poll the clock every 1024 nodes. Returns true when the search must unwind.
+bool CheckStop(SearchContext &ctx){
+    uint64_t n = ctx.nodes.fetch_add(1, std::memory_order_relaxed) + 1;
+    if(ctx.limits.nodes>0 && n>=ctx.limits.nodes && !ctx.pondering) ctx.stop = true;
+    if((n & 1023)==0 && ctx.limits.movetimeMs>0 && !ctx.pondering){
+        if(NowMs() - ctx.startMs >= ctx.limits.movetimeMs) ctx.stop = true;
+    }
+    return ctx.stop.load(std::memory_order_relaxed);
+}
+
+// ---------------- Node steps ----------------
+
+// A node's work split at its move loop, so the recursive search (NegamaxCtx, QuiescenceCtx)
+// and the resumable one (SearchTask) run the same code: enter the node, hand it its
+// children's values one at a time, close it.
+
+// Mate scores are stored relative to the node in the TT and relative to the root everywhere
+// else, so a mate found through a transposition keeps its true distance.
+static int ScoreToTT(int v, int ply){ return v > MATE_BOUND ? v + ply : v < -MATE_BOUND ? v - ply : v; }
+static int ScoreFromTT(int v, int ply){ return v > MATE_BOUND ? v - ply : v < -MATE_BOUND ? v + ply : v; }
+
+// a node's window and its best result so far
+struct SearchNode {
+    int depth = 0, ply = 0; // ply = distance from the root, used for mate scores
+    int alpha = 0, beta = 0, alphaOrig = 0, best = 0;
+    uint32_t bestMove = 0;  // PackMove
+    uint64_t key = 0;
+};
+
+enum NodeStep { NODE_DONE, NODE_LEAF, NODE_MOVES };
+
+// A full-width node up to its move loop. NODE_DONE: value settles it. NODE_LEAF: depth 0, a
+// quiescence node takes over with the window. NODE_MOVES: the legal moves, in search order.
+template<Color Us>
+static NodeStep EnterNode(SearchContext &ctx, Piece b[8][8], const Move &lastMv, SearchNode &n, std::vector<Move> &moves, int &value){
+    // mate distance pruning: no line from here beats a mate already found closer to the root
+    n.alpha = std::max(n.alpha, -MATE_SCORE + n.ply);
+    n.beta = std::min(n.beta, MATE_SCORE - n.ply - 1);
+    if(n.alpha >= n.beta){ value = n.alpha; return NODE_DONE; }
+
+    // tablebase hits and bitbase draws: nothing below them can change the result
+    int known;
+    if(ProbeWDL(b, Us, known)){ value = known==0 ? 0 : (known>0 ? TB_WIN_SCORE : -TB_WIN_SCORE); return NODE_DONE; }
+    if(ProbeBitbase(b, Us, known) && known==0){ value = 0; return NODE_DONE; }
+    n.key = ComputeZobrist(b, Us);
+    n.alphaOrig = n.alpha;
+
+    // Probe transposition table
+    Move ttMove;
+    TTEntry e;
+    if(ProbeTT(TableFor(ctx), n.key, e)){
+        ttMove = e.bestMove;
+        e.value = ScoreFromTT(e.value, n.ply);
+        if(e.depth >= n.depth){
+            if(e.flag == 0){ value = e.value; return NODE_DONE; } // exact
+            if(e.flag == 1) n.alpha = std::max(n.alpha, e.value); // lowerbound
+            else if(e.flag == 2) n.beta = std::min(n.beta, e.value); // upperbound
+            if(n.alpha >= n.beta){ value = e.value; return NODE_DONE; }
+        }
     }
-    if(noisy.empty()) return stand;
+    if(n.depth == 0) return NODE_LEAF;
 
-    // order noisy moves by MVV-LVA heuristic
-    std::sort(noisy.begin(), noisy.end(), [&](const Move &a, const Move &c){
-        return MoveHeuristicScore(b, a) > MoveHeuristicScore(b, c);
+    AttackMap attacks;
+    BuildAttackMap(b, Us, attacks, false);
+    moves = GenerateLegalMoves<Us>(b, lastMv, attacks);
+    if(moves.empty()){
+        value = attacks.king<0 || attacks.checkers ? -MATE_SCORE + n.ply : 0; // mate or stalemate
+        return NODE_DONE;
+    }
+
+    // Move ordering: try TT best move first (if present)
+    std::sort(moves.begin(), moves.end(), [&](const Move &a, const Move &c){
+        return MoveHeuristicScore(b, a, &ttMove) > MoveHeuristicScore(b, c, &ttMove);
     });
+    n.best = -10000000;
+    n.bestMove = 0;
+    return NODE_MOVES;
+}
+
+// a child's value, from the node's side; true on a cutoff
+static bool NodeChildDone(SearchNode &n, uint32_t move, int val){
+    if(val > n.best){ n.best = val; n.bestMove = move; }
+    if(val > n.alpha) n.alpha = val;
+    return n.alpha >= n.beta;
+}
+
+// the moves are searched or cut off: the node's value, stored in the TT
+static int CloseNode(SearchContext &ctx, const SearchNode &n){
+    TTEntry entry;
+    entry.value = ScoreToTT(n.best, n.ply);
+    entry.depth = n.depth;
+    entry.bestMove = UnpackMove(n.bestMove);
+    if(n.best <= n.alphaOrig) entry.flag = 2; // upperbound
+    else if(n.best >= n.beta) entry.flag = 1; // lowerbound
+    else entry.flag = 0; // exact
+    StoreTT(TableFor(ctx), n.key, entry);
+    return n.best;
+}
+
+// A quiescence node up to its move loop: stand pat, then the noisy moves. True when value
+// settles it; its value is otherwise the alpha it ends with.
+template<Color Us>
+static bool EnterQNode(SearchContext &ctx, Piece b[8][8], const Move &lastMv, SearchNode &n, std::vector<Move> &moves, int &value){
+    int stand = EvalCtx(ctx, b, Us);
+    if(stand >= n.beta){ value = n.beta; return true; }
+    if(n.alpha < stand) n.alpha = stand;
+    // one attack map serves the capture list and the exchange checks
+    AttackMap attacks;
+    BuildAttackMap(b, Us, attacks);
+    QuiescenceMoves<Us>(b, lastMv, attacks, moves);
+    if(moves.empty()){ value = stand; return true; }
+    return false;
+}
+
+// a child's value; true with the node's value on a cutoff
+static bool QNodeChildDone(SearchNode &n, int val, int &value){
+    if(val >= n.beta){ value = n.beta; return true; }
+    if(val > n.alpha) n.alpha = val;
+    return false;
+}
+
+// ---------------- Quiescence search ----------------
+
+// search is specialised on the side to move; the recursion alternates the two instantiations
+template<Color Us>
+static int QuiescenceCtx(SearchContext &ctx, Piece b[8][8], const Move &lastMv, int alpha, int beta){
+    typedef SideTraits<Us> S;
+    if(CheckStop(ctx)) return 0;
+    SearchNode n;
+    n.alpha = alpha;
+    n.beta = beta;
+    std::vector<Move> noisy;
+    int value;
+    if(EnterQNode<Us>(ctx, b, lastMv, n, noisy, value)) return value;
 
     for(auto &m : noisy){
         Piece nb[8][8]; CopyBoard(b, nb);
         MakeMoveOnCopy(nb, m);
-        int score = -Quiescence(nb, Opp(side), m, -beta, -alpha);
-        if(score >= beta) return beta;
-        if(score > alpha) alpha = score;
+        int score = -QuiescenceCtx<S::Them>(ctx, nb, m, -n.beta, -n.alpha);
+        if(ctx.stop) return 0;
+        if(QNodeChildDone(n, score, value)) return value;
     }
-    return alpha;
+    return n.alpha;
+}
+
+int Quiescence(Piece b[8][8], Color side, const Move &lastMv, int alpha, int beta){
+    SearchContext ctx;
+    if(side==C_WHITE) return QuiescenceCtx<C_WHITE>(ctx, b, lastMv, alpha, beta);
+    return QuiescenceCtx<C_BLACK>(ctx, b, lastMv, alpha, beta);
 }
 
 // ---------------- Negamax with TT and quiescence ----------------
 
+template<Color Us>
+static int NegamaxCtx(SearchContext &ctx, Piece b[8][8], const Move &lastMv, int depth, int ply, int alpha, int beta){
+    typedef SideTraits<Us> S;
+    if(CheckStop(ctx)) return 0;
+    SearchNode n;
+    n.depth = depth;
+    n.ply = ply;
+    n.alpha = alpha;
+    n.beta = beta;
+    std::vector<Move> legal;
+    int value;
+    NodeStep step = EnterNode<Us>(ctx, b, lastMv, n, legal, value);
+    if(step==NODE_DONE) return value;
+    if(step==NODE_LEAF) return QuiescenceCtx<Us>(ctx, b, lastMv, n.alpha, n.beta);
+
+    for(auto &m : legal){
+        Piece copyB[8][8]; CopyBoard(b, copyB);
+        MakeMoveOnCopy(copyB, m);
+        int val = -NegamaxCtx<S::Them>(ctx, copyB, m, depth-1, ply+1, -n.beta, -n.alpha);
+        if(ctx.stop) return 0; // partial result, don't let it reach the TT
+        if(NodeChildDone(n, PackMove(m), val)) break;
+    }
+    return CloseNode(ctx, n);
+}
+
+// entry from a runtime colour
+static int NegamaxCtx(SearchContext &ctx, Piece b[8][8], Color side, const Move &lastMv, int depth, int ply, int alpha, int beta){
+    if(side==C_WHITE) return NegamaxCtx<C_WHITE>(ctx, b, lastMv, depth, ply, alpha, beta);
+    return NegamaxCtx<C_BLACK>(ctx, b, lastMv, depth, ply, alpha, beta);
+}
+
 int Negamax(Piece b[8][8], Color side, const Move &lastMv, int depth, int alpha, int beta){
-    // terminal / draw detection responsibilities are left to caller (as before)
-    uint64_t key = ComputeZobrist(b, side);
+    SearchContext ctx;
+    return NegamaxCtx(ctx, b, side, lastMv, depth, 0, alpha, beta);
+}
 
-    // Probe transposition table
-    {
-        std::lock_guard<std::mutex> lk(ttMutex);
-        auto it = tt.find(key);
-        if(it != tt.end()){
-            const TTEntry &e = it->second;
-            if(e.depth >= depth){
-                if(e.flag == 0) return e.value; // exact
-                if(e.flag == 1) alpha = std::max(alpha, e.value); // lowerbound
-                else if(e.flag == 2) beta = std::min(beta, e.value); // upperbound
-                if(alpha >= beta) return e.value;
-            }
-        }
+// ---------------- Root search ----------------
+
+struct RootMove {
+    Move move;
+    int score = -100000000;
+};
+
+static void StoreRoot(SearchContext &ctx, const Piece cur[8][8], Color side, const RootMove &best, int depth){
+    TTEntry e; e.value = best.score; e.depth = depth; e.flag = 0; e.bestMove = best.move;
+    StoreTT(TableFor(ctx), ComputeZobrist(cur, side), e);
+}
+
+// One iteration over the root moves. The first multiPV (expected best) moves are searched with
+// a full window, the rest in parallel against the worst of their scores, so most of them fail
+// low cheaply and only a move that enters the top multiPV gets an exact score.
+// Returns false if the search was stopped before the iteration completed.
+static bool SearchRoot(SearchContext &ctx, const Piece cur[8][8], Color side, std::vector<RootMove> &rootMoves, int depth, int multiPV){
+    const int INF = 100000000;
+    size_t exact = std::min(rootMoves.size(), (size_t)std::max(1, multiPV));
+    int alpha = INF;
+    for(size_t i=0; i<exact; i++){
+        Piece copyB[8][8]; CopyBoard(cur, copyB);
+        MakeMoveOnCopy(copyB, rootMoves[i].move);
+        rootMoves[i].score = -NegamaxCtx(ctx, copyB, Opp(side), rootMoves[i].move, depth-1, 1, -INF, INF);
+        if(ctx.stop) return false;
+        alpha = std::min(alpha, rootMoves[i].score);
     }
 
-    if(depth == 0){
-        // use quiescence at leaf
-        int q = Quiescence(b, side, lastMv, alpha, beta);
-        return q;
+    // a node budget is only reproducible if the nodes are searched in a fixed order
+    if(!ctx.parallelRoot || ctx.limits.nodes>0){
+        for(size_t i=exact; i<rootMoves.size(); i++){
+            Piece copyB[8][8]; CopyBoard(cur, copyB);
+            MakeMoveOnCopy(copyB, rootMoves[i].move);
+            rootMoves[i].score = -NegamaxCtx(ctx, copyB, Opp(side), rootMoves[i].move, depth-1, 1, -INF, -alpha);
+            if(ctx.stop) return false;
+        }
     }
 
-    auto legal = GenerateLegalMoves(b, side, lastMv);
-    if(legal.empty()){
-        int kx, ky;
-        if(!FindKing(b, side, kx, ky)) return -1000000;
-        if(IsSquareAttacked(b,kx,ky,Opp(side))) return -1000000; // mate
-        return 0; // stalemate
+    std::vector<std::future<int>> futures;
+    futures.reserve(rootMoves.size());
+    for(size_t i=exact; ctx.parallelRoot && !ctx.limits.nodes && i<rootMoves.size(); i++){
+        Move m = rootMoves[i].move;
+        int index = (int)(i-exact);
+        futures.push_back(std::async(std::launch::async, [&ctx, cur, side, m, depth, alpha, INF, index]()->int{
+            BindThisThread(index);
+            Piece copyB[8][8]; CopyBoard(cur, copyB);
+            MakeMoveOnCopy(copyB, m);
+            return -NegamaxCtx(ctx, copyB, Opp(side), m, depth-1, 1, -INF, -alpha);
+        }));
     }
+    for(size_t i=0; i<futures.size(); i++) rootMoves[exact+i].score = futures[i].get();
+    if(ctx.stop) return false;
 
-    // Move ordering: try TT best move first (if present)
-    Move ttMove;
-    {
-        std::lock_guard<std::mutex> lk(ttMutex);
-        auto it = tt.find(key);
-        if(it != tt.end()){
-            ttMove = it->second.bestMove;
-        } else {
-            ttMove = Move();
+    std::stable_sort(rootMoves.begin(), rootMoves.end(), [](const RootMove &a, const RootMove &c){ return a.score > c.score; });
+    StoreRoot(ctx, cur, side, rootMoves[0], depth);
+    return true;
+}
+
+// Follow TT best moves from the root, checking each one is legal in its position.
+static std::vector<Move> ExtractPV(SearchContext &ctx, const Position &pos, const Move &first, int maxLen){
+    std::vector<Move> pv;
+    Position p = pos;
+    Move m = first;
+    while(m.fx!=-1 && (int)pv.size() < maxLen){
+        bool legal = false;
+        for(auto &l : GenerateLegalMoves(p.board, p.side, p.lastMove)){
+            if(l.fx==m.fx && l.fy==m.fy && l.tx==m.tx && l.ty==m.ty){ m = l; legal = true; break; }
         }
+        if(!legal) break;
+        pv.push_back(m);
+        ApplyMove(p, m);
+        TTEntry e;
+        m = ProbeTT(TableFor(ctx), ComputeZobrist(p.board, p.side), e) ? e.bestMove : Move();
+    }
+    return pv;
+}
+
+// Play the line with the best score plus a bonus of 0..spread. The bonuses are drawn from the
+// position's key and the level, so a position at a given level always gets the same move.
+static void PickSkillLine(const Position &pos, int level, SearchResult &res){
+    SkillLevel s = SkillFor(level);
+    std::mt19937_64 gen(ComputeZobrist(pos.board, pos.side) ^ (uint64_t)level * 0x9E3779B97F4A7C15ULL);
+    size_t pick = 0;
+    int64_t top = INT64_MIN;
+    for(size_t i=0; i<res.lines.size(); i++){
+        int64_t v = (int64_t)res.lines[i].score + (int64_t)(gen() % (uint64_t)(s.spread+1));
+        if(v > top){ top = v; pick = i; }
     }
+    std::rotate(res.lines.begin(), res.lines.begin()+pick, res.lines.begin()+pick+1);
+    res.best = res.lines[0].move;
+    res.score = res.lines[0].score;
+}
 
+// Root moves in search order: the TT move first, then by MoveHeuristicScore.
+static std::vector<Move> OrderedRootMoves(SearchContext &ctx, const Position &pos){
+    auto legal = GenerateLegalMoves(pos.board, pos.side, pos.lastMove);
+    Move ttMove;
+    TTEntry e;
+    if(ProbeTT(TableFor(ctx), ComputeZobrist(pos.board, pos.side), e)) ttMove = e.bestMove;
     std::sort(legal.begin(), legal.end(), [&](const Move &a, const Move &c){
-        return MoveHeuristicScore(b, a, &ttMove) > MoveHeuristicScore(b, c, &ttMove);
+        return MoveHeuristicScore(pos.board, a, &ttMove) > MoveHeuristicScore(pos.board, c, &ttMove);
     });
+    return legal;
+}
 
-    int bestVal = -10000000;
-    Move bestMoveLocal;
-
-    for(auto &m : legal){
-        Piece copyB[8][8]; CopyBoard(b, copyB);
-        MakeMoveOnCopy(copyB, m);
-        int val = -Negamax(copyB, Opp(side), m, depth-1, -beta, -alpha);
-        if(val > bestVal){
-            bestVal = val;
-            bestMoveLocal = m;
-        }
-        if(val > alpha) alpha = val;
-        if(alpha >= beta) break;
+// A root in the tablebases: the moves ranked by DTZ instead of searched. False otherwise.
+static bool TablebaseResult(SearchContext &ctx, const Position &pos, int multiPV, SearchResult &res){
+    std::vector<std::pair<Move,int>> tbMoves;
+    if(!TablebaseRootMoves(pos, tbMoves)) return false;
+    res.best = tbMoves[0].first;
+    res.score = tbMoves[0].second;
+    res.depth = 1;
+    for(size_t i=0; i<tbMoves.size() && (int)i<multiPV; i++){
+        PVLine line;
+        line.move = tbMoves[i].first;
+        line.score = tbMoves[i].second;
+        line.depth = 1;
+        line.pv.push_back(line.move);
+        res.lines.push_back(line);
     }
+    ctx.completedDepth = 1;
+    return true;
+}
 
-    // store in TT
-    {
-        std::lock_guard<std::mutex> lk(ttMutex);
-        TTEntry entry;
-        entry.value = bestVal;
-        entry.depth = depth;
-        entry.bestMove = bestMoveLocal;
-        if(bestVal <= alpha) entry.flag = 2; // upperbound
-        else if(bestVal >= beta) entry.flag = 1; // lowerbound
-        else entry.flag = 0; // exact
-        tt[key] = entry;
+// The result of a completed iteration: the first multiPV moves of the ranking with their PVs.
+static void IterationResult(SearchContext &ctx, const Position &pos, const std::vector<RootMove> &ranked, int depth, int multiPV, SearchResult &res){
+    ctx.completedDepth = depth;
+    res.best = ranked[0].move;
+    res.score = ranked[0].score;
+    res.depth = depth;
+    res.lines.clear();
+    for(size_t i=0; i<ranked.size() && (int)i<multiPV; i++){
+        PVLine line;
+        line.move = ranked[i].move;
+        line.score = ranked[i].score;
+        line.depth = depth;
+        line.pv = ExtractPV(ctx, pos, line.move, depth);
+        res.lines.push_back(line);
     }
+}
 
-    return bestVal;
+// Once the search ends: the best-ordered move if no iteration finished, the skill level's
+// choice among the lines, and the move to ponder on.
+static void FinishResult(SearchContext &ctx, const Position &pos, const Move &firstOrdered, SearchResult &res){
+    if(res.best.fx==-1) res.best = firstOrdered;
+    if(ctx.limits.skill && res.lines.size()>1) PickSkillLine(pos, ctx.limits.skill, res);
+    if(!res.lines.empty() && res.lines[0].pv.size()>1) res.ponder = res.lines[0].pv[1];
 }
 
-// ---------------- Top-level chooser ----------------
+// ---------------- Iterative deepening ----------------
 
-// For simplicity and stability we use parallel first-ply evaluation as before,
-// but we leverage the transposition table and better ordering. Each async worker
-// will reuse the shared TT (protected by mutex).
-Move ChooseBestFromLegal(const Piece cur[8][8], Color side, const Move &lastMv, int depth){
-    auto legal = GenerateLegalMoves(cur, side, lastMv);
-    if(legal.empty()) return Move();
-
-    // Quick shallow evaluation if depth <= 1
-    if(depth <= 1){
-        Move best = legal[0];
-        int bestVal = -100000000;
-        for(auto &m: legal){
-            Piece copyB[8][8]; CopyBoard(cur, copyB);
-            MakeMoveOnCopy(copyB, m);
-            int val = EvalForSide(copyB, side);
-            if(val > bestVal){ bestVal = val; best = m; }
-        }
-        return best;
+static void ReportLines(SearchContext &ctx, const SearchResult &res, const std::function<void(const SearchInfo&)> &onInfo){
+    if(!onInfo) return;
+    for(size_t i=0; i<res.lines.size(); i++){
+        SearchInfo info;
+        info.multiPV = (int)i+1;
+        info.depth = res.lines[i].depth;
+        info.score = res.lines[i].score;
+        info.nodes = ctx.nodes;
+        info.timeMs = NowMs() - ctx.startMs;
+        info.pv = res.lines[i].pv;
+        onInfo(info);
     }
+}
 
-    // Order moves by heuristic before launching threads (ttMove may help)
-    uint64_t key = ComputeZobrist(cur, side);
-    Move ttMove;
-    {
-        std::lock_guard<std::mutex> lk(ttMutex);
-        auto it = tt.find(key);
-        if(it != tt.end()) ttMove = it->second.bestMove;
+// Deepen until a limit is hit or the context is stopped. While pondering (or in infinite
+// mode) the depth limit is ignored and the result is held back until PonderHit/stop,
+// as UCI requires.
+SearchResult Think(SearchContext &ctx, const Position &pos, const std::function<void(const SearchInfo&)> &onInfo){
+    SearchResult res;
+    std::vector<RootMove> rootMoves;
+    for(auto &m : OrderedRootMoves(ctx, pos)){ RootMove rm; rm.move = m; rootMoves.push_back(rm); }
+    Move firstOrdered = rootMoves.empty() ? Move() : rootMoves[0].move;
+
+    int multiPV = std::max(1, ctx.limits.multiPV);
+
+    // root in the tablebases: rank the moves by DTZ instead of searching
+    if(TablebaseResult(ctx, pos, multiPV, res)){
+        ReportLines(ctx, res, onInfo);
+        rootMoves.clear(); // nothing left to search
     }
-    std::sort(legal.begin(), legal.end(), [&](const Move &a, const Move &c){
-        return MoveHeuristicScore(cur, a, &ttMove) > MoveHeuristicScore(cur, c, &ttMove);
-    });
 
-    // Launch async tasks for each child move, but cap the number of parallel tasks to hardware concurrency
-    unsigned hw = std::thread::hardware_concurrency();
-    if(hw < 1) hw = 2;
-    // We'll still create futures for each move but rely on system scheduling; keep the previous async usage.
-    std::vector<std::future<std::pair<int,Move>>> futures;
-    futures.reserve(legal.size());
+    for(int depth=1; !rootMoves.empty() && depth<=MAX_SEARCH_DEPTH; depth++){
+        bool limited = !ctx.pondering && !ctx.limits.infinite;
+        if(limited && ctx.limits.depth>0 && depth>ctx.limits.depth) break;
 
-    for(auto &m : legal){
-        futures.push_back(std::async(std::launch::async, [cur, side, lastMv, m, depth]()->std::pair<int,Move>{
-            Piece copyB[8][8]; CopyBoard(cur, copyB);
-            MakeMoveOnCopy(copyB, m);
-            int val = -Negamax(copyB, Opp(side), m, depth-1, -100000000, 100000000);
-            return {val, m};
-        }));
+        std::vector<RootMove> iter = rootMoves;
+        if(!SearchRoot(ctx, pos.board, pos.side, iter, depth, multiPV)) break;
+        rootMoves = iter;
+        IterationResult(ctx, pos, rootMoves, depth, multiPV, res);
+        ReportLines(ctx, res, onInfo);
+
+        // not enough time left to finish another iteration
+        limited = !ctx.pondering && !ctx.limits.infinite;
+        if(limited && ctx.limits.movetimeMs>0 && NowMs() - ctx.startMs > ctx.limits.movetimeMs/2) break;
     }
 
-    Move best = legal[0];
-    int bestVal = -100000000;
-    for(auto &f : futures){
-        auto pr = f.get();
-        int val = pr.first;
-        Move m = pr.second;
-        if(val > bestVal){
-            bestVal = val;
-            best = m;
-        }
+    // stopped before the first iteration finished: fall back to the best-ordered move
+    FinishResult(ctx, pos, firstOrdered, res);
+
+    while((ctx.pondering || ctx.limits.infinite) && !ctx.stop) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    return res;
+}
+
+// ---------------- Resumable search ----------------
+
+// Think's search (parallelRoot off) as an explicit state machine instead of recursion, so it
+// can stop after any node and carry on later, on any thread. Its nodes go through the same
+// steps as NegamaxCtx / QuiescenceCtx and its iterations through the same root code, so it
+// visits the same nodes in the same order and gives the same result (chess tasktest checks).
+// The task plays moves on one board in place and takes them back, keeps a stack of frames,
+// and keeps the move lists of the current line in one arena, packed to 32 bits: a few KB.
+
+enum TaskFrameKind : uint8_t { TF_NODE, TF_QNODE };
+
+// the squares a move changes, to put back when it is taken back
+struct TaskUndo {
+    uint8_t n = 0;
+    uint8_t sq[4];
+    Piece piece[4];
+};
+
+// one node of the line being searched
+struct TaskFrame {
+    uint8_t kind = TF_NODE;
+    bool expanded = false; // moves generated, children follow
+    uint8_t side = C_WHITE;
+    SearchNode node;
+    uint32_t lastMove = 0;
+    uint32_t movesBegin = 0, next = 0, movesEnd = 0; // into SearchTask::moves
+    TaskUndo undo; // of the move at next-1, being searched below this frame
+};
+
+struct TaskRootMove {
+    uint32_t move;
+    int score;
+};
+
+struct SearchTask {
+    SearchContext ctx;
+    Position pos;           // the root
+    Piece board[8][8];      // the current line's position
+    std::vector<TaskFrame> stack;
+    std::vector<uint32_t> moves;
+    std::vector<TaskRootMove> rootMoves, iter; // ordered by the last iteration / the one running
+    int depth = 0, maxDepth = 0, multiPV = 1, rootAlpha = 0;
+    size_t rootIndex = 0, exact = 1; // the first 'exact' root moves get a full window
+    bool done = false;
+    SearchResult res;
+};
+
+static const int TASK_INF = 100000000;
+
+static void MakeTaskMove(Piece b[8][8], const Move &m, TaskUndo &u){
+    u.n = 0;
+    auto save = [&](int x, int y){ u.sq[u.n] = (uint8_t)(y*8 + x); u.piece[u.n++] = b[y][x]; };
+    save(m.fx, m.fy);
+    save(m.tx, m.ty);
+    if(m.isEnPassant) save(m.tx, m.fy);
+    if(m.isCastle && m.tx==m.fx+2){ save(m.tx-1, m.ty); save(7, m.ty); }
+    if(m.isCastle && m.tx==m.fx-2){ save(m.tx+1, m.ty); save(0, m.ty); }
+    MakeMoveOnCopy(b, m);
+}
+
+static void UnmakeTaskMove(Piece b[8][8], const TaskUndo &u){
+    for(int i=u.n-1; i>=0; i--) b[u.sq[i]>>3][u.sq[i]&7] = u.piece[i];
+}
+
+static void PushTaskFrame(SearchTask &t, TaskFrameKind kind, Color side, uint32_t lastMove, int depth, int ply, int alpha, int beta){
+    TaskFrame f;
+    f.kind = kind;
+    f.side = (uint8_t)side;
+    f.lastMove = lastMove;
+    f.node.depth = depth;
+    f.node.ply = ply;
+    f.node.alpha = alpha;
+    f.node.beta = beta;
+    f.movesBegin = f.next = f.movesEnd = (uint32_t)t.moves.size();
+    t.stack.push_back(f);
+}
+
+// EnterNode / EnterQNode for a frame. Returns true with the node's value when that settles
+// it; otherwise the frame's moves are in the arena, or a node at depth 0 has turned into a
+// quiescence node still to be entered.
+template<Color Us>
+static bool EnterTaskFrame(SearchTask &t, TaskFrame &f, int &value){
+    Move last = UnpackMove(f.lastMove);
+    std::vector<Move> list;
+    if(f.kind==TF_NODE){
+        NodeStep step = EnterNode<Us>(t.ctx, t.board, last, f.node, list, value);
+        if(step==NODE_DONE) return true;
+        if(step==NODE_LEAF){ f.kind = TF_QNODE; return false; }
+    } else if(EnterQNode<Us>(t.ctx, t.board, last, f.node, list, value)) return true;
+    for(auto &m : list) t.moves.push_back(PackMove(m));
+    f.movesEnd = (uint32_t)t.moves.size();
+    f.expanded = true;
+    return false;
+}
+
+// the moves are exhausted (or cut off): f's value
+static int FinishTaskFrame(SearchTask &t, TaskFrame &f){
+    return f.kind==TF_QNODE ? f.node.alpha : CloseNode(t.ctx, f.node);
+}
+
+// A child of f returned (value from f's side). Returns true with f's own value when that
+// ends the move loop.
+static bool TaskChildDone(SearchTask &t, TaskFrame &f, int val, int &value){
+    if(f.kind==TF_QNODE) return QNodeChildDone(f.node, val, value);
+    if(!NodeChildDone(f.node, t.moves[f.next-1], val)) return false;
+    value = CloseNode(t.ctx, f.node);
+    return true;
+}
+
+// ends the search with the last completed iteration, as Think does when it stops
+static void FinishTask(SearchTask &t){
+    t.stack.clear();
+    t.moves.clear();
+    CopyBoard(t.pos.board, t.board);
+    FinishResult(t.ctx, t.pos, t.rootMoves.empty() ? Move() : UnpackMove(t.rootMoves[0].move), t.res);
+    t.done = true;
+}
+
+// Root: one iteration searches the first multiPV moves with a full window and the rest
+// against the worst of their scores, as SearchRoot does without parallelRoot. Starts the next
+// root move, or closes the iteration and starts the next one.
+static void NextTaskRootMove(SearchTask &t){
+    if(t.rootIndex < t.iter.size()){
+        uint32_t m = t.iter[t.rootIndex].move;
+        CopyBoard(t.pos.board, t.board);
+        MakeMoveOnCopy(t.board, UnpackMove(m));
+        int beta = t.rootIndex < t.exact ? TASK_INF : -t.rootAlpha;
+        PushTaskFrame(t, TF_NODE, Opp(t.pos.side), m, t.depth-1, 1, -TASK_INF, beta);
+        t.rootIndex++;
+        return;
+    }
+    std::stable_sort(t.iter.begin(), t.iter.end(), [](const TaskRootMove &a, const TaskRootMove &c){ return a.score > c.score; });
+    t.rootMoves = t.iter;
+    std::vector<RootMove> ranked(std::min(t.rootMoves.size(), (size_t)t.multiPV));
+    for(size_t i=0; i<ranked.size(); i++){
+        ranked[i].move = UnpackMove(t.rootMoves[i].move);
+        ranked[i].score = t.rootMoves[i].score;
     }
+    StoreRoot(t.ctx, t.pos.board, t.pos.side, ranked[0], t.depth);
+    IterationResult(t.ctx, t.pos, ranked, t.depth, t.multiPV, t.res);
+
+    bool outOfTime = t.ctx.limits.movetimeMs>0 && NowMs() - t.ctx.startMs > t.ctx.limits.movetimeMs/2;
+    if(++t.depth > t.maxDepth || outOfTime){ FinishTask(t); return; }
+    t.iter = t.rootMoves;
+    t.rootIndex = 0;
+    t.rootAlpha = TASK_INF;
+    NextTaskRootMove(t);
+}
 
-    // write best move for root position to TT (cheap)
-    {
-        std::lock_guard<std::mutex> lk(ttMutex);
-        TTEntry e; e.value = bestVal; e.depth = depth; e.flag = 0; e.bestMove = best;
-        tt[ComputeZobrist(cur, side)] = e;
+std::shared_ptr<SearchTask> StartSearchTask(const Position &pos, const SearchLimits &limits, TranspositionTable *tt){
+    std::shared_ptr<SearchTask> t = std::make_shared<SearchTask>();
+    t->ctx.tt = tt;
+    t->ctx.parallelRoot = false;
+    t->ctx.ageTT = false;
+    SearchLimits l = limits;
+    l.infinite = l.ponder = false;
+    PrepareSearch(t->ctx, l);
+    const SearchLimits &cl = t->ctx.limits; // with the skill level's budget
+    t->pos = pos;
+    CopyBoard(pos.board, t->board);
+    t->maxDepth = cl.depth>0 ? std::min(cl.depth, MAX_SEARCH_DEPTH) : (cl.movetimeMs>0 || cl.nodes>0 ? MAX_SEARCH_DEPTH : 1);
+    t->multiPV = std::max(1, cl.multiPV);
+
+    for(auto &m : OrderedRootMoves(t->ctx, pos)) t->rootMoves.push_back({PackMove(m), -TASK_INF});
+    if(t->rootMoves.empty() || TablebaseResult(t->ctx, pos, t->multiPV, t->res)){ FinishTask(*t); return t; }
+    t->exact = std::min(t->rootMoves.size(), (size_t)t->multiPV);
+    t->depth = 1;
+    t->iter = t->rootMoves;
+    t->rootAlpha = TASK_INF;
+    return t;
+}
+
+bool StepSearchTask(SearchTask &t, uint64_t nodes){
+    if(t.done) return true;
+    uint64_t until = t.ctx.nodes.load(std::memory_order_relaxed) + std::max<uint64_t>(1, nodes);
+    int value = 0;
+    bool returned = false; // value holds the result of the frame just popped
+    for(;;){
+        if(returned){
+            returned = false;
+            if(t.stack.empty()){
+                // a root move's search finished
+                int score = -value;
+                t.iter[t.rootIndex-1].score = score;
+                if(t.rootIndex <= t.exact) t.rootAlpha = std::min(t.rootAlpha, score);
+                NextTaskRootMove(t);
+                if(t.done) return true;
+                continue;
+            }
+            TaskFrame &f = t.stack.back();
+            UnmakeTaskMove(t.board, f.undo);
+            if(TaskChildDone(t, f, -value, value)){
+                t.moves.resize(f.movesBegin);
+                t.stack.pop_back();
+                returned = true;
+                continue;
+            }
+        }
+        if(t.stack.empty()){ NextTaskRootMove(t); if(t.done) return true; continue; }
+
+        TaskFrame &f = t.stack.back();
+        if(!f.expanded){
+            if(t.ctx.nodes.load(std::memory_order_relaxed) >= until) return false; // yield between nodes
+            if(CheckStop(t.ctx)){ FinishTask(t); return true; }
+            bool settled = f.side==C_WHITE ? EnterTaskFrame<C_WHITE>(t, f, value) : EnterTaskFrame<C_BLACK>(t, f, value);
+            if(settled){
+                t.moves.resize(f.movesBegin);
+                t.stack.pop_back();
+                returned = true;
+            }
+            continue;
+        }
+        if(f.next < f.movesEnd){
+            Move m = UnpackMove(t.moves[f.next++]);
+            MakeTaskMove(t.board, m, f.undo);
+            const SearchNode &n = f.node;
+            PushTaskFrame(t, (TaskFrameKind)f.kind, Opp((Color)f.side), PackMove(m), n.depth-1, n.ply+1, -n.beta, -n.alpha);
+            continue;
+        }
+        value = FinishTaskFrame(t, f);
+        t.moves.resize(f.movesBegin);
+        t.stack.pop_back();
+        returned = true;
     }
+}
+
+const SearchResult &SearchTaskResult(const SearchTask &t){ return t.res; }
+uint64_t SearchTaskNodes(const SearchTask &t){ return t.ctx.nodes.load(); }
 
-    return best;
-}
\ No newline at end of file
+size_t SearchTaskBytes(const SearchTask &t){
+    size_t pv = 0;
+    for(auto &l : t.res.lines) pv += sizeof(l) + l.pv.capacity() * sizeof(Move);
+    return sizeof(t) + t.stack.capacity() * sizeof(TaskFrame) + t.moves.capacity() * sizeof(uint32_t) +
+           (t.rootMoves.capacity() + t.iter.capacity()) * sizeof(TaskRootMove) + pv;
+}
+
+// ---------------- Top-level chooser ----------------
+
+// Fixed-depth search of the given position (kept for callers that don't need the full Think API).
+Move ChooseBestFromLegal(const Piece cur[8][8], Color side, const Move &lastMv, int depth){
+    Position pos;
+    CopyBoard(cur, pos.board);
+    pos.side = side;
+    pos.lastMove = lastMv;
+    SearchContext ctx;
+    SearchLimits limits;
+    limits.depth = std::max(1, depth);
+    PrepareSearch(ctx, limits);
+    return Think(ctx, pos).best;
+}
+
+// Ranked top-multiPV root moves at a fixed depth, from a single search.
+std::vector<PVLine> AnalyzeMultiPV(const Piece cur[8][8], Color side, const Move &lastMv, int depth, int multiPV){
+    Position pos;
+    CopyBoard(cur, pos.board);
+    pos.side = side;
+    pos.lastMove = lastMv;
+    SearchContext ctx;
+    SearchLimits limits;
+    limits.depth = std::max(1, depth);
+    limits.multiPV = multiPV;
+    PrepareSearch(ctx, limits);
+    return Think(ctx, pos).lines;
+}
+
+// ---------------- Pondering (GUI) ----------------
+
+static SearchContext ponderCtx;
+static Position ponderPos;
+static std::future<SearchResult> ponderFuture;
+
+// Start searching the position after 'expected' in the background.
+void StartPonder(const Position &pos, const Move &expected, int depth){
+    StopPonder();
+    ponderPos = pos;
+    ApplyMove(ponderPos, expected);
+    SearchLimits limits;
+    limits.depth = depth;
+    limits.ponder = true;
+    PrepareSearch(ponderCtx, limits);
+    ponderFuture = std::async(std::launch::async, [](){ return Think(ponderCtx, ponderPos); });
+}
+
+void StopPonder(){
+    if(!ponderFuture.valid()) return;
+    ponderCtx.stop = true;
+    ponderFuture.get();
+}
+
+// Ponderhit: 'pos' is the position the ponder search was started on, so finish it up to its
+// depth limit and hand back the result. Otherwise (ponder miss) stop it and return false.
+bool TakePonderResult(const Position &pos, SearchResult &out){
+    if(!ponderFuture.valid()) return false;
+    if(!SamePosition(pos, ponderPos)){
+        StopPonder();
+        return false;
+    }
+    PonderHit(ponderCtx);
+    out = ponderFuture.get();
+    return out.best.fx!=-1;
+}
@@ -0,0 +1,168 @@
+#include "chess.h"
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+// Batch analysis: streams EPD/FEN lines from a file or stdin to a pool of workers and writes one
+// JSON object per position (JSONL, in completion order; "id" is the input line number).
+// Every worker owns its transposition table and search context and searches single-threaded,
+// so throughput scales with the number of workers. The input goes through a bounded queue,
+// which keeps memory flat however many positions there are. With --shm the workers instead
+// share a named shared-memory table, as do other batch or UCI processes using the same name,
+// so shards of one job running side by side search with each other's results.
+//
+//   chess batch [--depth N] [--movetime MS] [--threads N] [--hash MB] [--shm NAME]
+//               [--large-pages on|off] [--parallel-init] [--bind none|cores|nodes] [file|-]
+//
+// The EPD opcodes "acd" (depth) and "acs" (seconds) override the budget for their position.
+// The input may also be a packed position file (chess pack); "id" is then the record number,
+// and a malformed record gets an "invalid record" error.
+
+struct BatchJob {
+    uint64_t id = 0;
+    std::string line;
+    bool packed = false;   // the position is record, not line
+    PackedPosition record;
+};
+
+std::string JsonEscape(const std::string &s){
+    std::string out;
+    for(char c : s){
+        switch(c){
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if((unsigned char)c < 0x20){ char buf[8]; std::snprintf(buf, sizeof(buf), "\\u%04x", c); out += buf; }
+                else out += c;
+        }
+    }
+    return out;
+}
+
+// "fen", "bestmove", "score", "mate" (mate scores only), "depth" and "pv" members, comma-separated
+std::string AnalysisJson(const Position &pos, const SearchResult &res){
+    std::string pv;
+    Position p = pos;
+    if(!res.lines.empty()){
+        for(auto &m : res.lines[0].pv){
+            pv += (pv.empty() ? "\"" : ",\"") + MoveToUci(p.board, m) + "\"";
+            ApplyMove(p, m);
+        }
+    }
+    std::string out = "\"fen\":\"" + JsonEscape(ToFEN(pos)) + "\"";
+    out += ",\"bestmove\":\"" + MoveToUci(pos.board, res.best) + "\"";
+    out += ",\"score\":" + std::to_string(res.score);
+    if(IsMateScore(res.score)) out += ",\"mate\":" + std::to_string(MateInMoves(res.score));
+    out += ",\"depth\":" + std::to_string(res.depth);
+    out += ",\"pv\":[" + pv + "]";
+    return out;
+}
+
+static std::string AnalyzeJob(SearchContext &ctx, const BatchJob &job, const SearchLimits &defaults){
+    std::string head = "{\"id\":" + std::to_string(job.id);
+    Position pos;
+    std::vector<std::pair<std::string,std::string>> ops;
+    if(job.packed){
+        if(!UnpackPosition(job.record, pos)) return head + ",\"error\":\"invalid record\"}";
+    }
+    else if(!ParseEPD(job.line, pos, &ops))
+        return head + ",\"error\":\"invalid position\",\"line\":\"" + JsonEscape(job.line) + "\"}";
+
+    SearchLimits limits = defaults;
+    std::string epdId;
+    for(auto &op : ops){
+        if(op.first=="acd"){ limits.depth = std::atoi(op.second.c_str()); limits.movetimeMs = 0; }
+        else if(op.first=="acs"){ limits.movetimeMs = std::atoi(op.second.c_str())*1000; limits.depth = 0; }
+        else if(op.first=="id") epdId = op.second;
+    }
+
+    PrepareSearch(ctx, limits);
+    SearchResult res = Think(ctx, pos);
+
+    std::string out = head;
+    if(!epdId.empty()) out += ",\"epd_id\":\"" + JsonEscape(epdId) + "\"";
+    out += "," + AnalysisJson(pos, res);
+    out += ",\"nodes\":" + std::to_string(ctx.nodes.load());
+    out += ",\"time_ms\":" + std::to_string(NowMs() - ctx.startMs) + "}";
+    return out;
+}
+
+int RunBatch(int argc, char **argv){
+    SearchLimits defaults;
+    int threads = (int)std::max(1u, std::thread::hardware_concurrency());
+    size_t hashMb = 16;
+    std::string shmName;
+    std::string path = "-";
+    for(int i=2; i<argc; i++){
+        std::string a = argv[i];
+        if(a=="--depth" && i+1<argc) defaults.depth = std::atoi(argv[++i]);
+        else if(a=="--movetime" && i+1<argc) defaults.movetimeMs = std::atoi(argv[++i]);
+        else if(a=="--threads" && i+1<argc) threads = std::max(1, std::atoi(argv[++i]));
+        else if(a=="--hash" && i+1<argc) hashMb = std::max(1, std::atoi(argv[++i]));
+        else if(a=="--shm" && i+1<argc) shmName = argv[++i];
+        else if(ParseMemoryOption(argc, argv, i)) continue;
+        else if(!a.empty() && a[0]=='-' && a!="-"){ std::fprintf(stderr, "batch: unknown option %s\n", a.c_str()); return 1; }
+        else path = a;
+    }
+    if(defaults.depth==0 && defaults.movetimeMs==0) defaults.depth = 6;
+    if(!shmName.empty()){
+        TranspositionTable probe;
+        if(!AttachSharedTT(probe, shmName, hashMb)){ std::fprintf(stderr, "batch: cannot attach shared hash %s\n", shmName.c_str()); return 1; }
+    }
+
+    PackedFile packed;
+    std::ifstream file;
+    std::istream *in = &std::cin;
+    if(path!="-" && !OpenPackedFile(packed, path)){
+        file.open(path);
+        if(!file){ std::fprintf(stderr, "batch: cannot open %s\n", path.c_str()); return 1; }
+        in = &file;
+    }
+
+    BoundedQueue<BatchJob> queue((size_t)threads * 4);
+    std::mutex outMutex;
+    std::vector<std::thread> workers;
+    for(int t=0; t<threads; t++){
+        workers.emplace_back([&, t](){
+            BindThisThread(t); // before the table, so its pages land on this thread's node
+            TranspositionTable table;
+            if(shmName.empty() || !AttachSharedTT(table, shmName, hashMb)) ResizeTT(table, hashMb);
+            if(t==0) std::fprintf(stderr, "batch: hash %s%s\n", DescribeTT(table).c_str(), shmName.empty() ? " per worker" : "");
+            SearchContext ctx;
+            ctx.tt = &table;
+            ctx.parallelRoot = false;
+            BatchJob job;
+            while(queue.Pop(job)){
+                std::string line = AnalyzeJob(ctx, job, defaults) + "\n";
+                std::lock_guard<std::mutex> lk(outMutex);
+                std::fwrite(line.data(), 1, line.size(), stdout);
+                std::fflush(stdout);
+            }
+        });
+    }
+
+    for(size_t i=0; i<packed.count; i++){
+        BatchJob job;
+        job.id = i+1;
+        job.packed = true;
+        job.record = packed.records[i];
+        queue.Push(std::move(job));
+    }
+    std::string line;
+    uint64_t id = 0;
+    while(!packed.records && std::getline(*in, line)){
+        id++;
+        if(!line.empty() && line.back()=='\r') line.pop_back();
+        if(line.find_first_not_of(" \t")==std::string::npos || line[0]=='#') continue;
+        BatchJob job;
+        job.id = id;
+        job.line = line;
+        queue.Push(std::move(job));
+    }
+    queue.Close();
+    for(auto &w : workers) w.join();
+    return 0;
+}
@@ -0,0 +1,197 @@
+#include "chess.h"
+#include "endgame.h"
+#include <cstdio>
+
+// Endgame bitbases for king + pawn/rook/queen against a lone king.
+//
+// Every table covers all placements with the strong side normalised to White (Black's
+// positions are mirrored top to bottom): side to move x strong king x weak king x piece =
+// 2*64*64*64 positions, one bit each (1 = the strong side wins), 64 KB per table.
+// Tables are generated by fixed-point iteration over the whole index space, split across all
+// cores, when asked for ("chess bitbase --generate"), and written to disk; the engine only
+// reads them back, and probes fail for tables it has not loaded. KQK and KRK are built first
+// so KPK can look up the position after a promotion.
+
+enum BitbaseKind { BB_KQK, BB_KRK, BB_KPK, BB_COUNT };
+static const PieceType BB_PIECE[BB_COUNT] = { PT_QUEEN, PT_ROOK, PT_PAWN };
+static const char *BB_NAME[BB_COUNT] = { "kqk", "krk", "kpk" };
+static const int BB_SIZE = ENDGAME_SIZE;
+static const uint32_t BB_MAGIC = 0x31424243; // "CBB1"
+
+enum { BBS_UNKNOWN=0, BBS_WIN, BBS_DRAW, BBS_INVALID };
+
+static std::vector<uint64_t> bitbasesG[BB_COUNT];
+static std::atomic<bool> bitbaseLoadedG[BB_COUNT];
+
+static inline bool BBWin(BitbaseKind k, int idx){ return (bitbasesG[k][idx>>6] >> (idx&63)) & 1; }
+
+// Result of one position given the current table: BBS_WIN, BBS_DRAW or BBS_UNKNOWN (undecided yet).
+static int Classify(BitbaseKind kind, const std::atomic<uint8_t> *st, int idx){
+    PieceType pt = BB_PIECE[kind];
+    int stm, sk, wk, ps;
+    SplitEndgameIndex(idx, stm, sk, wk, ps);
+    auto win = [&](int i){ return st[i].load(std::memory_order_relaxed)==BBS_WIN; };
+
+    if(stm==0){
+        for(int d=0; d<8; d++){
+            int x = (sk&7)+KING_DX[d], y = (sk>>3)+KING_DY[d], t = y*8+x;
+            if(!OnBoard(x,y) || t==ps || KingsTouch(t, wk)) continue;
+            if(win(EndgameIndex(1, t, wk, ps))) return BBS_WIN;
+        }
+        if(pt==PT_PAWN){
+            int t = ps-8;
+            if(t==sk || t==wk) return BBS_UNKNOWN;
+            if((t>>3)==0) // promotion: the same squares in the queen or rook table
+                return BBWin(BB_KQK, EndgameIndex(1, sk, wk, t)) || BBWin(BB_KRK, EndgameIndex(1, sk, wk, t)) ? BBS_WIN : BBS_UNKNOWN;
+            if(win(EndgameIndex(1, sk, wk, t))) return BBS_WIN;
+            if((ps>>3)==6 && t-8!=sk && t-8!=wk && win(EndgameIndex(1, sk, wk, t-8))) return BBS_WIN;
+            return BBS_UNKNOWN;
+        }
+        int targets[32];
+        int n = PieceTargets(pt, ps, sk, wk, targets);
+        for(int i=0; i<n; i++) if(win(EndgameIndex(1, sk, wk, targets[i]))) return BBS_WIN;
+        return BBS_UNKNOWN;
+    }
+
+    // weak side to move: lost only if every legal move loses
+    int moves[8];
+    int n = WeakMoves(pt, sk, wk, ps, moves);
+    if(n<0) return BBS_DRAW; // takes the undefended piece
+    if(n==0) return PieceAttacks(pt, ps, wk, sk) ? BBS_WIN : BBS_DRAW;
+    for(int i=0; i<n; i++) if(!win(moves[i])) return BBS_UNKNOWN;
+    return BBS_WIN;
+}
+
+static void GenerateBitbase(BitbaseKind kind, int threads){
+    PieceType pt = BB_PIECE[kind];
+    std::unique_ptr<std::atomic<uint8_t>[]> st(new std::atomic<uint8_t>[BB_SIZE]);
+    RunParallel(threads, [&](int lo, int hi){
+        for(int idx=lo; idx<hi; idx++)
+            st[idx].store(EndgameInvalid(pt, idx) ? BBS_INVALID : BBS_UNKNOWN, std::memory_order_relaxed);
+    });
+    Iterate(threads, [&](int idx){
+        if(st[idx].load(std::memory_order_relaxed)!=BBS_UNKNOWN) return false;
+        int r = Classify(kind, st.get(), idx);
+        if(r==BBS_UNKNOWN) return false;
+        st[idx].store((uint8_t)r, std::memory_order_relaxed);
+        return true;
+    });
+    // whatever is still undecided cannot be forced: a draw
+    std::vector<uint64_t> &bits = bitbasesG[kind];
+    bits.assign(BB_SIZE/64, 0);
+    for(int idx=0; idx<BB_SIZE; idx++)
+        if(st[idx]==BBS_WIN) bits[idx>>6] |= 1ULL << (idx&63);
+}
+
+static std::string BitbasePath(const std::string &dir, BitbaseKind kind){
+    return (dir.empty() ? "." : dir) + "/" + BB_NAME[kind] + ".bb";
+}
+
+static bool LoadBitbase(const std::string &dir, BitbaseKind kind){
+    FILE *f = std::fopen(BitbasePath(dir, kind).c_str(), "rb");
+    if(!f) return false;
+    uint32_t magic = 0;
+    std::vector<uint64_t> bits(BB_SIZE/64);
+    bool ok = std::fread(&magic, sizeof(magic), 1, f)==1 && magic==BB_MAGIC
+        && std::fread(bits.data(), sizeof(uint64_t), bits.size(), f)==bits.size()
+        && std::fgetc(f)==EOF;
+    std::fclose(f);
+    if(ok) bitbasesG[kind] = std::move(bits);
+    return ok;
+}
+
+static bool SaveBitbase(const std::string &dir, BitbaseKind kind){
+    FILE *f = std::fopen(BitbasePath(dir, kind).c_str(), "wb");
+    if(!f) return false;
+    bool ok = std::fwrite(&BB_MAGIC, sizeof(BB_MAGIC), 1, f)==1
+        && std::fwrite(bitbasesG[kind].data(), sizeof(uint64_t), bitbasesG[kind].size(), f)==bitbasesG[kind].size();
+    return std::fclose(f)==0 && ok;
+}
+
+// Not while a search may be probing: a table is swapped as a whole.
+bool LoadBitbases(const std::string &dir){
+    bool all = true;
+    for(int k=0; k<BB_COUNT; k++){
+        bitbaseLoadedG[k] = false;
+        bool ok = LoadBitbase(dir, (BitbaseKind)k);
+        bitbaseLoadedG[k] = ok;
+        all = all && ok;
+    }
+    return all;
+}
+
+bool GenerateBitbases(const std::string &dir){
+    int threads = (int)std::max(1u, std::thread::hardware_concurrency());
+    bool ok = true;
+    for(int k=0; k<BB_COUNT; k++){
+        bitbaseLoadedG[k] = false;
+        GenerateBitbase((BitbaseKind)k, threads);
+        bitbaseLoadedG[k] = true;
+        ok = SaveBitbase(dir, (BitbaseKind)k) && ok;
+    }
+    return ok;
+}
+
+bool ProbeBitbase(const Piece b[8][8], Color side, int &result){
+    int count = 0, kings[3] = {-1,-1,-1}, ps = -1;
+    PieceType pt = PT_NONE;
+    Color strong = C_NONE;
+    for(int y=0;y<8;y++) for(int x=0;x<8;x++){
+        const Piece &p = b[y][x];
+        if(p.type==PT_NONE) continue;
+        if(++count > 3) return false;
+        if(p.type==PT_KING) kings[p.color] = y*8+x;
+        else { pt = p.type; strong = p.color; ps = y*8+x; }
+    }
+    if(count!=3 || ps<0 || kings[C_WHITE]<0 || kings[C_BLACK]<0) return false;
+    BitbaseKind kind;
+    if(pt==PT_QUEEN) kind = BB_KQK;
+    else if(pt==PT_ROOK) kind = BB_KRK;
+    else if(pt==PT_PAWN) kind = BB_KPK;
+    else return false;
+    if(!bitbaseLoadedG[kind].load(std::memory_order_relaxed)) return false;
+
+    // mirror so the strong side plays up the board as White
+    auto norm = [&](int sq){ return strong==C_WHITE ? sq : (7-(sq>>3))*8 + (sq&7); };
+    int stm = side==strong ? 0 : 1;
+    bool win = BBWin(kind, EndgameIndex(stm, norm(kings[strong]), norm(kings[Opp(strong)]), norm(ps)));
+    result = !win ? 0 : (stm==0 ? 1 : -1);
+    return true;
+}
+
+//   chess bitbase [--dir DIR] [--generate] [FEN]
+// Loads the tables from DIR, or with --generate builds them and writes them there, and prints
+// how many positions of each are wins, or the result of one position.
+int RunBitbaseTool(int argc, char **argv){
+    std::string dir = ".", fen;
+    bool generate = false;
+    for(int i=2; i<argc; i++){
+        std::string a = argv[i];
+        if(a=="--dir" && i+1<argc) dir = argv[++i];
+        else if(a=="--generate") generate = true;
+        else if(a.size()>2 && a.compare(0, 2, "--")==0){ std::fprintf(stderr, "bitbase: unknown option %s\n", a.c_str()); return 1; }
+        else fen += (fen.empty() ? "" : " ") + a;
+    }
+    int64_t t0 = NowMs();
+    if(generate && !GenerateBitbases(dir)){ std::fprintf(stderr, "bitbase: cannot write the tables to %s\n", dir.c_str()); return 1; }
+    if(!generate && !LoadBitbases(dir)){
+        std::fprintf(stderr, "bitbase: no complete set of tables in %s (chess bitbase --generate --dir %s)\n", dir.c_str(), dir.c_str());
+        return 1;
+    }
+    if(!fen.empty()){
+        Position pos;
+        int result;
+        if(!ParseFEN(fen, pos)){ std::fprintf(stderr, "bitbase: invalid fen\n"); return 1; }
+        if(!ProbeBitbase(pos.board, pos.side, result)){ std::printf("not in the bitbases\n"); return 0; }
+        std::printf("%s\n", result>0 ? "win" : result<0 ? "loss" : "draw");
+        return 0;
+    }
+    for(int k=0; k<BB_COUNT; k++){
+        uint64_t wins[2] = {0, 0};
+        for(int idx=0; idx<BB_SIZE; idx++) if(BBWin((BitbaseKind)k, idx)) wins[idx>>18]++;
+        std::printf("%s: %llu wins with the strong side to move, %llu with the weak side to move\n", BB_NAME[k],
+                    (unsigned long long)wins[0], (unsigned long long)wins[1]);
+    }
+    std::printf("%lld ms\n", (long long)(NowMs()-t0));
+    return 0;
+}
@@ -0,0 +1,239 @@
+#include "chess.h"
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <queue>
+
+// Opening-book builder: turns a PGN archive into a Polyglot book that OpenBook maps directly.
+//
+//   chess buildbook -o BOOK [--plies N] [--min-games N] [--threads N] [--mem MB] [file|-]
+//
+// Workers replay games and collect one record per (position, move) for the first N plies.
+// When a worker's buffer reaches its share of --mem it is sorted, merged and written out as a
+// run file; at the end the runs are k-way merged into the book, so the archive never has to
+// fit in memory. A move's weight is 2 per win and 1 per draw for the side that played it,
+// scaled per position to fit Polyglot's 16 bits.
+
+struct BookRecord {
+    uint64_t key;
+    uint32_t points; // 2 per win, 1 per draw for the mover
+    uint32_t games;
+    uint16_t move;
+};
+
+static bool RecordLess(const BookRecord &a, const BookRecord &b){
+    return a.key!=b.key ? a.key<b.key : a.move<b.move;
+}
+
+// sort and fold identical (key, move) pairs together
+static void SortAndCombine(std::vector<BookRecord> &recs){
+    std::sort(recs.begin(), recs.end(), RecordLess);
+    size_t out = 0;
+    for(size_t i=0; i<recs.size(); i++){
+        if(out>0 && recs[out-1].key==recs[i].key && recs[out-1].move==recs[i].move){
+            recs[out-1].points += recs[i].points;
+            recs[out-1].games += recs[i].games;
+        } else recs[out++] = recs[i];
+    }
+    recs.resize(out);
+}
+
+struct BookBuilder {
+    std::string output;
+    int plies = 20;
+    uint32_t minGames = 1;
+    size_t recordsPerRun = 0;
+    std::mutex runMutex;
+    std::vector<std::string> runs;
+    std::atomic<uint64_t> games{0}, skipped{0};
+};
+
+// Run files hold the fields back to back (host byte order; they never leave this machine), so
+// no struct padding reaches the disk.
+static const size_t RUN_RECORD = 8 + 4 + 4 + 2;
+
+static void EncodeRecord(const BookRecord &r, unsigned char *p){
+    std::memcpy(p, &r.key, 8);
+    std::memcpy(p+8, &r.points, 4);
+    std::memcpy(p+12, &r.games, 4);
+    std::memcpy(p+16, &r.move, 2);
+}
+
+static void DecodeRecord(const unsigned char *p, BookRecord &r){
+    std::memcpy(&r.key, p, 8);
+    std::memcpy(&r.points, p+8, 4);
+    std::memcpy(&r.games, p+12, 4);
+    std::memcpy(&r.move, p+16, 2);
+}
+
+static bool WriteRun(BookBuilder &bb, std::vector<BookRecord> &recs){
+    if(recs.empty()) return true;
+    SortAndCombine(recs);
+    std::string name;
+    {
+        std::lock_guard<std::mutex> lk(bb.runMutex);
+        name = bb.output + ".run" + std::to_string(bb.runs.size()) + ".tmp";
+        bb.runs.push_back(name);
+    }
+    FILE *f = std::fopen(name.c_str(), "wb");
+    std::vector<unsigned char> bytes(recs.size() * RUN_RECORD);
+    for(size_t i=0; i<recs.size(); i++) EncodeRecord(recs[i], &bytes[i*RUN_RECORD]);
+    recs.clear();
+    if(!f) return false;
+    bool ok = std::fwrite(bytes.data(), 1, bytes.size(), f)==bytes.size();
+    return std::fclose(f)==0 && ok;
+}
+
+static void CollectGame(BookBuilder &bb, const PgnGame &game, std::vector<BookRecord> &recs){
+    int whitePoints;
+    if(game.result=="1-0") whitePoints = 2;
+    else if(game.result=="0-1") whitePoints = 0;
+    else if(game.result=="1/2-1/2") whitePoints = 1;
+    else { bb.skipped++; return; } // unfinished games say nothing about the moves
+
+    Position start;
+    std::vector<Move> moves;
+    if(!ReplayPgnGame(game, start, moves) && moves.empty()){ bb.skipped++; return; }
+    bb.games++;
+    Position pos = start;
+    for(size_t i=0; i<moves.size() && (int)i<bb.plies; i++){
+        BookRecord r;
+        r.key = PolyglotKey(pos);
+        r.move = PolyglotMove(pos.board, moves[i]);
+        r.points = pos.side==C_WHITE ? whitePoints : 2-whitePoints;
+        r.games = 1;
+        recs.push_back(r);
+        ApplyMove(pos, moves[i]);
+    }
+}
+
+static void PutBE(unsigned char *p, uint64_t v, int n){
+    for(int i=n-1;i>=0;i--){ p[i] = (unsigned char)(v & 0xFF); v >>= 8; }
+}
+
+// buffered sequential reader over one run file
+struct RunReader {
+    FILE *f = nullptr;
+    std::vector<unsigned char> buf;
+    size_t pos = 0;
+    ~RunReader(){ if(f) std::fclose(f); }
+    bool Next(BookRecord &r){
+        if(pos==buf.size()){
+            buf.resize(4096 * RUN_RECORD);
+            size_t n = std::fread(buf.data(), RUN_RECORD, 4096, f);
+            buf.resize(n * RUN_RECORD);
+            pos = 0;
+            if(n==0) return false;
+        }
+        DecodeRecord(&buf[pos], r);
+        pos += RUN_RECORD;
+        return true;
+    }
+};
+
+// k-way merge of the sorted runs; entries of one position are gathered, scaled and written.
+// The readers and the output close themselves on every way out.
+static bool MergeRuns(BookBuilder &bb, uint64_t &written){
+    std::vector<RunReader> readers(bb.runs.size());
+    using Head = std::pair<BookRecord, size_t>;
+    auto cmp = [](const Head &a, const Head &b){ return RecordLess(b.first, a.first); };
+    std::priority_queue<Head, std::vector<Head>, decltype(cmp)> heap(cmp);
+    for(size_t i=0; i<readers.size(); i++){
+        readers[i].f = std::fopen(bb.runs[i].c_str(), "rb");
+        if(!readers[i].f) return false;
+        BookRecord r;
+        if(readers[i].Next(r)) heap.push({r, i});
+    }
+    std::unique_ptr<FILE, int(*)(FILE*)> outFile(std::fopen(bb.output.c_str(), "wb"), std::fclose);
+    FILE *out = outFile.get();
+    if(!out) return false;
+
+    std::vector<BookRecord> group; // all moves of the current position
+    auto flush = [&](){
+        std::vector<BookRecord> keep;
+        uint32_t maxPoints = 0;
+        for(auto &r : group) if(r.games >= bb.minGames){ keep.push_back(r); maxPoints = std::max(maxPoints, r.points); }
+        // Polyglot convention: best move first
+        std::stable_sort(keep.begin(), keep.end(), [](const BookRecord &a, const BookRecord &b){ return a.points > b.points; });
+        for(auto &r : keep){
+            uint64_t w = maxPoints > 0xFFFF ? (uint64_t)r.points * 0xFFFF / maxPoints : r.points;
+            unsigned char e[16] = {};
+            PutBE(e, r.key, 8);
+            PutBE(e+8, r.move, 2);
+            PutBE(e+10, w, 2);
+            std::fwrite(e, 1, 16, out);
+            written++;
+        }
+        group.clear();
+    };
+    while(!heap.empty()){
+        Head h = heap.top();
+        heap.pop();
+        BookRecord r;
+        if(readers[h.second].Next(r)) heap.push({r, h.second});
+        if(!group.empty() && group.back().key!=h.first.key) flush();
+        if(!group.empty() && group.back().move==h.first.move){
+            group.back().points += h.first.points;
+            group.back().games += h.first.games;
+        } else group.push_back(h.first);
+    }
+    flush();
+    return std::fclose(outFile.release())==0;
+}
+
+int RunBuildBook(int argc, char **argv){
+    BookBuilder bb;
+    int threads = (int)std::max(1u, std::thread::hardware_concurrency());
+    size_t memMb = 256;
+    std::string path = "-";
+    for(int i=2; i<argc; i++){
+        std::string a = argv[i];
+        if(a=="-o" && i+1<argc) bb.output = argv[++i];
+        else if(a=="--plies" && i+1<argc) bb.plies = std::max(1, std::atoi(argv[++i]));
+        else if(a=="--min-games" && i+1<argc) bb.minGames = (uint32_t)std::max(1, std::atoi(argv[++i]));
+        else if(a=="--threads" && i+1<argc) threads = std::max(1, std::atoi(argv[++i]));
+        else if(a=="--mem" && i+1<argc) memMb = std::max(1, std::atoi(argv[++i]));
+        else if(!a.empty() && a[0]=='-' && a!="-"){ std::fprintf(stderr, "buildbook: unknown option %s\n", a.c_str()); return 1; }
+        else path = a;
+    }
+    if(bb.output.empty()){ std::fprintf(stderr, "buildbook: -o BOOK is required\n"); return 1; }
+    bb.recordsPerRun = std::max<size_t>(1024, memMb*1024*1024 / sizeof(BookRecord) / threads);
+
+    std::ifstream file;
+    std::istream *in = &std::cin;
+    if(path!="-"){
+        file.open(path, std::ios::binary);
+        if(!file){ std::fprintf(stderr, "buildbook: cannot open %s\n", path.c_str()); return 1; }
+        in = &file;
+    }
+
+    int64_t t0 = NowMs();
+    BoundedQueue<PgnGame> queue((size_t)threads * 16);
+    std::atomic<bool> ioError{false};
+    std::vector<std::thread> workers;
+    for(int t=0; t<threads; t++){
+        workers.emplace_back([&](){
+            std::vector<BookRecord> recs;
+            recs.reserve(bb.recordsPerRun);
+            PgnGame game;
+            while(queue.Pop(game)){
+                CollectGame(bb, game, recs);
+                if(recs.size() >= bb.recordsPerRun && !WriteRun(bb, recs)) ioError = true;
+            }
+            if(!WriteRun(bb, recs)) ioError = true;
+        });
+    }
+    PgnGame game;
+    while(ReadPgnGame(*in, game)) queue.Push(game);
+    queue.Close();
+    for(auto &w : workers) w.join();
+
+    uint64_t entries = 0;
+    bool ok = !ioError && MergeRuns(bb, entries);
+    for(auto &r : bb.runs) std::remove(r.c_str());
+    if(!ok){ std::fprintf(stderr, "buildbook: cannot write %s\n", bb.output.c_str()); return 1; }
+    std::fprintf(stderr, "buildbook: %llu games (%llu skipped), %zu runs, %llu entries, %lld ms\n",
+                 (unsigned long long)bb.games.load(), (unsigned long long)bb.skipped.load(), bb.runs.size(),
+                 (unsigned long long)entries, (long long)(NowMs()-t0));
+    return 0;
+}
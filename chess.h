@@ -1,6 +1,7 @@
 #ifndef CHESS_H
 #define CHESS_H
 
+#ifdef _WIN32
 #ifndef GET_X_LPARAM
 #define GET_X_LPARAM(lp) ((int)(short)LOWORD(lp))
 #endif
@@ -9,6 +10,9 @@
 #endif
 
 #include <windows.h>
+#endif
+#include <cstdint>
+#include <cstdlib>
 #include <vector>
 #include <string>
 #include <random>
@@ -19,11 +23,18 @@
 #include <optional>
 #include <future>
 #include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <iosfwd>
+#include <cstdio>
 
 // types/enums
 enum PieceType { PT_NONE=0, PT_PAWN, PT_KNIGHT, PT_BISHOP, PT_ROOK, PT_QUEEN, PT_KING };
 enum Color { C_NONE=0, C_WHITE=1, C_BLACK=2 };
-enum MenuIDs {ID_NEW_GAME = 1,ID_UNDO,ID_TOGGLE_AI,ID_FLIP_BOARD,ID_FLIP_SIDE,ID_SHOW_LEGAL,ID_EXIT};
+enum MenuIDs {ID_NEW_GAME = 1,ID_UNDO,ID_TOGGLE_AI,ID_FLIP_BOARD,ID_FLIP_SIDE,ID_SHOW_LEGAL,ID_EXIT,ID_TOGGLE_PONDER,ID_REDO};
 
 struct Piece {
     PieceType type = PT_NONE;
@@ -40,18 +51,345 @@ struct Move {
     Move(int a,int b,int c,int d):fx(a),fy(b),tx(c),ty(d){}
 };
 
-// Undo: store full board snapshot and side and lastMove
-struct UndoEntry {
+// Full position state for the headless front-ends (UCI, tools); the GUI keeps its own globals
+struct Position {
     Piece board[8][8];
-	int halfmoveClock;
-    Color side;
+    Color side = C_WHITE;
     Move lastMove;
+    int halfmoveClock = 0;
+    int fullmoveNumber = 1;
+};
+
+// One ply of a game's history (history.cpp): the move and the state it destroyed
+struct HistoryEntry {
+    uint64_t key = 0;           // RepetitionKey of the position the move was played from
+    uint32_t move = 0;          // PackMove
+    uint16_t halfmoveClock = 0; // before the move
+    uint8_t captured = 0;       // piece type, colour and moved flag; 0 = none
+    uint8_t flags = 0;
+};
+
+// A game from its start position: plies [0, played) lead to the current position, the rest
+// were undone and can be redone.
+struct GameHistory {
+    Position start;
+    std::vector<HistoryEntry> plies;
+    size_t played = 0;
+};
+
+// One game from a PGN file: tag pairs, the mainline SAN moves and the result token
+struct PgnGame {
+    std::vector<std::pair<std::string,std::string>> tags;
+    std::vector<std::string> sans;
+    std::string result;
+};
+
+// Search limits; zero means "no limit" for depth, movetime and nodes
+struct SearchLimits {
+    int depth = 0;
+    int movetimeMs = 0;
+    uint64_t nodes = 0;
+    bool infinite = false; // keep searching until stopped
+    bool ponder = false;   // searching the expected reply; limits apply only after PonderHit
+    int multiPV = 1;       // number of best root moves to search exactly and report
+    int mate = 0;          // "go mate N": prove a mate in at most N moves instead of searching
+    int skill = 0;         // 1..SKILL_LEVELS-1 plays weaker on a fixed node budget (SkillFor); 0 = full strength
+};
+
+// A playing strength below full. The node budget replaces the clock, so a move always costs
+// the same search; the move played is the best of up to multiPV lines once each line's score
+// gets a bonus of 0..spread centipawns drawn from the position and level.
+struct SkillLevel {
+    uint64_t nodes;
+    int multiPV;
+    int spread;
+};
+const int SKILL_LEVELS = 20; // level SKILL_LEVELS is full strength
+
+// Progress report after each completed iteration, one per PV line
+struct SearchInfo {
+    int multiPV = 1; // 1-based rank of this line
+    int depth = 0;
+    int score = 0;
+    uint64_t nodes = 0;
+    int64_t timeMs = 0;
+    std::vector<Move> pv;
+};
+
+// One ranked candidate from a multi-PV search
+struct PVLine {
+    Move move;
+    int score = 0;
+    int depth = 0;
+    std::vector<Move> pv;
+};
+
+struct SearchResult {
+    Move best;
+    Move ponder; // expected reply, fx==-1 if unknown
+    int score = 0;
+    int depth = 0;
+    std::vector<PVLine> lines; // best first, limits.multiPV entries (fewer if there are fewer legal moves)
+};
+
+// Evaluation parameters (weights.cpp). Tables are [PieceType][y][x] from White's side and
+// mirrored for Black. The tuner sees them as one flat vector of EVAL_PARAM_COUNT ints.
+struct EvalWeights {
+    int piece[7];       // material by PieceType
+    int pst[7][8][8];   // piece-square bonus
+    int mobility;       // per reachable square
+};
+const int PST_PARAM = 7;
+const int MOBILITY_PARAM = PST_PARAM + 7*64;
+const int EVAL_PARAM_COUNT = MOBILITY_PARAM + 1;
+
+struct NnueNet; // neural network evaluation (nnue.cpp)
+
+// index of the lowest set bit of a non-zero bitboard
+inline int LowestBit(uint64_t x){
+#if defined(_MSC_VER)
+    unsigned long i;
+    _BitScanForward64(&i, x);
+    return (int)i;
+#else
+    return __builtin_ctzll(x);
+#endif
+}
+
+// What every piece attacks and what holds the side to move's king, from bitboards (evalbb.cpp).
+// A search node builds one at most once and hands it to legality (GenerateLegalMoves) and
+// exchange evaluation (StaticExchange); the evaluation keeps its dispatched kernels, which are
+// faster than scoring from the map. Bit y*8+x stands for board[y][x].
+struct AttackMap {
+    uint64_t pieces[2][7];  // [white, black][PieceType]
+    uint64_t occ[2];
+    uint64_t attacks[64];   // of the piece on each occupied square; pawns: the two diagonals
+    uint64_t attackedBy[2];
+    // the side to move's king
+    int king = -1;          // square, -1 if there is none
+    uint64_t checkers = 0;
+    uint64_t evasion = ~0ULL;  // where a non-king move may land: the checker and the ray to it
+    uint64_t kingDanger = 0;   // squares the king may not step to (attacked, or behind it on a checking line)
+    uint64_t pinned = 0;
+    uint64_t pinRay[8] = {};   // per direction, the squares a piece pinned along it may move on
+};
+
+// Named read-write shared memory (mapfile.cpp): every process on the host that opens the same
+// name maps the same pages. data is nullptr when nothing is mapped.
+struct SharedMemory {
+    unsigned char *data = nullptr;
+    size_t size = 0;
+    bool created = false; // this process made the segment, so it starts zero-filled
+#ifdef _WIN32
+    HANDLE mapping = nullptr;
+#endif
+    SharedMemory() {}
+    SharedMemory(const SharedMemory&) = delete;
+    SharedMemory &operator=(const SharedMemory&) = delete;
+    ~SharedMemory();
+};
+
+// Large page-aligned block (memory.cpp), in huge pages when the OS grants them. data is
+// nullptr when nothing is allocated; fresh blocks are zero-filled.
+struct LargeMemory {
+    void *data = nullptr;
+    size_t size = 0;
+    size_t pageSize = 0;      // of the pages obtained
+    bool transparent = false; // Linux: huge pages were asked for with madvise and come as memory is touched
+    LargeMemory() {}
+    LargeMemory(const LargeMemory&) = delete;
+    LargeMemory &operator=(const LargeMemory&) = delete;
+    ~LargeMemory();
+};
+
+// How search and worker threads are bound to processors (memory.cpp)
+enum ThreadBinding { BIND_NONE, BIND_CORES, BIND_NODES };
+
+// Transposition table: fixed-size buckets of two lockless slots (key stored xor data, so a
+// torn write just reads as a miss). Search threads share it without taking a lock, and so can
+// processes when the slots live in a shared segment (AttachSharedTT).
+struct TTSlot {
+    std::atomic<uint64_t> keyXor{0};
+    std::atomic<uint64_t> data{0};
+};
+struct TranspositionTable {
+    TTSlot *slots = nullptr;
+    size_t count = 0; // power of two
+    std::atomic<uint8_t> generation{0}; // of the current search (NextTTGeneration)
+    std::unique_ptr<LargeMemory> heap;    // a private table owns its slots,
+    std::unique_ptr<SharedMemory> shared; // a shared one maps them
+};
+
+// Search control shared between the search threads and whoever drives them (GUI, UCI).
+// Call PrepareSearch before each Think.
+struct SearchContext {
+    TranspositionTable *tt = nullptr; // nullptr = the shared table
+    bool parallelRoot = true;         // one task per root move; tools running many searches turn this off
+    bool ageTT = true;                // PrepareSearch starts a new table generation; off when many searches
+                                      // share a table whose owner calls NextTTGeneration once per batch
+    const EvalWeights *weights = nullptr; // nullptr = evalWeightsG
+    const NnueNet *net = nullptr;         // nullptr = the network set by SetNnue, if any
+    SearchLimits limits;
+    std::atomic<bool> stop{false};
+    std::atomic<bool> pondering{false};
+    std::atomic<uint64_t> nodes{0};
+    std::atomic<int> completedDepth{0};
+    std::atomic<int64_t> startMs{0}; // reset on ponderhit
+};
+
+struct MateResult {
+    int moves = 0;       // length of the shortest forced mate, 0 if none was found
+    Move best;
+    int solutions = 0;   // first moves that mate as fast (only counted on request)
+    std::vector<Move> pv;
+};
+
+const int MAX_SEARCH_DEPTH = 64;
+const int TB_WIN_SCORE = 20000; // tablebase wins: above any evaluation, below mate
+
+// Checkmate scores: MATE_SCORE - plies to mate from the root (negative when being mated).
+const int MATE_SCORE = 1000000;
+const int MATE_BOUND = MATE_SCORE - 1000;
+inline bool IsMateScore(int s){ return s > MATE_BOUND || s < -MATE_BOUND; }
+// moves to mate, negative when the side to move gets mated
+inline int MateInMoves(int s){ return s > 0 ? (MATE_SCORE - s + 1) / 2 : -(MATE_SCORE + s) / 2; }
+
+// Bounded blocking queue for the batch tools: producers block while it is full, so memory
+// stays constant however large the input is. Pop returns false once closed and drained.
+template<typename T>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(size_t capacity) : cap(capacity) {}
+    void Push(T item){
+        std::unique_lock<std::mutex> lk(m);
+        notFull.wait(lk, [this]{ return q.size() < cap; });
+        q.push_back(std::move(item));
+        notEmpty.notify_one();
+    }
+    bool Pop(T &item){
+        std::unique_lock<std::mutex> lk(m);
+        notEmpty.wait(lk, [this]{ return !q.empty() || closed; });
+        if(q.empty()) return false;
+        item = std::move(q.front());
+        q.pop_front();
+        notFull.notify_one();
+        return true;
+    }
+    void Close(){
+        std::lock_guard<std::mutex> lk(m);
+        closed = true;
+        notEmpty.notify_all();
+    }
+private:
+    std::mutex m;
+    std::condition_variable notFull, notEmpty;
+    std::deque<T> q;
+    size_t cap;
+    bool closed = false;
+};
+
+// Cooperative work-stealing scheduler (scheduler.cpp). A job is called again and again, one
+// slice each time, until it returns true. Each worker runs its own queue round-robin, so all
+// its jobs advance at the same rate, and takes jobs from another worker's queue when its own
+// is empty. Jobs must not block.
+class TaskScheduler {
+public:
+    explicit TaskScheduler(int threads);
+    ~TaskScheduler(); // waits for the jobs
+    void Submit(std::function<bool()> job);
+    void Wait(); // until every job submitted so far has finished
+private:
+    struct Queue {
+        std::mutex m;
+        std::deque<std::function<bool()>> jobs;
+    };
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> threads;
+    std::mutex m; // idle workers and Wait sleep on it
+    std::condition_variable work, finished;
+    std::atomic<size_t> queued{0}, nextQueue{0};
+    std::atomic<int> idle{0};
+    size_t pending = 0; // submitted and not finished, under m
+    bool quit = false;
+    void Run(int index);
+    bool Take(int index, std::function<bool()> &job);
+    void Requeue(int index, std::function<bool()> job);
+};
+
+// Read-only memory-mapped file (mapfile.cpp); data is nullptr when nothing is mapped
+struct MappedFile {
+    const unsigned char *data = nullptr;
+    size_t size = 0;
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = nullptr;
+#endif
+    MappedFile() {}
+    MappedFile(const MappedFile&) = delete;
+    MappedFile &operator=(const MappedFile&) = delete;
+    ~MappedFile();
+};
+
+// One position in 32 bytes (packed.cpp), for training and analysis sets: the occupied squares
+// (bit y*8+x is board[y][x]) and a nibble per occupied square in bit order, low nibble first:
+// the piece type, PACKED_EP_PAWN for a pawn that has just stepped two squares, plus 8 for
+// Black. Moved flags follow from the castling rights and pawn rows, as with FEN.
+const int PACKED_EP_PAWN = 7;
+const int16_t PACKED_NO_SCORE = INT16_MIN;
+enum PackedFlag : uint8_t {
+    PF_BLACK_TO_MOVE = 1,
+    PF_WHITE_OO = 2, PF_WHITE_OOO = 4, PF_BLACK_OO = 8, PF_BLACK_OOO = 16,
+};
+enum PackedResult { PR_UNKNOWN, PR_WHITE_WINS, PR_DRAW, PR_BLACK_WINS }; // flags bits 5-6
+
+struct PackedPosition {
+    uint64_t occupied = 0;
+    uint8_t pieces[16] = {};
+    uint8_t flags = 0;
+    uint8_t halfmoveClock = 0;          // capped at 255
+    uint16_t fullmoveNumber = 1;
+    int16_t score = PACKED_NO_SCORE;    // centipawns for the side to move
+    uint16_t move = 0;                  // best or played move as PolyglotMove; 0 = none
+};
+static_assert(sizeof(PackedPosition)==32, "PackedPosition layout");
+
+// A packed position file mapped read-only: a header, then count records
+struct PackedFile {
+    MappedFile map;
+    const PackedPosition *records = nullptr;
+    size_t count = 0;
+};
+
+// Appends records to a new packed file through a large stdio buffer
+struct PackedWriter {
+    FILE *file = nullptr;
+    uint64_t count = 0;
+    bool failed = false;
+    PackedWriter() {}
+    PackedWriter(const PackedWriter&) = delete;
+    PackedWriter &operator=(const PackedWriter&) = delete;
+    ~PackedWriter();
+};
+
+struct BookEntry {
+    Move move;
+    int weight = 0;
 };
 
 // helpers
 inline Color Opp(Color c){ return c==C_WHITE?C_BLACK:(c==C_BLACK?C_WHITE:C_NONE); }
 inline bool OnBoard(int x,int y){ return x>=0 && x<8 && y>=0 && y<8; }
 
+// per-side board geometry as constants, for code specialised on the side to move (template<Color Us>)
+template<Color Us> struct SideTraits {
+    static_assert(Us==C_WHITE || Us==C_BLACK, "a side to move");
+    static constexpr Color Them = Us==C_WHITE ? C_BLACK : C_WHITE;
+    static constexpr int Forward = Us==C_WHITE ? -1 : 1;      // y step of a pawn push
+    static constexpr int PawnStartRow = Us==C_WHITE ? 6 : 1;
+    static constexpr int EnPassantRow = Us==C_WHITE ? 3 : 4;  // where our pawns capture en passant
+    static constexpr int PromotionRow = Us==C_WHITE ? 0 : 7;
+};
+
 // Globals (defined in globals.cpp)
 extern uint64_t zobristTable[8][8][12];
 extern Piece boardG[8][8];
@@ -69,11 +407,17 @@ extern int clientH;
 extern int squareSize;
 extern int boardLeft;
 extern int boardTop;
-extern std::vector<UndoEntry> undoStack;
+extern GameHistory gameHistoryG;
+extern bool ponderG;
+extern EvalWeights evalWeightsG; // defined in weights.cpp
+extern bool largePagesG;            // defined in memory.cpp: allocate big tables in huge pages
+extern bool parallelInitG;          // first-touch big tables from one thread per processor
+extern ThreadBinding threadBindingG;
+#ifdef _WIN32
 extern HWND g_hwnd;
-extern std::mt19937 rng;
 extern HFONT glyphFont;
 extern HFONT uiFont;
+#endif
 
 // Function prototypes - engine
 void SetDPIAwareness();
@@ -81,39 +425,244 @@ void InitStartingBoard();
 void CopyBoard(const Piece src[8][8], Piece dst[8][8]);
 bool FindKing(const Piece b[8][8], Color side, int &outX, int &outY);
 bool IsSquareAttacked(const Piece b[8][8], int sx, int sy, Color by);
+bool InCheck(const Piece b[8][8], Color side);
 std::vector<Move> GeneratePseudoLegal(const Piece b[8][8], Color side, const Move &lastMove);
 std::vector<Move> GenerateLegalMoves(const Piece b[8][8], Color side, const Move &lastMove);
-bool IsThreefoldRepetition(const std::vector<UndoEntry> &undoStack, const Piece currentBoard[8][8], Color sideToMove);
-void ApplyMoveGlobal(const Move &m);
+std::vector<Move> GenerateLegalMovesReference(const Piece b[8][8], Color side, const Move &lastMove); // make-and-test, for checking
+// the same, specialised on the colour (instantiated for C_WHITE and C_BLACK in engine.cpp)
+template<Color By> bool IsSquareAttacked(const Piece b[8][8], int sx, int sy);
+template<Color Us> bool InCheck(const Piece b[8][8]);
+template<Color Us> std::vector<Move> GeneratePseudoLegal(const Piece b[8][8], const Move &lastMove);
+template<Color Us> std::vector<Move> GenerateLegalMoves(const Piece b[8][8], const Move &lastMove);
+template<Color Us> std::vector<Move> GenerateLegalMoves(const Piece b[8][8], const Move &lastMove, const AttackMap &a);
 void MakeMoveOnCopy(Piece b[8][8], const Move &m);
 
-// Undo
-void PushUndo();
+// Position / notation
+void SetStartPosition(Position &pos);
+Position CurrentPosition();
+void SetCurrentPosition(const Position &pos);
+bool SamePosition(const Position &a, const Position &b);
+void ApplyMove(Position &pos, const Move &m);
+bool ParseFEN(const std::string &fen, Position &pos);
+bool ParseEPD(const std::string &line, Position &pos, std::vector<std::pair<std::string,std::string>> *ops = nullptr);
+std::string ToFEN(const Position &pos);
+std::string MoveToUci(const Piece b[8][8], const Move &m);
+std::string MoveToSAN(const Position &pos, const Move &m);
+bool ParseSAN(const Position &pos, const std::string &san, Move &out);
+bool ParseUciMove(const Position &pos, const std::string &s, Move &out);
+
+// Game history (history.cpp); pos is the position after the played plies
+uint64_t RepetitionKey(const Position &pos);
+void ResetHistory(GameHistory &h, const Position &start);
+void RecordMove(GameHistory &h, const Position &pos, const Move &m); // m is about to be played on pos
+void PlayMove(GameHistory &h, Position &pos, const Move &m);
+bool UndoMove(GameHistory &h, Position &pos);
+bool RedoMove(GameHistory &h, Position &pos);
+void SeekPly(GameHistory &h, Position &pos, size_t ply);
+bool IsRepetition(const GameHistory &h, const Position &pos, int times = 3);
+
+// GUI game: moves, undo and redo on the globals, recorded in gameHistoryG
+void PlayMoveGlobal(const Move &m);
 bool CanUndo();
 void DoUndo();
+void DoRedo();
+void JumpToPly(size_t ply);
 
 // AI
 int pieceValue(PieceType t);
-int EvaluateBoard(const Piece b[8][8]);
-int EvalForSide(const Piece b[8][8], Color side);
+int EvaluateBoard(const Piece b[8][8], const EvalWeights &w = evalWeightsG); // bitboard kernel (evalbb.cpp)
+int EvaluateBoardReference(const Piece b[8][8], const EvalWeights &w = evalWeightsG);
+// bothSides false leaves out the side to move's attacks: enough for legality alone
+void BuildAttackMap(const Piece b[8][8], Color side, AttackMap &a, bool bothSides = true);
+int StaticExchange(const Piece b[8][8], const AttackMap &a, const Move &m); // material the mover nets on m's square
+const char *EvalKernelName();
+int RunEvalTest(int argc, char **argv);
+int EvalForSide(const Piece b[8][8], Color side, const EvalWeights &w = evalWeightsG);
+void EvalFeatures(const Piece b[8][8], std::vector<std::pair<int,int>> &out); // (param, count), White's view
+int Quiescence(Piece b[8][8], Color side, const Move &lastMv, int alpha, int beta);
 int Negamax(Piece b[8][8], Color side, const Move &lastMv, int depth, int alpha, int beta);
 Move ChooseBestFromLegal(const Piece cur[8][8], Color side, const Move &lastMv, int depth);
+SkillLevel SkillFor(int level);
+uint64_t ComputeZobrist(const Piece b[8][8], Color sideToMove);
+uint32_t PackMove(const Move &m); // 18 bits, 0 for no move
+Move UnpackMove(uint32_t mv);
+void SetZobristSeed(uint64_t seed); // keys are fixed per seed; the default is built in
+uint64_t ZobristSeed();
+void ResizeTT(TranspositionTable &table, size_t mb);
+void ClearTT(TranspositionTable &table);
+void ClearTT();
+void NextTTGeneration(TranspositionTable &table); // older entries become the first replaced
+void SetHashSize(size_t mb);
+bool SaveTT(const TranspositionTable &table, const std::string &path); // binary snapshot
+bool LoadTT(TranspositionTable &table, const std::string &path);       // false on a foreign or damaged file
+bool SaveTT(const std::string &path); // the shared table
+bool LoadTT(const std::string &path);
+bool AttachSharedTT(TranspositionTable &table, const std::string &name, size_t mb); // the first process sizes it
+bool AttachSharedTT(const std::string &name, size_t mb); // the default table
+bool RemoveSharedTT(const std::string &name); // freed once the last process detaches
+std::string DescribeTT(const TranspositionTable &table); // size and the pages it got
+std::string DescribeTT();
+int64_t NowMs();
+
+// Iterative-deepening search
+void PrepareSearch(SearchContext &ctx, const SearchLimits &limits);
+SearchResult Think(SearchContext &ctx, const Position &pos, const std::function<void(const SearchInfo&)> &onInfo = nullptr);
+void PonderHit(SearchContext &ctx);
+bool CheckStop(SearchContext &ctx); // counts a node; true once the search must unwind
+int AllocateMoveTime(int leftMs, int incMs, int movesToGo);
+
+// Resumable search (ai.cpp): Think's search as a state machine run a slice of nodes at a time,
+// so a scheduler can multiplex many searches on a few threads. No pondering; needs a depth,
+// movetime or node limit (else it stops after depth 1). Tasks share a table and do not age
+// it: the scheduler calls NextTTGeneration once per batch.
+struct SearchTask;
+std::shared_ptr<SearchTask> StartSearchTask(const Position &pos, const SearchLimits &limits, TranspositionTable *tt = nullptr);
+bool StepSearchTask(SearchTask &t, uint64_t nodes); // about this many nodes; true once finished
+const SearchResult &SearchTaskResult(const SearchTask &t);
+uint64_t SearchTaskNodes(const SearchTask &t);
+size_t SearchTaskBytes(const SearchTask &t); // memory it holds
+int RunCasual(int argc, char **argv); // many concurrent shallow games (scheduler.cpp)
+int RunTaskTest(int argc, char **argv); // search tasks against Think (scheduler.cpp)
+
+// Mate solver (mate.cpp)
+MateResult SolveMate(SearchContext &ctx, const Position &pos, int maxMoves, int threads, bool countSolutions = false);
+int RunMateTool(int argc, char **argv);
+int RunPerft(int argc, char **argv); // move generator node counts (perft.cpp)
+int RunMatch(int argc, char **argv); // self-play match with SPRT (match.cpp)
+bool GameEnded(const Position &pos, const GameHistory &history, std::string &result, std::string &reason);
+std::vector<PVLine> AnalyzeMultiPV(const Piece cur[8][8], Color side, const Move &lastMv, int depth, int multiPV);
+
+// Pondering for the GUI: search the expected reply while the human thinks
+void StartPonder(const Position &pos, const Move &expected, int depth);
+void StopPonder();
+bool TakePonderResult(const Position &pos, SearchResult &out);
+
+// Headless front-ends
+int RunUci();
+int RunBatch(int argc, char **argv);
+std::string JsonEscape(const std::string &s);
+std::string AnalysisJson(const Position &pos, const SearchResult &res); // shared JSON result members
+int RunServer(int argc, char **argv); // local analysis server (server.cpp)
+int RunAnnotate(int argc, char **argv);
+
+// PGN (pgn.cpp)
+bool ReadPgnGame(std::istream &in, PgnGame &game);
+std::string PgnTag(const PgnGame &game, const std::string &name);
+bool ReplayPgnGame(const PgnGame &game, Position &start, std::vector<Move> &moves);
+int RunHeadless(int argc, char **argv);
+
+// Evaluation weights (weights.cpp) and tuning tools (tune.cpp)
+EvalWeights DefaultEvalWeights();
+int &EvalParam(EvalWeights &w, int i);
+bool LoadEvalWeights(const std::string &path, EvalWeights &out);
+bool SaveEvalWeights(const std::string &path, const EvalWeights &w);
+int RunGenData(int argc, char **argv);
+int RunTune(int argc, char **argv);
+
+// NNUE evaluation (nnue.cpp); scores are for the side to move
+std::shared_ptr<NnueNet> LoadNnue(const std::string &path);
+bool SetNnue(const std::string &path);
+const NnueNet *ActiveNnue();
+int NnueEvaluate(const NnueNet &net, const Piece b[8][8], Color side);
+int RunNnueTool(int argc, char **argv);
+
+// Memory-mapped files
+bool MapFile(MappedFile &f, const std::string &path);
+void UnmapFile(MappedFile &f);
+bool OpenSharedMemory(SharedMemory &m, const std::string &name, size_t size); // an existing segment keeps its size
+void CloseSharedMemory(SharedMemory &m);
+bool RemoveSharedMemory(const std::string &name);
+
+// Packed positions (packed.cpp)
+bool PackPosition(const Position &pos, PackedPosition &r); // false with more than 32 pieces
+bool UnpackPosition(const PackedPosition &r, Position &pos); // false for a malformed record
+PackedResult GetPackedResult(const PackedPosition &r);
+void SetPackedResult(PackedPosition &r, PackedResult result);
+PackedResult ParseResultToken(const std::string &s); // "1-0", "0-1", "1/2-1/2"
+bool OpenPackedFile(PackedFile &f, const std::string &path); // false unless it is one
+bool CreatePackedFile(PackedWriter &w, const std::string &path);
+bool WritePacked(PackedWriter &w, const PackedPosition &r);
+bool ClosePackedFile(PackedWriter &w); // false if any write failed
+int RunPack(int argc, char **argv);
+int RunUnpack(int argc, char **argv);
+
+// Large allocations and thread placement (memory.cpp)
+bool AllocateLarge(LargeMemory &m, size_t size); // falls back to normal pages
+void FreeLarge(LargeMemory &m);
+void FirstTouch(LargeMemory &m, int threads);    // zero it, each thread bound like worker t
+std::string DescribeLarge(const LargeMemory &m);
+void BindThisThread(int index); // to a core or node by threadBindingG; no-op for BIND_NONE
+bool ParseMemoryOption(int argc, char **argv, int &i); // --large-pages on|off, --parallel-init, --bind none|cores|nodes
+
+// Polyglot opening book (book.cpp)
+uint64_t PolyglotKey(const Position &pos);
+uint16_t PolyglotMove(const Piece b[8][8], const Move &m);
+bool DecodePolyglotMove(const Position &pos, uint16_t code, Move &out); // the legal move it stands for
+bool OpenBook(const std::string &path);
+void CloseBook();
+bool HasBook();
+std::vector<BookEntry> BookMoves(const Position &pos);
+bool ProbeBook(const Position &pos, Move &out);
+int RunBookTool(int argc, char **argv);
+int RunBuildBook(int argc, char **argv);
+
+// Endgame bitbases: KPK, KRK, KQK (bitbase.cpp). result is for the side to move:
+// 1 win, 0 draw, -1 loss. Returns false for any other material or a table not loaded.
+bool LoadBitbases(const std::string &dir);     // the tables found in dir; true if all were
+bool GenerateBitbases(const std::string &dir); // builds them and writes them to dir
+bool ProbeBitbase(const Piece b[8][8], Color side, int &result);
+int RunBitbaseTool(int argc, char **argv);
+
+// Tablebases (tablebase.cpp): locally generated WDL/DTZ files for the 3-piece endings, mapped
+// on first use. WDL is for the side to move: 1 win, 0 draw, -1 loss.
+bool GenerateTablebases(const std::string &dir);
+void SetTablebasePath(const std::string &dir);
+bool TablebasesEnabled();
+bool ProbeWDL(const Piece b[8][8], Color side, int &wdl);
+bool ProbeDTZ(const Piece b[8][8], Color side, int &wdl, int &dtz);
+bool TablebaseRootMoves(const Position &pos, std::vector<std::pair<Move,int>> &scored);
+int RunTablebaseTool(int argc, char **argv);
+
+// Board compositor (render.cpp): draws the board into a 32-bit pixel buffer from square
+// sprites composed once per size, repainting only the squares that changed since the last frame.
+struct PixelRect { int x, y, w, h; };
+struct BoardView {
+    Piece board[8][8];
+    bool flip = false;
+    uint64_t targets = 0; // squares framed as legal destinations, bit y*8+x
+};
+struct BoardRenderer {
+    int squareSize = 0;
+    std::vector<uint32_t> pixels;           // (8*squareSize)^2, 0x00RRGGBB, top row first
+    std::vector<uint8_t> pieceMask[2][7];   // glyph coverage by [white, black][PieceType]
+    std::vector<uint32_t> cells[2][2][7];   // composed squares by [light, dark][white, black][PieceType]
+    BoardView shown;
+    bool valid = false;                     // false = the next frame repaints everything
+};
+void ResetBoardRenderer(BoardRenderer &r, int squareSize);
+void SetPieceSprite(BoardRenderer &r, Color c, PieceType t, const std::vector<uint8_t> &mask);
+void RenderBoard(BoardRenderer &r, const BoardView &v, std::vector<PixelRect> &dirty);
+int RunRenderBench(int argc, char **argv);
 
 // UI / Win32
+#ifdef _WIN32
 wchar_t Glyph(const Piece &p);
 void CreateFonts();
-void DrawBoardAndUI(HDC hdcScreen);
+void RefreshView(bool chrome); // redraw what changed; chrome = also the buttons and labels
 bool ScreenToBoard(int sx,int sy,int &bx,int &by);
 std::optional<PieceType> DoPromotionDialog(HWND hwndParent);
 PieceType ChoosePromotion(HWND parent, Color color);
 
 void newGame();
+void undoMove();
 void flipBoard();
 void flipSide();
 void toggleAi();
 void toggleShowLegal();
+void togglePonder();
 void CreateMainMenu(HWND hwnd);
 
 LRESULT CALLBACK WndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam);
+#endif
 
 #endif // CHESS_H
\ No newline at end of file
@@ -0,0 +1,43 @@
+#include "chess.h"
+#include <cstdio>
+
+// Headless entry points. WinMain forwards its command line here first; on other
+// platforms this file provides main() so the engine builds without the GUI.
+// Returns -1 when no headless mode was requested.
+int RunHeadless(int argc, char **argv){
+    if(argc < 2) return -1;
+    std::string cmd = argv[1];
+    if(cmd=="uci") return RunUci();
+    if(cmd=="batch") return RunBatch(argc, argv);
+    if(cmd=="annotate") return RunAnnotate(argc, argv);
+    if(cmd=="book") return RunBookTool(argc, argv);
+    if(cmd=="buildbook") return RunBuildBook(argc, argv);
+    if(cmd=="bitbase") return RunBitbaseTool(argc, argv);
+    if(cmd=="tbgen" || cmd=="tbprobe") return RunTablebaseTool(argc, argv);
+    if(cmd=="mate") return RunMateTool(argc, argv);
+    if(cmd=="match") return RunMatch(argc, argv);
+    if(cmd=="gendata") return RunGenData(argc, argv);
+    if(cmd=="tune") return RunTune(argc, argv);
+    if(cmd=="pack") return RunPack(argc, argv);
+    if(cmd=="unpack") return RunUnpack(argc, argv);
+    if(cmd=="nnue") return RunNnueTool(argc, argv);
+    if(cmd=="evaltest") return RunEvalTest(argc, argv);
+    if(cmd=="perft") return RunPerft(argc, argv);
+    if(cmd=="renderbench") return RunRenderBench(argc, argv);
+    if(cmd=="serve") return RunServer(argc, argv);
+    if(cmd=="casual") return RunCasual(argc, argv);
+    if(cmd=="tasktest") return RunTaskTest(argc, argv);
+    return -1;
+}
+
+#ifndef _WIN32
+int main(int argc, char **argv){
+    int r = RunHeadless(argc, argv);
+    if(r >= 0) return r;
+    if(argc >= 2){
+        std::fprintf(stderr, "unknown command: %s\n", argv[1]);
+        return 1;
+    }
+    return RunUci();
+}
+#endif
@@ -0,0 +1,113 @@
+#ifndef ENDGAME_H
+#define ENDGAME_H
+
+#include "chess.h"
+
+// Generator pieces shared by the bitbases (bitbase.cpp) and the tablebases (tablebase.cpp),
+// which cover the same positions: king and one piece against a lone king, the side owning the
+// piece mirrored to White. A position is side to move (0 = the strong side) x strong king x
+// weak king x piece, squares y*8+x with y=0 the far (8th) rank.
+
+static const int ENDGAME_SIZE = 1<<19;
+
+static inline int EndgameIndex(int stm, int sk, int wk, int ps){ return stm<<18 | sk<<12 | wk<<6 | ps; }
+
+static inline void SplitEndgameIndex(int idx, int &stm, int &sk, int &wk, int &ps){
+    stm = idx>>18; sk = (idx>>12)&63; wk = (idx>>6)&63; ps = idx&63;
+}
+
+static inline bool KingsTouch(int a, int b){
+    return abs((a&7)-(b&7)) <= 1 && abs((a>>3)-(b>>3)) <= 1;
+}
+
+static const int KING_DX[8] = {-1,0,1,-1,1,-1,0,1};
+static const int KING_DY[8] = {-1,-1,-1,0,0,1,1,1};
+static const int KNIGHT_DX[8] = {1,2,2,1,-1,-2,-2,-1};
+static const int KNIGHT_DY[8] = {-2,-1,1,2,2,1,-1,-2};
+
+// does the strong piece on ps attack sq, with only the strong king able to block? (The weak
+// king is the one being tested, so it never shields its own square.)
+static inline bool PieceAttacks(PieceType pt, int ps, int sq, int sk){
+    int px = ps&7, py = ps>>3, x = sq&7, y = sq>>3;
+    int dx = x-px, dy = y-py;
+    if(pt==PT_PAWN) return dy==-1 && abs(dx)==1;
+    if(pt==PT_KNIGHT) return abs(dx*dy)==2;
+    if(dx==0 && dy==0) return false;
+    bool straight = dx==0 || dy==0, diagonal = abs(dx)==abs(dy);
+    bool lines = straight && (pt==PT_ROOK || pt==PT_QUEEN);
+    bool diags = diagonal && (pt==PT_BISHOP || pt==PT_QUEEN);
+    if(!lines && !diags) return false;
+    int sx = (dx>0)-(dx<0), sy = (dy>0)-(dy<0);
+    for(int cx=px+sx, cy=py+sy; cx!=x || cy!=y; cx+=sx, cy+=sy)
+        if(cy*8+cx==sk) return false;
+    return true;
+}
+
+// non-pawn destinations of the strong piece (kings block, nothing is captured)
+static inline int PieceTargets(PieceType pt, int ps, int sk, int wk, int out[32]){
+    int n = 0, px = ps&7, py = ps>>3;
+    if(pt==PT_KNIGHT){
+        for(int d=0; d<8; d++){
+            int x = px+KNIGHT_DX[d], y = py+KNIGHT_DY[d], t = y*8+x;
+            if(OnBoard(x,y) && t!=sk && t!=wk) out[n++] = t;
+        }
+        return n;
+    }
+    for(int d=0; d<8; d++){
+        bool diagonal = KING_DX[d]!=0 && KING_DY[d]!=0;
+        if(diagonal ? pt==PT_ROOK : pt==PT_BISHOP) continue;
+        for(int x=px+KING_DX[d], y=py+KING_DY[d]; OnBoard(x,y); x+=KING_DX[d], y+=KING_DY[d]){
+            int t = y*8+x;
+            if(t==sk || t==wk) break;
+            out[n++] = t;
+        }
+    }
+    return n;
+}
+
+// weak king moves as child indices; -1 if it can take the piece, else the number of moves
+static inline int WeakMoves(PieceType pt, int sk, int wk, int ps, int out[8]){
+    int n = 0;
+    for(int d=0; d<8; d++){
+        int x = (wk&7)+KING_DX[d], y = (wk>>3)+KING_DY[d], t = y*8+x;
+        if(!OnBoard(x,y) || KingsTouch(t, sk)) continue;
+        if(t==ps) return -1;
+        if(!PieceAttacks(pt, ps, t, sk)) out[n++] = EndgameIndex(0, sk, t, ps);
+    }
+    return n;
+}
+
+// squares overlap, kings touch, a pawn on its first or last rank, or the weak side in check
+// with the strong side to move
+static inline bool EndgameInvalid(PieceType pt, int idx){
+    int stm, sk, wk, ps;
+    SplitEndgameIndex(idx, stm, sk, wk, ps);
+    return sk==wk || sk==ps || wk==ps || KingsTouch(sk, wk)
+        || (pt==PT_PAWN && ((ps>>3)==0 || (ps>>3)==7))
+        || (stm==0 && PieceAttacks(pt, ps, wk, sk));
+}
+
+// work(lo, hi) over contiguous slices of the index space, one per thread
+static inline void RunParallel(int threads, const std::function<void(int,int)> &work){
+    std::vector<std::thread> pool;
+    int chunk = (ENDGAME_SIZE + threads - 1) / threads;
+    for(int t=0; t<threads; t++)
+        pool.emplace_back(work, t*chunk, std::min(ENDGAME_SIZE, (t+1)*chunk));
+    for(auto &th : pool) th.join();
+}
+
+// Retrograde fixed point: repeat parallel passes of step(idx) until one changes nothing. The
+// tables only ever gain wins, so a pass may read entries other threads are updating.
+static inline void Iterate(int threads, const std::function<bool(int)> &step){
+    std::atomic<bool> changed{true};
+    while(changed){
+        changed = false;
+        RunParallel(threads, [&](int lo, int hi){
+            bool any = false;
+            for(int idx=lo; idx<hi; idx++) if(step(idx)) any = true;
+            if(any) changed = true;
+        });
+    }
+}
+
+#endif
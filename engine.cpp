@@ -1,5 +1,7 @@
 #include "chess.h"
+#include <cctype>
 
+#ifdef _WIN32
 // Set DPI awareness helper
 void SetDPIAwareness(){
     HMODULE h = LoadLibraryW(L"user32.dll");
@@ -10,6 +12,7 @@ void SetDPIAwareness(){
         FreeLibrary(h);
     }
 }
+#endif
 
 void InitStartingBoard(){
     for(int y=0;y<8;y++) for(int x=0;x<8;x++) boardG[y][x] = Piece();
@@ -43,38 +46,30 @@ bool FindKing(const Piece b[8][8], Color side, int &outX, int &outY){
     return false;
 }
 
-// is square attacked by color 'by'
-bool IsSquareAttacked(const Piece b[8][8], int sx, int sy, Color by){
-    if(!OnBoard(sx,sy) || by==C_NONE) return false;
-
-    // pawns attack
-	if(by==C_WHITE){
-		int py = sy + 1; // לבן תוקף מטה
-		if(py<8){
-			if(sx-1>=0 && b[py][sx-1].type==PT_PAWN && b[py][sx-1].color==C_WHITE) return true;
-			if(sx+1<8  && b[py][sx+1].type==PT_PAWN && b[py][sx+1].color==C_WHITE) return true;
-		}
-	} else if(by==C_BLACK){
-		int py = sy - 1; // שחור תוקף מעלה
-		if(py>=0){
-			if(sx-1>=0 && b[py][sx-1].type==PT_PAWN && b[py][sx-1].color==C_BLACK) return true;
-			if(sx+1<8  && b[py][sx+1].type==PT_PAWN && b[py][sx+1].color==C_BLACK) return true;
-		}
-	}
+// is square attacked by color 'By'
+template<Color By> bool IsSquareAttacked(const Piece b[8][8], int sx, int sy){
+    if(!OnBoard(sx,sy)) return false;
+
+    // pawns attack from one step behind the square, as seen from By
+    int py = sy - SideTraits<By>::Forward;
+    if(py>=0 && py<8){
+        if(sx-1>=0 && b[py][sx-1].type==PT_PAWN && b[py][sx-1].color==By) return true;
+        if(sx+1<8  && b[py][sx+1].type==PT_PAWN && b[py][sx+1].color==By) return true;
+    }
 
     // knights
     const int kdx[8] = {1,2,2,1,-1,-2,-2,-1};
     const int kdy[8] = {-2,-1,1,2,2,1,-1,-2};
     for(int i=0;i<8;i++){
         int nx=sx+kdx[i], ny=sy+kdy[i];
-        if(OnBoard(nx,ny) && b[ny][nx].type==PT_KNIGHT && b[ny][nx].color==by) return true;
+        if(OnBoard(nx,ny) && b[ny][nx].type==PT_KNIGHT && b[ny][nx].color==By) return true;
     }
 
     // king adjacency
     for(int dx=-1;dx<=1;dx++) for(int dy=-1;dy<=1;dy++){
         if(dx==0 && dy==0) continue;
         int nx=sx+dx, ny=sy+dy;
-        if(OnBoard(nx,ny) && b[ny][nx].type==PT_KING && b[ny][nx].color==by) return true;
+        if(OnBoard(nx,ny) && b[ny][nx].type==PT_KING && b[ny][nx].color==By) return true;
     }
 
     // rook/queen straight
@@ -84,7 +79,7 @@ bool IsSquareAttacked(const Piece b[8][8], int sx, int sy, Color by){
             int nx = sx + rdx[d]*s, ny = sy + rdy[d]*s;
             if(!OnBoard(nx,ny)) break;
             if(b[ny][nx].type!=PT_NONE){
-                if(b[ny][nx].color==by && (b[ny][nx].type==PT_ROOK || b[ny][nx].type==PT_QUEEN)) return true;
+                if(b[ny][nx].color==By && (b[ny][nx].type==PT_ROOK || b[ny][nx].type==PT_QUEEN)) return true;
                 break;
             }
         }
@@ -97,7 +92,7 @@ bool IsSquareAttacked(const Piece b[8][8], int sx, int sy, Color by){
             int nx = sx + bdx[d]*s, ny = sy + bdy[d]*s;
             if(!OnBoard(nx,ny)) break;
             if(b[ny][nx].type!=PT_NONE){
-                if(b[ny][nx].color==by && (b[ny][nx].type==PT_BISHOP || b[ny][nx].type==PT_QUEEN)) return true;
+                if(b[ny][nx].color==By && (b[ny][nx].type==PT_BISHOP || b[ny][nx].type==PT_QUEEN)) return true;
                 break;
             }
         }
@@ -106,23 +101,28 @@ bool IsSquareAttacked(const Piece b[8][8], int sx, int sy, Color by){
     return false;
 }
 
+bool IsSquareAttacked(const Piece b[8][8], int sx, int sy, Color by){
+    if(by==C_WHITE) return IsSquareAttacked<C_WHITE>(b, sx, sy);
+    if(by==C_BLACK) return IsSquareAttacked<C_BLACK>(b, sx, sy);
+    return false;
+}
+
 // Pseudo-legal moves (use lastMove to determine en-passant candidates).
-std::vector<Move> GeneratePseudoLegal(const Piece b[8][8], Color side, const Move &lastMove){
+template<Color Us> std::vector<Move> GeneratePseudoLegal(const Piece b[8][8], const Move &lastMove){
+    typedef SideTraits<Us> S;
     std::vector<Move> out;
     for(int y=0;y<8;y++){
         for(int x=0;x<8;x++){
             Piece p = b[y][x];
-            if(p.type==PT_NONE || p.color!=side) continue;
+            if(p.type==PT_NONE || p.color!=Us) continue;
             if(p.type==PT_PAWN){
-                int dir = (p.color==C_WHITE ? -1 : 1);
-                int ny = y + dir;
+                int ny = y + S::Forward;
                 // forward one
                 if(OnBoard(x,ny) && b[ny][x].type==PT_NONE) out.push_back(Move(x,y,x,ny));
                 // forward two
-                int startRow = (p.color==C_WHITE ? 6 : 1);
-                if(y==startRow){
-                    int ny1 = y+dir, ny2 = y+2*dir;
-                    if(OnBoard(x,ny2) && b[ny1][x].type==PT_NONE && b[ny2][x].type==PT_NONE){
+                if(y==S::PawnStartRow){
+                    int ny1 = y+S::Forward, ny2 = y+2*S::Forward;
+                    if(b[ny1][x].type==PT_NONE && b[ny2][x].type==PT_NONE){
                         out.push_back(Move(x,y,x,ny2));
                     }
                 }
@@ -131,13 +131,13 @@ std::vector<Move> GeneratePseudoLegal(const Piece b[8][8], Color side, const Mov
                     int nx=x+dx;
                     if(!OnBoard(nx, ny)) continue;
                     // normal capture
-                    if(b[ny][nx].type!=PT_NONE && b[ny][nx].color==Opp(side)){
+                    if(b[ny][nx].type!=PT_NONE && b[ny][nx].color==S::Them){
                         out.push_back(Move(x,y,nx,ny));
-                    } else {
+                    } else if(y==S::EnPassantRow){
                         // en-passant possibility: lastMove must be pawn double-step landed at (nx, y) and the piece still there
                         if(lastMove.fx!=-1){
                             if(abs(lastMove.ty - lastMove.fy)==2 && lastMove.ty==y && lastMove.tx==nx){
-                                if(OnBoard(lastMove.tx, lastMove.ty) && b[lastMove.ty][lastMove.tx].type==PT_PAWN && b[lastMove.ty][lastMove.tx].color==Opp(side)){
+                                if(b[lastMove.ty][lastMove.tx].type==PT_PAWN && b[lastMove.ty][lastMove.tx].color==S::Them){
                                     Move m(x,y,nx,ny); m.isEnPassant = true; out.push_back(m);
                                 }
                             }
@@ -150,7 +150,7 @@ std::vector<Move> GeneratePseudoLegal(const Piece b[8][8], Color side, const Mov
                 const int ky[8] = {-2,-1,1,2,2,1,-1,-2};
                 for(int i=0;i<8;i++){
                     int nx=x+kx[i], ny=y+ky[i];
-                    if(OnBoard(nx,ny) && b[ny][nx].color!=side) out.push_back(Move(x,y,nx,ny));
+                    if(OnBoard(nx,ny) && b[ny][nx].color!=Us) out.push_back(Move(x,y,nx,ny));
                 }
             }
             else if(p.type==PT_BISHOP || p.type==PT_ROOK || p.type==PT_QUEEN){
@@ -165,7 +165,7 @@ std::vector<Move> GeneratePseudoLegal(const Piece b[8][8], Color side, const Mov
                     int nx=x+d.first, ny=y+d.second;
                     while(OnBoard(nx,ny)){
                         if(b[ny][nx].type==PT_NONE) out.push_back(Move(x,y,nx,ny));
-                        else { if(b[ny][nx].color==Opp(side)) out.push_back(Move(x,y,nx,ny)); break; }
+                        else { if(b[ny][nx].color==S::Them) out.push_back(Move(x,y,nx,ny)); break; }
                         nx += d.first; ny += d.second;
                     }
                 }
@@ -174,18 +174,18 @@ std::vector<Move> GeneratePseudoLegal(const Piece b[8][8], Color side, const Mov
                 for(int dx=-1;dx<=1;dx++) for(int dy=-1;dy<=1;dy++){
                     if(dx==0 && dy==0) continue;
                     int nx=x+dx, ny=y+dy;
-                    if(OnBoard(nx,ny) && b[ny][nx].color!=side) out.push_back(Move(x,y,nx,ny));
+                    if(OnBoard(nx,ny) && b[ny][nx].color!=Us) out.push_back(Move(x,y,nx,ny));
                 }
                 // castling pseudo
                 if(!p.moved){
                     // kingside
-                    if(OnBoard(7,y) && b[y][7].type==PT_ROOK && b[y][7].color==side && !b[y][7].moved){
+                    if(OnBoard(7,y) && b[y][7].type==PT_ROOK && b[y][7].color==Us && !b[y][7].moved){
                         if(b[y][5].type==PT_NONE && b[y][6].type==PT_NONE){
                             Move m(x,y,x+2,y); m.isCastle = true; out.push_back(m);
                         }
                     }
                     // queenside
-                    if(OnBoard(0,y) && b[y][0].type==PT_ROOK && b[y][0].color==side && !b[y][0].moved){
+                    if(OnBoard(0,y) && b[y][0].type==PT_ROOK && b[y][0].color==Us && !b[y][0].moved){
                         if(b[y][1].type==PT_NONE && b[y][2].type==PT_NONE && b[y][3].type==PT_NONE){
                             Move m(x,y,x-2,y); m.isCastle = true; out.push_back(m);
                         }
@@ -197,58 +197,19 @@ std::vector<Move> GeneratePseudoLegal(const Piece b[8][8], Color side, const Mov
     return out;
 }
 
-bool IsThreefoldRepetition(const std::vector<UndoEntry> &undoStack, const Piece currentBoard[8][8], Color sideToMove) {
-    int repetitions = 0;
-
-    for (auto it = undoStack.rbegin(); it != undoStack.rend(); ++it) {
-        const UndoEntry &entry = *it;
-
-        // בדיקה שהצד בתור זהה
-        if (entry.side != sideToMove) continue;
-
-        bool identical = true;
-
-        // השוואת הלוח
-        for (int y = 0; y < 8 && identical; ++y) {
-            for (int x = 0; x < 8 && identical; ++x) {
-                const Piece &p1 = currentBoard[y][x];
-                const Piece &p2 = entry.board[y][x];
-
-                if (p1.type != p2.type || p1.color != p2.color || p1.moved != p2.moved) {
-                    identical = false;
-                }
-            }
-        }
-
-        // בדיקת זכויות en passant: אם ההזדמנות נעלמה, לא זהה
-        if (identical && entry.lastMove.isEnPassant) {
-            int epRow = (sideToMove == C_WHITE) ? 3 : 4; // שורה אפשרית ל-en passant
-            bool epStillPossible = false;
-            for (int x = 0; x < 8; ++x) {
-                const Piece &p = currentBoard[epRow][x];
-                if (p.type == PT_PAWN && p.color != sideToMove) {
-                    epStillPossible = true;
-                    break;
-                }
-            }
-            if (!epStillPossible) identical = false;
-        }
-
-        if (identical) {
-            repetitions++;
-            if (repetitions >= 2) return true; // כולל המצב הנוכחי = שלוש פעמים
-        }
-    }
-
-    return false;
+std::vector<Move> GeneratePseudoLegal(const Piece b[8][8], Color side, const Move &lastMove){
+    if(side==C_WHITE) return GeneratePseudoLegal<C_WHITE>(b, lastMove);
+    if(side==C_BLACK) return GeneratePseudoLegal<C_BLACK>(b, lastMove);
+    return {};
 }
 
-
-// legal moves: simulate and filter out those leaving own king in check; also validate castling path
-std::vector<Move> GenerateLegalMoves(const Piece b[8][8], Color side, const Move &lastMove){
+// Reference legality filter: makes every pseudo-legal move on a copy and looks for attacks on
+// the king; also validates the castling path. Kept to cross-check the generator below (perft --verify).
+template<Color Us> static std::vector<Move> LegalMovesByCopy(const Piece b[8][8], const Move &lastMove){
+    typedef SideTraits<Us> S;
     std::vector<Move> legal;
-	
-    auto pseudo = GeneratePseudoLegal(b, side, lastMove);
+
+    auto pseudo = GeneratePseudoLegal<Us>(b, lastMove);
 
     for(auto m : pseudo){
         Piece copyB[8][8]; CopyBoard(b, copyB);
@@ -256,7 +217,7 @@ std::vector<Move> GenerateLegalMoves(const Piece b[8][8], Color side, const Move
         // if en-passant, captured pawn sits at (m.tx, m.fy)
         if(m.isEnPassant){
             int capX = m.tx, capY = m.fy;
-            if(OnBoard(capX,capY) && copyB[capY][capX].type==PT_PAWN && copyB[capY][capX].color==Opp(side)){
+            if(OnBoard(capX,capY) && copyB[capY][capX].type==PT_PAWN && copyB[capY][capX].color==S::Them){
                 copyB[capY][capX] = Piece();
             } else {
                 continue; // invalid en-passant candidate
@@ -287,30 +248,30 @@ std::vector<Move> GenerateLegalMoves(const Piece b[8][8], Color side, const Move
         }
 
         // promotion (assume queen for legality check; final selection handled in UI)
-        if(copyB[m.ty][m.tx].type==PT_PAWN && (m.ty==0 || m.ty==7)){
+        if(copyB[m.ty][m.tx].type==PT_PAWN && m.ty==S::PromotionRow){
             copyB[m.ty][m.tx].type = m.promoteTo;
         }
 
         // additional castling validations: king not in check now, and path squares not attacked
         if(m.isCastle){
             int kx=-1, ky=-1;
-            if(!FindKing(b, side, kx, ky)) continue;
-            if(IsSquareAttacked(b, kx, ky, Opp(side))) continue; // currently in check
+            if(!FindKing(b, Us, kx, ky)) continue;
+            if(IsSquareAttacked<S::Them>(b, kx, ky)) continue; // currently in check
             int dir = (m.tx > m.fx) ? 1 : -1;
             for(int step=1; step<=abs(m.tx - m.fx); ++step){
                 int cx = m.fx + dir*step, cy = m.fy;
                 Piece tB[8][8]; CopyBoard(b,tB);
                 tB[cy][cx] = tB[m.fy][m.fx];
                 tB[m.fy][m.fx] = Piece();
-                if(IsSquareAttacked(tB, cx, cy, Opp(side))) goto skip_move;
+                if(IsSquareAttacked<S::Them>(tB, cx, cy)) goto skip_move;
             }
         }
 
         // ensure own king not left in check
         {
             int kx=-1, ky=-1;
-            if(!FindKing(copyB, side, kx, ky)) continue;
-            if(IsSquareAttacked(copyB, kx, ky, Opp(side))) { continue; }
+            if(!FindKing(copyB, Us, kx, ky)) continue;
+            if(IsSquareAttacked<S::Them>(copyB, kx, ky)) { continue; }
         }
 
         legal.push_back(m);
@@ -319,40 +280,76 @@ std::vector<Move> GenerateLegalMoves(const Piece b[8][8], Color side, const Move
     return legal;
 }
 
+std::vector<Move> GenerateLegalMovesReference(const Piece b[8][8], Color side, const Move &lastMove){
+    if(side==C_WHITE) return LegalMovesByCopy<C_WHITE>(b, lastMove);
+    if(side==C_BLACK) return LegalMovesByCopy<C_BLACK>(b, lastMove);
+    return {};
+}
 
-// apply move to global board, update lastMove and side
-void ApplyMoveGlobal(const Move &m){
-    if(m.fx==-1) return;
-    // en-passant capture removal
-    if(m.isEnPassant){
-        int capX = m.tx, capY = m.fy;
-        if(OnBoard(capX,capY)) boardG[capY][capX] = Piece();
-    }
-    boardG[m.ty][m.tx] = boardG[m.fy][m.fx];
-    boardG[m.ty][m.tx].moved = true;
-    boardG[m.fy][m.fx] = Piece();
+static inline uint64_t SquareBit(int x, int y){ return 1ULL << (y*8 + x); }
 
-    if(m.isCastle){
-        if(m.tx == m.fx + 2){
-            boardG[m.ty][m.tx-1] = boardG[m.ty][7];
-            boardG[m.ty][7] = Piece();
-            boardG[m.ty][m.tx-1].moved = true;
-        } else if(m.tx == m.fx - 2){
-            boardG[m.ty][m.tx+1] = boardG[m.ty][0];
-            boardG[m.ty][0] = Piece();
-            boardG[m.ty][m.tx+1].moved = true;
+// Legal moves straight from the pseudo-legal list, in the same order, checked against the
+// attack map: king moves (castling transit included) against the squares the opponent
+// attacks, other moves against the check and pin masks. Only en passant, which can uncover a
+// check along the rank through both pawns, is still made on a copy.
+template<Color Us> std::vector<Move> GenerateLegalMoves(const Piece b[8][8], const Move &lastMove, const AttackMap &a){
+    typedef SideTraits<Us> S;
+    std::vector<Move> legal;
+    if(a.king<0) return legal;
+    auto pseudo = GeneratePseudoLegal<Us>(b, lastMove);
+    legal.reserve(pseudo.size());
+    for(auto &m : pseudo){
+        uint64_t from = SquareBit(m.fx, m.fy), to = SquareBit(m.tx, m.ty);
+        if(m.fy*8 + m.fx == a.king){
+            if(m.isCastle){
+                if(a.checkers) continue;
+                int dir = m.tx > m.fx ? 1 : -1;
+                bool safe = true;
+                for(int x = m.fx+dir; safe && x != m.tx+dir; x += dir) safe = !(a.kingDanger & SquareBit(x, m.fy));
+                if(safe) legal.push_back(m);
+            }
+            else if(!(a.kingDanger & to)) legal.push_back(m);
+            continue;
         }
+        if(m.isEnPassant){
+            Piece copyB[8][8]; CopyBoard(b, copyB);
+            MakeMoveOnCopy(copyB, m);
+            if(!IsSquareAttacked<S::Them>(copyB, a.king%8, a.king/8)) legal.push_back(m);
+            continue;
+        }
+        if(!(a.evasion & to)) continue;
+        if(a.pinned & from){
+            bool alongPin = false;
+            for(int d=0; d<8; d++) if(a.pinRay[d] & from) alongPin = (a.pinRay[d] & to) != 0;
+            if(!alongPin) continue;
+        }
+        legal.push_back(m);
     }
+    return legal;
+}
 
-    if(boardG[m.ty][m.tx].type==PT_PAWN && (m.ty==0 || m.ty==7)){
-        boardG[m.ty][m.tx].type = m.promoteTo;
-    }
-	if(boardG[m.ty][m.tx].type==PT_PAWN)halfmoveClock=0;
-	else halfmoveClock ++;
-    lastMoveG = m;
-    sideToMoveG = Opp(sideToMoveG);
+template<Color Us> std::vector<Move> GenerateLegalMoves(const Piece b[8][8], const Move &lastMove){
+    AttackMap a;
+    BuildAttackMap(b, Us, a, false);
+    return GenerateLegalMoves<Us>(b, lastMove, a);
 }
 
+std::vector<Move> GenerateLegalMoves(const Piece b[8][8], Color side, const Move &lastMove){
+    if(side==C_WHITE) return GenerateLegalMoves<C_WHITE>(b, lastMove);
+    if(side==C_BLACK) return GenerateLegalMoves<C_BLACK>(b, lastMove);
+    return {};
+}
+
+template bool IsSquareAttacked<C_WHITE>(const Piece b[8][8], int sx, int sy);
+template bool IsSquareAttacked<C_BLACK>(const Piece b[8][8], int sx, int sy);
+template std::vector<Move> GeneratePseudoLegal<C_WHITE>(const Piece b[8][8], const Move &lastMove);
+template std::vector<Move> GeneratePseudoLegal<C_BLACK>(const Piece b[8][8], const Move &lastMove);
+template std::vector<Move> GenerateLegalMoves<C_WHITE>(const Piece b[8][8], const Move &lastMove);
+template std::vector<Move> GenerateLegalMoves<C_BLACK>(const Piece b[8][8], const Move &lastMove);
+template std::vector<Move> GenerateLegalMoves<C_WHITE>(const Piece b[8][8], const Move &lastMove, const AttackMap &a);
+template std::vector<Move> GenerateLegalMoves<C_BLACK>(const Piece b[8][8], const Move &lastMove, const AttackMap &a);
+
+
 // make move on copy (for search)
 void MakeMoveOnCopy(Piece b[8][8], const Move &m){
     if(m.isEnPassant){
@@ -380,23 +377,345 @@ void MakeMoveOnCopy(Piece b[8][8], const Move &m){
     }
 }
 
-// Undo stack
-void PushUndo(){
-    UndoEntry e;
-    CopyBoard(boardG, e.board);
-    e.side = sideToMoveG;
-	e.halfmoveClock = halfmoveClock;
-    e.lastMove = lastMoveG;
-    undoStack.push_back(e);
+// ---------------- Position / notation ----------------
+
+void SetStartPosition(Position &pos){
+    ParseFEN("rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", pos);
+}
+
+// snapshot of the GUI game state
+Position CurrentPosition(){
+    Position pos;
+    CopyBoard(boardG, pos.board);
+    pos.side = sideToMoveG;
+    pos.lastMove = lastMoveG;
+    pos.halfmoveClock = halfmoveClock;
+    return pos;
+}
+
+void SetCurrentPosition(const Position &pos){
+    CopyBoard(pos.board, boardG);
+    sideToMoveG = pos.side;
+    lastMoveG = pos.lastMove;
+    halfmoveClock = pos.halfmoveClock;
+}
+
+// same pieces, side and en-passant context (clocks are ignored)
+bool SamePosition(const Position &a, const Position &b){
+    if(a.side != b.side) return false;
+    if(a.lastMove.fx!=b.lastMove.fx || a.lastMove.fy!=b.lastMove.fy || a.lastMove.tx!=b.lastMove.tx || a.lastMove.ty!=b.lastMove.ty) return false;
+    for(int y=0;y<8;y++) for(int x=0;x<8;x++){
+        if(a.board[y][x].type!=b.board[y][x].type || a.board[y][x].color!=b.board[y][x].color) return false;
+    }
+    return true;
+}
+
+void ApplyMove(Position &pos, const Move &m){
+    if(m.fx==-1) return;
+    bool reset = pos.board[m.fy][m.fx].type==PT_PAWN || pos.board[m.ty][m.tx].type!=PT_NONE;
+    MakeMoveOnCopy(pos.board, m);
+    pos.halfmoveClock = reset ? 0 : pos.halfmoveClock + 1;
+    if(pos.side==C_BLACK) pos.fullmoveNumber++;
+    pos.lastMove = m;
+    pos.side = Opp(pos.side);
 }
-bool CanUndo(){ return !undoStack.empty(); }
-void DoUndo(){
-    if(!CanUndo()) return;
-    UndoEntry e = undoStack.back(); undoStack.pop_back();
-    CopyBoard(e.board, boardG);
-    sideToMoveG = e.side;
-    lastMoveG = e.lastMove;
-	halfmoveClock = e.halfmoveClock;
+
+static const char *PIECE_CHARS = " pnbrqk";
+
+// FEN -> position. Castling rights become 'moved' flags on kings/rooks, the en-passant
+// square becomes a synthetic double-step lastMove.
+bool ParseFEN(const std::string &fen, Position &pos){
+    Position p;
+    size_t i = 0;
+    int x = 0, y = 0;
+    for(; i<fen.size() && fen[i]!=' '; i++){
+        char c = fen[i];
+        if(c=='/'){ if(x!=8) return false; x = 0; y++; continue; }
+        if(c>='1' && c<='8'){ x += c-'0'; if(x>8) return false; continue; }
+        const char *f = std::strchr(PIECE_CHARS, c>='A' && c<='Z' ? c-'A'+'a' : c);
+        if(!f || c==' ' || x>=8 || y>=8) return false;
+        Piece &pc = p.board[y][x++];
+        pc.type = (PieceType)(f - PIECE_CHARS);
+        pc.color = (c>='A' && c<='Z') ? C_WHITE : C_BLACK;
+        // pawns off their start row have moved; kings/rooks get their flag from the castling field
+        if(pc.type==PT_PAWN) pc.moved = (y != (pc.color==C_WHITE ? 6 : 1));
+        else pc.moved = (pc.type==PT_KING || pc.type==PT_ROOK);
+    }
+    if(y!=7 || x!=8) return false;
+
+    std::string fields[5];
+    int nf = 0;
+    while(nf<5){
+        while(i<fen.size() && fen[i]==' ') i++;
+        if(i>=fen.size()) break;
+        size_t j = fen.find(' ', i);
+        if(j==std::string::npos) j = fen.size();
+        fields[nf++] = fen.substr(i, j-i);
+        i = j;
+    }
+    if(nf<1) return false;
+    if(fields[0]=="w") p.side = C_WHITE;
+    else if(fields[0]=="b") p.side = C_BLACK;
+    else return false;
+
+    if(nf>=2){
+        for(char c : fields[1]){
+            int ry = (c=='K' || c=='Q') ? 7 : 0;
+            Color col = ry==7 ? C_WHITE : C_BLACK;
+            int rx;
+            if(c=='K' || c=='k') rx = 7;
+            else if(c=='Q' || c=='q') rx = 0;
+            else continue;
+            Piece &k = p.board[ry][4], &r = p.board[ry][rx];
+            if(k.type==PT_KING && k.color==col && r.type==PT_ROOK && r.color==col){ k.moved = false; r.moved = false; }
+        }
+    }
+    if(nf>=3 && fields[2].size()==2 && fields[2][0]>='a' && fields[2][0]<='h'){
+        int ex = fields[2][0]-'a';
+        if(fields[2][1]=='3') p.lastMove = Move(ex,6,ex,4);
+        else if(fields[2][1]=='6') p.lastMove = Move(ex,1,ex,3);
+    }
+    if(nf>=4) p.halfmoveClock = std::atoi(fields[3].c_str());
+    if(nf>=5) p.fullmoveNumber = std::max(1, std::atoi(fields[4].c_str()));
+    pos = p;
+    return true;
+}
+
+// EPD: the first four FEN fields, optional clocks, then "opcode operands;" operations.
+// Also accepts plain FEN lines.
+bool ParseEPD(const std::string &line, Position &pos, std::vector<std::pair<std::string,std::string>> *ops){
+    size_t i = 0;
+    auto nextToken = [&](std::string &tok){
+        while(i<line.size() && isspace((unsigned char)line[i])) i++;
+        size_t j = i;
+        while(j<line.size() && !isspace((unsigned char)line[j])) j++;
+        tok = line.substr(i, j-i);
+        i = j;
+        return !tok.empty();
+    };
+    auto isNumber = [](const std::string &t){ return !t.empty() && t.find_first_not_of("0123456789")==std::string::npos; };
+
+    std::string fen, tok;
+    for(int f=0; f<4; f++){
+        if(!nextToken(tok)) return false;
+        fen += (f ? " " : "") + tok;
+    }
+    // optional halfmove/fullmove clocks (FEN style)
+    size_t save = i;
+    std::string h, fm;
+    if(nextToken(h) && isNumber(h) && nextToken(fm) && isNumber(fm)) fen += " " + h + " " + fm;
+    else i = save;
+    if(!ParseFEN(fen, pos)) return false;
+    if(!ops) return true;
+
+    ops->clear();
+    while(i<line.size()){
+        while(i<line.size() && (isspace((unsigned char)line[i]) || line[i]==';')) i++;
+        if(i>=line.size()) break;
+        size_t j = i;
+        while(j<line.size() && !isspace((unsigned char)line[j]) && line[j]!=';') j++;
+        std::string opcode = line.substr(i, j-i), operand;
+        i = j;
+        bool quoted = false;
+        for(; i<line.size() && (quoted || line[i]!=';'); i++){
+            if(line[i]=='"'){ quoted = !quoted; continue; }
+            operand += line[i];
+        }
+        size_t a = operand.find_first_not_of(" \t"), b = operand.find_last_not_of(" \t");
+        ops->push_back({opcode, a==std::string::npos ? "" : operand.substr(a, b-a+1)});
+    }
+    return true;
+}
+
+std::string ToFEN(const Position &pos){
+    std::string s;
+    for(int y=0;y<8;y++){
+        int empty = 0;
+        for(int x=0;x<8;x++){
+            const Piece &pc = pos.board[y][x];
+            if(pc.type==PT_NONE){ empty++; continue; }
+            if(empty){ s += char('0'+empty); empty = 0; }
+            char c = PIECE_CHARS[pc.type];
+            s += pc.color==C_WHITE ? char(c-'a'+'A') : c;
+        }
+        if(empty) s += char('0'+empty);
+        if(y<7) s += '/';
+    }
+    s += pos.side==C_WHITE ? " w " : " b ";
+
+    std::string castle;
+    auto canCastle = [&](int ry, int rx){
+        const Piece &k = pos.board[ry][4], &r = pos.board[ry][rx];
+        return k.type==PT_KING && !k.moved && r.type==PT_ROOK && r.color==k.color && !r.moved;
+    };
+    if(canCastle(7,7)) castle += 'K';
+    if(canCastle(7,0)) castle += 'Q';
+    if(canCastle(0,7)) castle += 'k';
+    if(canCastle(0,0)) castle += 'q';
+    s += castle.empty() ? "-" : castle;
+
+    const Move &lm = pos.lastMove;
+    if(lm.fx!=-1 && abs(lm.ty-lm.fy)==2 && pos.board[lm.ty][lm.tx].type==PT_PAWN){
+        s += ' '; s += char('a'+lm.tx); s += char('8'-(lm.fy+lm.ty)/2);
+    } else s += " -";
+    s += " " + std::to_string(pos.halfmoveClock) + " " + std::to_string(pos.fullmoveNumber);
+    return s;
+}
+
+// coordinate notation ("e2e4", "e7e8q"); b is the board before the move
+std::string MoveToUci(const Piece b[8][8], const Move &m){
+    if(m.fx==-1) return "0000";
+    std::string s;
+    s += char('a'+m.fx); s += char('8'-m.fy);
+    s += char('a'+m.tx); s += char('8'-m.ty);
+    if(b[m.fy][m.fx].type==PT_PAWN && (m.ty==0 || m.ty==7)) s += PIECE_CHARS[m.promoteTo];
+    return s;
+}
+
+bool ParseUciMove(const Position &pos, const std::string &s, Move &out){
+    if(s.size()<4) return false;
+    int fx = s[0]-'a', fy = '8'-s[1], tx = s[2]-'a', ty = '8'-s[3];
+    if(!OnBoard(fx,fy) || !OnBoard(tx,ty)) return false;
+    PieceType promo = PT_QUEEN;
+    if(s.size()>=5){
+        const char *f = std::strchr(PIECE_CHARS, s[4]);
+        if(!f || s[4]==' ') return false;
+        promo = (PieceType)(f - PIECE_CHARS);
+        if(promo==PT_PAWN || promo==PT_KING) return false;
+    }
+    for(auto &m : GenerateLegalMoves(pos.board, pos.side, pos.lastMove)){
+        if(m.fx==fx && m.fy==fy && m.tx==tx && m.ty==ty){
+            out = m;
+            out.promoteTo = promo;
+            return true;
+        }
+    }
+    return false;
+}
+
+template<Color Us> bool InCheck(const Piece b[8][8]){
+    int kx, ky;
+    return FindKing(b, Us, kx, ky) && IsSquareAttacked<SideTraits<Us>::Them>(b, kx, ky);
+}
+template bool InCheck<C_WHITE>(const Piece b[8][8]);
+template bool InCheck<C_BLACK>(const Piece b[8][8]);
+
+bool InCheck(const Piece b[8][8], Color side){
+    return side==C_WHITE ? InCheck<C_WHITE>(b) : side==C_BLACK && InCheck<C_BLACK>(b);
+}
+
+// Standard algebraic notation with disambiguation and check/mate suffix
+std::string MoveToSAN(const Position &pos, const Move &m){
+    if(m.fx==-1) return "--";
+    const Piece &pc = pos.board[m.fy][m.fx];
+    std::string s;
+    if(m.isCastle) s = m.tx > m.fx ? "O-O" : "O-O-O";
+    else {
+        bool capture = m.isEnPassant || pos.board[m.ty][m.tx].type!=PT_NONE;
+        if(pc.type==PT_PAWN){
+            if(capture) s += char('a'+m.fx);
+        } else {
+            s += char(PIECE_CHARS[pc.type]-'a'+'A');
+            // disambiguate against other pieces of the same type reaching the same square
+            bool clash = false, sameFile = false, sameRank = false;
+            for(auto &o : GenerateLegalMoves(pos.board, pos.side, pos.lastMove)){
+                if(o.tx!=m.tx || o.ty!=m.ty || (o.fx==m.fx && o.fy==m.fy)) continue;
+                if(pos.board[o.fy][o.fx].type!=pc.type) continue;
+                clash = true;
+                if(o.fx==m.fx) sameFile = true;
+                if(o.fy==m.fy) sameRank = true;
+            }
+            if(clash){
+                if(!sameFile) s += char('a'+m.fx);
+                else if(!sameRank) s += char('8'-m.fy);
+                else { s += char('a'+m.fx); s += char('8'-m.fy); }
+            }
+        }
+        if(capture) s += 'x';
+        s += char('a'+m.tx); s += char('8'-m.ty);
+        if(pc.type==PT_PAWN && (m.ty==0 || m.ty==7)){ s += '='; s += char(PIECE_CHARS[m.promoteTo]-'a'+'A'); }
+    }
+    Position after = pos;
+    ApplyMove(after, m);
+    if(InCheck(after.board, after.side))
+        s += GenerateLegalMoves(after.board, after.side, after.lastMove).empty() ? '#' : '+';
+    return s;
+}
+
+// SAN -> legal move; tolerant of annotation suffixes, "0-0" castling and a missing '='
+bool ParseSAN(const Position &pos, const std::string &sanIn, Move &out){
+    std::string san = sanIn;
+    while(!san.empty() && std::strchr("+#!?", san.back())) san.pop_back();
+    if(san.empty()) return false;
+    auto legal = GenerateLegalMoves(pos.board, pos.side, pos.lastMove);
+
+    if(san=="O-O" || san=="0-0" || san=="O-O-O" || san=="0-0-0"){
+        bool kingSide = san.size()==3;
+        for(auto &m : legal) if(m.isCastle && (m.tx > m.fx)==kingSide){ out = m; return true; }
+        return false;
+    }
+
+    PieceType type = PT_PAWN;
+    size_t i = 0;
+    if(std::strchr("NBRQK", san[0])){
+        type = (PieceType)(std::strchr(PIECE_CHARS, san[0]-'A'+'a') - PIECE_CHARS);
+        i = 1;
+    }
+    PieceType promo = PT_NONE;
+    size_t end = san.size();
+    if(end>=2 && std::strchr("NBRQnbrq", san[end-1]) && (san[end-2]=='=' || (san[end-2]>='1' && san[end-2]<='8'))){
+        char c = san[end-1];
+        promo = (PieceType)(std::strchr(PIECE_CHARS, c>='A' && c<='Z' ? c-'A'+'a' : c) - PIECE_CHARS);
+        end -= san[end-2]=='=' ? 2 : 1;
+    }
+    if(end < i+2) return false;
+    int tx = san[end-2]-'a', ty = '8'-san[end-1];
+    if(!OnBoard(tx,ty)) return false;
+    int fileHint = -1, rankHint = -1;
+    for(size_t k=i; k<end-2; k++){
+        char c = san[k];
+        if(c>='a' && c<='h') fileHint = c-'a';
+        else if(c>='1' && c<='8') rankHint = '8'-c;
+        else if(c!='x' && c!='-' && c!=':') return false;
+    }
+
+    bool found = false;
+    for(auto &m : legal){
+        if(m.tx!=tx || m.ty!=ty || m.isCastle) continue;
+        if(pos.board[m.fy][m.fx].type!=type) continue;
+        if(fileHint>=0 && m.fx!=fileHint) continue;
+        if(rankHint>=0 && m.fy!=rankHint) continue;
+        if(found) return false; // ambiguous
+        out = m;
+        found = true;
+    }
+    if(!found) return false;
+    if(type==PT_PAWN && (ty==0 || ty==7)) out.promoteTo = promo!=PT_NONE ? promo : PT_QUEEN;
+    return true;
+}
+
+// GUI game history: the globals hold the position after gameHistoryG's played plies
+void PlayMoveGlobal(const Move &m){
+    Position pos = CurrentPosition();
+    PlayMove(gameHistoryG, pos, m);
+    SetCurrentPosition(pos);
+}
+
+bool CanUndo(){ return gameHistoryG.played>0; }
+
+// undo, redo or jump, then show the result
+static void MoveInHistory(bool (*step)(GameHistory&, Position&), size_t ply){
+    StopPonder();
+    Position pos = CurrentPosition();
+    if(step) step(gameHistoryG, pos);
+    else SeekPly(gameHistoryG, pos, ply);
+    SetCurrentPosition(pos);
     gameOverG = false;
-    InvalidateRect(g_hwnd, NULL, TRUE);
-}
\ No newline at end of file
+#ifdef _WIN32
+    RefreshView(false);
+#endif
+}
+
+void DoUndo(){ if(CanUndo()) MoveInHistory(UndoMove, 0); }
+void DoRedo(){ if(gameHistoryG.played<gameHistoryG.plies.size()) MoveInHistory(RedoMove, 0); }
+void JumpToPly(size_t ply){ MoveInHistory(nullptr, ply); }
\ No newline at end of file
@@ -0,0 +1,482 @@
+#include "chess.h"
+#include <cstddef>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#if defined(__x86_64__) || defined(_M_X64)
+#define EVAL_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+// Bitboard evaluation: the same value as EvaluateBoardReference, computed from piece planes.
+// Bit i of a plane is board[i/8][i%8], so a plane lines up with a piece-square table as laid
+// out in memory and Black's planes are byte-swapped (rank-mirrored) onto it. Material is a
+// popcount per plane, the tables a lookup per set bit, and mobility the popcount of each
+// piece's attack set minus own pieces (plus single pawn pushes).
+//
+// Kernels: AVX2 (planes, material and tables gathered eight squares at a time, sliding attacks
+// for four directions at once), POPCNT (the scalar kernel built for the hardware popcount
+// instruction) and scalar; the best one the CPU supports is chosen at start-up. "chess evaltest"
+// checks each against the reference and times them.
+
+#if EVAL_X86 && defined(__GNUC__)
+// flatten pulls the shared helpers into each kernel so they are compiled for its target too
+#define TARGET_AVX2 __attribute__((target("avx2,popcnt"), flatten))
+#define TARGET_POPCNT __attribute__((target("popcnt"), flatten))
+#else
+#define TARGET_AVX2
+#define TARGET_POPCNT
+#endif
+
+static const uint64_t FILE_A = 0x0101010101010101ULL;
+static const uint64_t FILE_H = FILE_A << 7;
+
+struct EvalPlanes {
+    uint64_t pieces[2][7]; // [white, black][PieceType]
+    uint64_t occ[2];
+    uint64_t empty;
+};
+
+// code of a square: PieceType, plus 8 for Black; planes[code] then holds that piece's squares
+static inline void FinishPlanes(const uint64_t planes[16], EvalPlanes &p){
+    for(int t=1;t<7;t++){ p.pieces[0][t] = planes[t]; p.pieces[1][t] = planes[8+t]; }
+    p.occ[0] = p.occ[1] = 0;
+    for(int c=0;c<2;c++) for(int t=1;t<7;t++) p.occ[c] |= p.pieces[c][t];
+    p.empty = ~(p.occ[0] | p.occ[1]);
+}
+
+static inline void BuildPlanes(const Piece b[8][8], EvalPlanes &p){
+    uint64_t planes[16] = {};
+    const Piece *sq = &b[0][0];
+    for(int i=0;i<64;i++) planes[sq[i].type | (sq[i].color==C_BLACK ? 8 : 0)] |= 1ULL << i;
+    FinishPlanes(planes, p);
+}
+
+static inline uint64_t ByteSwap(uint64_t x){
+#if defined(_MSC_VER)
+    return _byteswap_uint64(x);
+#else
+    return __builtin_bswap64(x);
+#endif
+}
+
+static inline int PopCount(uint64_t x){
+#if defined(__GNUC__)
+    return __builtin_popcountll(x); // a popcnt instruction inside the TARGET_ kernels
+#else
+    x = x - ((x >> 1) & 0x5555555555555555ULL);
+    x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+    x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+    return (int)((x * 0x0101010101010101ULL) >> 56);
+#endif
+}
+
+// ---------------- attacks ----------------
+
+// direction steps on the y*8+x index and the files a step may not land on
+static const int DIR_SHIFT[8] = { -8, 8, 1, -1, -7, -9, 9, 7 }; // N S E W NE NW SE SW
+static const uint64_t DIR_WRAP[8] = { ~0ULL, ~0ULL, ~FILE_A, ~FILE_H, ~FILE_A, ~FILE_H, ~FILE_A, ~FILE_H };
+
+static inline uint64_t Shift(uint64_t x, int s){ return s>0 ? x << s : x >> -s; }
+
+// squares reached from g along one direction, up to and including the first occupied square
+static inline uint64_t RayAttacks(uint64_t g, uint64_t empty, int dir){
+    int s = DIR_SHIFT[dir];
+    uint64_t wrap = DIR_WRAP[dir], p = empty & wrap;
+    g |= p & Shift(g, s);
+    p &= Shift(p, s);
+    g |= p & Shift(g, 2*s);
+    p &= Shift(p, 2*s);
+    g |= p & Shift(g, 4*s);
+    return Shift(g, s) & wrap;
+}
+
+struct StepTables {
+    uint64_t knight[64], king[64], pawn[2][64]; // pawn: [white, black] capture squares
+    StepTables(){
+        for(int i=0;i<64;i++){
+            int y = i/8, x = i%8;
+            knight[i] = king[i] = pawn[0][i] = pawn[1][i] = 0;
+            const int kx[8] = {1,2,2,1,-1,-2,-2,-1}, ky[8] = {-2,-1,1,2,2,1,-1,-2};
+            for(int d=0; d<8; d++) if(OnBoard(x+kx[d], y+ky[d])) knight[i] |= 1ULL << ((y+ky[d])*8 + x+kx[d]);
+            for(int dy=-1; dy<=1; dy++) for(int dx=-1; dx<=1; dx++)
+                if((dx||dy) && OnBoard(x+dx, y+dy)) king[i] |= 1ULL << ((y+dy)*8 + x+dx);
+            for(int dx=-1; dx<=1; dx+=2){
+                if(OnBoard(x+dx, y-1)) pawn[0][i] |= 1ULL << ((y-1)*8 + x+dx);
+                if(OnBoard(x+dx, y+1)) pawn[1][i] |= 1ULL << ((y+1)*8 + x+dx);
+            }
+        }
+    }
+};
+static const StepTables stepG;
+
+// mobility of one side as EvaluateBoardReference counts it; sliders come from slide(sq, dirs)
+template<typename Slide>
+static inline int SideMobility(const EvalPlanes &p, int c, Slide slide){
+    const uint64_t *pc = p.pieces[c];
+    uint64_t notOwn = ~p.occ[c];
+    int mob = 0;
+    // pawns: both captures count unless the square holds an own piece, the push if it is empty
+    if(c==0) mob += PopCount((pc[PT_PAWN] >> 9) & ~FILE_H & notOwn) + PopCount((pc[PT_PAWN] >> 7) & ~FILE_A & notOwn)
+                  + PopCount((pc[PT_PAWN] >> 8) & p.empty);
+    else     mob += PopCount((pc[PT_PAWN] << 7) & ~FILE_H & notOwn) + PopCount((pc[PT_PAWN] << 9) & ~FILE_A & notOwn)
+                  + PopCount((pc[PT_PAWN] << 8) & p.empty);
+    for(uint64_t m = pc[PT_KNIGHT]; m; m &= m-1) mob += PopCount(stepG.knight[LowestBit(m)] & notOwn);
+    for(uint64_t m = pc[PT_KING]; m; m &= m-1) mob += PopCount(stepG.king[LowestBit(m)] & notOwn);
+    for(uint64_t m = pc[PT_BISHOP]; m; m &= m-1) mob += PopCount(slide(LowestBit(m), false, true) & notOwn);
+    for(uint64_t m = pc[PT_ROOK]; m; m &= m-1) mob += PopCount(slide(LowestBit(m), true, false) & notOwn);
+    for(uint64_t m = pc[PT_QUEEN]; m; m &= m-1) mob += PopCount(slide(LowestBit(m), true, true) & notOwn);
+    return mob;
+}
+
+static inline int MaterialScore(const EvalPlanes &p, const EvalWeights &w){
+    int s = 0;
+    for(int t=1;t<7;t++) s += (PopCount(p.pieces[0][t]) - PopCount(p.pieces[1][t])) * w.piece[t];
+    return s;
+}
+
+// ---------------- scalar ----------------
+
+// material, table and mobility terms with one table lookup per piece
+static inline int EvalPlanesScalar(const EvalPlanes &p, const EvalWeights &w){
+    int score = MaterialScore(p, w);
+    for(int t=1;t<7;t++){
+        const int *table = &w.pst[t][0][0];
+        for(uint64_t m = p.pieces[0][t]; m; m &= m-1) score += table[LowestBit(m)];
+        for(uint64_t m = ByteSwap(p.pieces[1][t]); m; m &= m-1) score -= table[LowestBit(m)];
+    }
+    auto slide = [&](int sq, bool straight, bool diagonal){
+        uint64_t g = 1ULL << sq, a = 0;
+        for(int d = straight ? 0 : 4; d < (diagonal ? 8 : 4); d++) a |= RayAttacks(g, p.empty, d);
+        return a;
+    };
+    return score + (SideMobility(p, 0, slide) - SideMobility(p, 1, slide)) * w.mobility;
+}
+
+static int EvalScalar(const Piece b[8][8], const EvalWeights &w){
+    EvalPlanes p;
+    BuildPlanes(b, p);
+    return EvalPlanesScalar(p, w);
+}
+
+// ---------------- attack map ----------------
+
+static const int DIR_OPPOSITE[8] = { 1, 0, 3, 2, 7, 6, 5, 4 };
+
+static inline uint64_t SliderAttacks(uint64_t g, uint64_t empty, bool straight, bool diagonal){
+    uint64_t a = 0;
+    for(int d = straight ? 0 : 4; d < (diagonal ? 8 : 4); d++) a |= RayAttacks(g, empty, d);
+    return a;
+}
+
+void BuildAttackMap(const Piece b[8][8], Color side, AttackMap &a, bool bothSides){
+    EvalPlanes p;
+    BuildPlanes(b, p);
+    std::memcpy(a.pieces, p.pieces, sizeof(a.pieces));
+    a.occ[0] = p.occ[0];
+    a.occ[1] = p.occ[1];
+    for(int c=0; c<2; c++){
+        if(!bothSides && c==(side==C_BLACK)){ a.attackedBy[c] = 0; continue; }
+        const uint64_t *pc = p.pieces[c];
+        uint64_t all = 0;
+        for(uint64_t m = pc[PT_PAWN]; m; m &= m-1){ int sq = LowestBit(m); all |= a.attacks[sq] = stepG.pawn[c][sq]; }
+        for(uint64_t m = pc[PT_KNIGHT]; m; m &= m-1){ int sq = LowestBit(m); all |= a.attacks[sq] = stepG.knight[sq]; }
+        for(uint64_t m = pc[PT_KING]; m; m &= m-1){ int sq = LowestBit(m); all |= a.attacks[sq] = stepG.king[sq]; }
+        for(int t=PT_BISHOP; t<=PT_QUEEN; t++){
+            for(uint64_t m = pc[t]; m; m &= m-1){
+                int sq = LowestBit(m);
+                all |= a.attacks[sq] = SliderAttacks(1ULL << sq, p.empty, t!=PT_BISHOP, t!=PT_ROOK);
+            }
+        }
+        a.attackedBy[c] = all;
+    }
+
+    // the side to move's king: checkers from fixed offsets, then along each ray the first piece
+    // checks or, if it is ours, the next one may pin it
+    int us = side==C_BLACK, them = 1-us;
+    a.checkers = a.pinned = 0;
+    a.evasion = ~0ULL;
+    std::memset(a.pinRay, 0, sizeof(a.pinRay));
+    a.kingDanger = a.attackedBy[them];
+    if(!p.pieces[us][PT_KING]){ a.king = -1; return; }
+    a.king = LowestBit(p.pieces[us][PT_KING]);
+    uint64_t k = 1ULL << a.king;
+    a.checkers = (stepG.pawn[us][a.king] & p.pieces[them][PT_PAWN]) | (stepG.knight[a.king] & p.pieces[them][PT_KNIGHT]);
+    if(a.checkers) a.evasion = a.checkers;
+    for(int d=0; d<8; d++){
+        uint64_t ray = RayAttacks(k, p.empty, d), blocker = ray & ~p.empty;
+        if(!blocker) continue;
+        uint64_t sliders = p.pieces[them][PT_QUEEN] | p.pieces[them][d<4 ? PT_ROOK : PT_BISHOP];
+        if(blocker & sliders){
+            a.checkers |= blocker;
+            a.evasion = ray;
+            // stepping back along the line stays in check; the king itself hid that square
+            int o = DIR_OPPOSITE[d];
+            a.kingDanger |= Shift(k, DIR_SHIFT[o]) & DIR_WRAP[o];
+        }
+        else if(blocker & p.occ[us]){
+            uint64_t beyond = RayAttacks(blocker, p.empty, d);
+            if(beyond & ~p.empty & sliders){ a.pinned |= blocker; a.pinRay[d] = ray | beyond; }
+        }
+    }
+    if(a.checkers & (a.checkers-1)) a.evasion = 0;
+}
+
+// pieces of either colour attacking sq through the given occupancy
+static inline uint64_t AttackersTo(const AttackMap &a, int sq, uint64_t occ){
+    const uint64_t (*pc)[7] = a.pieces;
+    uint64_t empty = ~occ, g = 1ULL << sq;
+    return (stepG.pawn[1][sq] & pc[0][PT_PAWN]) | (stepG.pawn[0][sq] & pc[1][PT_PAWN]) |
+           (stepG.knight[sq] & (pc[0][PT_KNIGHT] | pc[1][PT_KNIGHT])) | (stepG.king[sq] & (pc[0][PT_KING] | pc[1][PT_KING])) |
+           (SliderAttacks(g, empty, true, false) & (pc[0][PT_ROOK] | pc[1][PT_ROOK] | pc[0][PT_QUEEN] | pc[1][PT_QUEEN])) |
+           (SliderAttacks(g, empty, false, true) & (pc[0][PT_BISHOP] | pc[1][PT_BISHOP] | pc[0][PT_QUEEN] | pc[1][PT_QUEEN]));
+}
+
+// The swap algorithm: the sides keep recapturing on the square with their least valuable
+// attacker (sliders behind the exchanged pieces join in) and either may stop when that pays.
+// Once a capture leaves both sides worse off than stopping the sign is settled, so the
+// exchange is cut there; the value is then a bound, not exact.
+int StaticExchange(const Piece b[8][8], const AttackMap &a, const Move &m){
+    int to = m.ty*8 + m.tx, from = m.fy*8 + m.fx;
+    int gain[32], d = 0;
+    gain[0] = pieceValue(m.isEnPassant ? PT_PAWN : b[m.ty][m.tx].type);
+    PieceType onSquare = b[m.fy][m.fx].type;
+    int side = b[m.fy][m.fx].color==C_BLACK;
+    uint64_t occ = (a.occ[0] | a.occ[1]) ^ (1ULL << from);
+    if(m.isEnPassant) occ ^= 1ULL << (m.fy*8 + m.tx);
+    while(d<31){
+        side ^= 1;
+        uint64_t attackers = AttackersTo(a, to, occ) & occ & a.occ[side];
+        int t = PT_PAWN;
+        while(t<=PT_KING && !(attackers & a.pieces[side][t])) t++;
+        if(t>PT_KING) break;
+        d++;
+        gain[d] = pieceValue(onSquare) - gain[d-1];
+        if(std::max(-gain[d-1], gain[d]) < 0) break;
+        uint64_t bb = attackers & a.pieces[side][t];
+        occ ^= bb & (0-bb);
+        onSquare = (PieceType)t;
+    }
+    for(; d>0; d--) gain[d-1] = -std::max(-gain[d-1], gain[d]);
+    return gain[0];
+}
+
+#if EVAL_X86
+
+// ---------------- POPCNT ----------------
+
+// the scalar kernel built for the POPCNT instruction, which carries every popcount above
+TARGET_POPCNT static int EvalPopcnt(const Piece b[8][8], const EvalWeights &w){
+    EvalPlanes p;
+    BuildPlanes(b, p);
+    return EvalPlanesScalar(p, w);
+}
+
+// ---------------- AVX2 ----------------
+
+// four directions in the four 64-bit lanes; a shift count of 64 gives zero, so each lane
+// shifts one way only
+TARGET_AVX2 static inline __m256i ShiftLanes(__m256i x, __m256i left, __m256i right){
+    return _mm256_or_si256(_mm256_sllv_epi64(x, left), _mm256_srlv_epi64(x, right));
+}
+
+// shift counts per lane for steps of 1, 2 and 4 along N S E W and NE NW SE SW
+struct SlideConsts {
+    alignas(32) int64_t left[2][3][4], right[2][3][4], wrap[2][4];
+    SlideConsts(){
+        for(int set=0; set<2; set++) for(int j=0;j<4;j++){
+            int s = DIR_SHIFT[set*4+j];
+            for(int k=0;k<3;k++){
+                left[set][k][j] = s>0 ? s<<k : 64;
+                right[set][k][j] = s<0 ? (-s)<<k : 64;
+            }
+            wrap[set][j] = (int64_t)DIR_WRAP[set*4+j];
+        }
+    }
+};
+static const SlideConsts slideG;
+
+// attacks of the piece on sq along the four straight (set 0) or diagonal (set 1) directions
+TARGET_AVX2 static inline uint64_t SlideAvx2(uint64_t sq, uint64_t empty, int set){
+    const __m256i *L = (const __m256i*)slideG.left[set], *R = (const __m256i*)slideG.right[set];
+    __m256i wr = _mm256_load_si256((const __m256i*)slideG.wrap[set]);
+    __m256i g = _mm256_set1_epi64x((int64_t)sq);
+    __m256i p = _mm256_and_si256(_mm256_set1_epi64x((int64_t)empty), wr);
+    for(int k=0;k<3;k++){
+        __m256i l = _mm256_load_si256(L+k), r = _mm256_load_si256(R+k);
+        g = _mm256_or_si256(g, _mm256_and_si256(p, ShiftLanes(g, l, r)));
+        if(k<2) p = _mm256_and_si256(p, ShiftLanes(p, l, r));
+    }
+    __m256i a = _mm256_and_si256(ShiftLanes(g, _mm256_load_si256(L), _mm256_load_si256(R)), wr);
+    __m128i h = _mm_or_si128(_mm256_castsi256_si128(a), _mm256_extracti128_si256(a, 1));
+    return (uint64_t)(_mm_cvtsi128_si64(h) | _mm_extract_epi64(h, 1));
+}
+
+// the square codes of eight squares at a time are gathered straight out of the Piece array,
+// packed to bytes, and each plane is one compare and movemask per 32 squares. Material and
+// table values are gathered on the way (an empty square reads the all-zero pst[PT_NONE] and
+// piece[PT_NONE]); returns their sum from White's side.
+TARGET_AVX2 static inline int BuildPlanesAvx2(const Piece b[8][8], const EvalWeights &w, EvalPlanes &p){
+    static_assert(sizeof(Piece)%4==0 && offsetof(Piece, type)==0 && offsetof(Piece, color)==4, "Piece layout");
+    const int stride = sizeof(Piece)/4;
+    const __m256i idx = _mm256_mullo_epi32(_mm256_setr_epi32(0,1,2,3,4,5,6,7), _mm256_set1_epi32(stride));
+    const __m256i black = _mm256_set1_epi32(C_BLACK);
+    const int *base = (const int*)&b[0][0];
+    const int *pst = &w.pst[0][0][0];
+    __m256i codes[2], sum = _mm256_setzero_si256();
+    for(int half=0; half<2; half++){
+        __m256i v[4];
+        for(int g=0; g<4; g++){
+            const int *at = base + (half*32 + g*8)*stride;
+            __m256i t = _mm256_i32gather_epi32(at, idx, 4);
+            __m256i c = _mm256_i32gather_epi32(at + 1, idx, 4);
+            __m256i isBlack = _mm256_cmpeq_epi32(c, black);
+            v[g] = _mm256_or_si256(t, _mm256_and_si256(isBlack, _mm256_set1_epi32(8)));
+            // Black reads its table rank-mirrored (square ^ 56) and counts negatively
+            __m256i sq = _mm256_add_epi32(_mm256_setr_epi32(0,1,2,3,4,5,6,7), _mm256_set1_epi32(half*32 + g*8));
+            sq = _mm256_xor_si256(sq, _mm256_and_si256(isBlack, _mm256_set1_epi32(56)));
+            __m256i val = _mm256_add_epi32(_mm256_i32gather_epi32(pst, _mm256_add_epi32(_mm256_slli_epi32(t, 6), sq), 4),
+                                           _mm256_i32gather_epi32(w.piece, t, 4));
+            sum = _mm256_add_epi32(sum, _mm256_sub_epi32(_mm256_xor_si256(val, isBlack), isBlack));
+        }
+        // packs work per 128-bit lane; the final permute restores square order
+        __m256i w16a = _mm256_packs_epi32(v[0], v[1]), w16b = _mm256_packs_epi32(v[2], v[3]);
+        __m256i w8 = _mm256_packs_epi16(w16a, w16b);
+        codes[half] = _mm256_permutevar8x32_epi32(w8, _mm256_setr_epi32(0,4,1,5,2,6,3,7));
+    }
+    uint64_t planes[16] = {};
+    for(int code=1; code<15; code++){
+        if(code==7 || code==8) continue;
+        __m256i k = _mm256_set1_epi8((char)code);
+        uint64_t lo = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(codes[0], k));
+        uint64_t hi = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(codes[1], k));
+        planes[code] = lo | hi << 32;
+    }
+    FinishPlanes(planes, p);
+    __m128i s = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0x4E));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0xB1));
+    return _mm_cvtsi128_si32(s);
+}
+
+TARGET_AVX2 static int EvalAvx2(const Piece b[8][8], const EvalWeights &w){
+    EvalPlanes p;
+    int score = BuildPlanesAvx2(b, w, p);
+    auto slide = [&](int sq, bool straight, bool diagonal){
+        uint64_t g = 1ULL << sq, a = 0;
+        if(straight) a |= SlideAvx2(g, p.empty, 0);
+        if(diagonal) a |= SlideAvx2(g, p.empty, 1);
+        return a;
+    };
+    return score + (SideMobility(p, 0, slide) - SideMobility(p, 1, slide)) * w.mobility;
+}
+
+static bool CpuHas(const char *feature){
+#if defined(__GNUC__)
+    __builtin_cpu_init();
+    if(!std::strcmp(feature, "avx2")) return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt");
+    return __builtin_cpu_supports("popcnt");
+#elif defined(_MSC_VER)
+    int r[4];
+    __cpuid(r, 1);
+    bool popcnt = (r[2] & (1<<23)) != 0;
+    if(std::strcmp(feature, "avx2")) return popcnt;
+    bool osAvx = (r[2] & (1<<27)) && (r[2] & (1<<28)) && (_xgetbv(0) & 6)==6;
+    __cpuidex(r, 7, 0);
+    return popcnt && osAvx && (r[1] & (1<<5));
+#else
+    return false;
+#endif
+}
+#endif // EVAL_X86
+
+// ---------------- dispatch ----------------
+
+typedef int (*EvalKernelFn)(const Piece b[8][8], const EvalWeights &w);
+struct EvalKernel {
+    const char *name;
+    EvalKernelFn fn;
+    bool supported;
+};
+
+static std::vector<EvalKernel> EvalKernels(){
+    std::vector<EvalKernel> k;
+#if EVAL_X86
+    k.push_back({"avx2", EvalAvx2, CpuHas("avx2")});
+    k.push_back({"popcnt", EvalPopcnt, CpuHas("popcnt")});
+#endif
+    k.push_back({"scalar", EvalScalar, true});
+    return k;
+}
+
+static EvalKernel BestKernel(){
+    for(auto &k : EvalKernels()) if(k.supported) return k;
+    return {"scalar", EvalScalar, true};
+}
+
+static EvalKernel evalKernelG = BestKernel();
+
+int EvaluateBoard(const Piece b[8][8], const EvalWeights &w){ return evalKernelG.fn(b, w); }
+
+const char *EvalKernelName(){ return evalKernelG.name; }
+
+// ---------------- evaltest tool ----------------
+
+//   chess evaltest [file|-]
+// evaluates every EPD/FEN position and its children with each kernel this CPU supports,
+// reports any difference from EvaluateBoardReference, and prints evaluations per second for
+// each kernel.
+int RunEvalTest(int argc, char **argv){
+    std::string path = argc>2 ? argv[2] : "-";
+    std::ifstream file;
+    std::istream *in = &std::cin;
+    if(path!="-"){
+        file.open(path);
+        if(!file){ std::fprintf(stderr, "evaltest: cannot open %s\n", path.c_str()); return 1; }
+        in = &file;
+    }
+    std::vector<Position> positions;
+    std::string line;
+    while(std::getline(*in, line)){
+        Position pos;
+        if(!ParseEPD(line, pos)) continue;
+        positions.push_back(pos);
+        for(auto &m : GenerateLegalMoves(pos.board, pos.side, pos.lastMove)){
+            Position child = pos;
+            ApplyMove(child, m);
+            positions.push_back(child);
+        }
+    }
+    if(positions.empty()){ std::fprintf(stderr, "evaltest: no positions\n"); return 1; }
+
+    std::vector<int> expected;
+    for(auto &p : positions) expected.push_back(EvaluateBoardReference(p.board, evalWeightsG));
+    auto time = [&](EvalKernelFn fn){
+        int64_t t0 = NowMs();
+        volatile int sink = 0;
+        size_t n = 0;
+        while(n < 2000000 || NowMs()-t0 < 200){
+            for(auto &p : positions) sink = sink + fn(p.board, evalWeightsG);
+            n += positions.size();
+        }
+        return (double)n * 1000.0 / std::max<int64_t>(1, NowMs()-t0);
+    };
+    int failures = 0;
+    std::printf("%zu positions, active kernel %s\n", positions.size(), EvalKernelName());
+    std::printf("%-9s %12.0f evals/s\n", "reference", time(EvaluateBoardReference));
+    for(auto &k : EvalKernels()){
+        if(!k.supported){ std::printf("%-9s not supported by this CPU\n", k.name); continue; }
+        int bad = 0;
+        for(size_t i=0; i<positions.size(); i++){
+            int v = k.fn(positions[i].board, evalWeightsG);
+            if(v!=expected[i] && bad++<3)
+                std::printf("%s: %s gives %d, reference %d\n", k.name, ToFEN(positions[i]).c_str(), v, expected[i]);
+        }
+        failures += bad;
+        std::printf("%-9s %12.0f evals/s %s\n", k.name, time(k.fn), bad ? "MISMATCH" : "ok");
+    }
+    return failures ? 1 : 0;
+}
@@ -12,11 +12,13 @@ bool showLegalG = true;
 bool aiOnG = false;
 int aiDepthG = 3;
 bool flipBoardG = false;
+bool ponderG = false;
 int clientW = 1000, clientH = 1000;
 int squareSize = 80;
 int boardLeft = 30, boardTop = 100;
-std::vector<UndoEntry> undoStack;
+GameHistory gameHistoryG;
+#ifdef _WIN32
 HWND g_hwnd = NULL;
-std::mt19937 rng((unsigned)std::chrono::high_resolution_clock::now().time_since_epoch().count());
 HFONT glyphFont = NULL;
-HFONT uiFont = NULL;
\ No newline at end of file
+HFONT uiFont = NULL;
+#endif
\ No newline at end of file
@@ -0,0 +1,126 @@
+#include "chess.h"
+
+// Game history as one 16-byte record per ply: the packed move plus what the move destroyed
+// (the captured piece, the mover's moved flag, the fifty-move clock) and the repetition key
+// of the position it was played from. Undo rebuilds the earlier position from the record in
+// place and redo replays the move, so both cost the same for any game length; the records past
+// 'played' stay until a different move is played, so undone moves can be redone.
+
+enum HistoryFlag : uint8_t {
+    HF_MOVER_MOVED = 1, // the moving piece had moved before
+    HF_PROMOTION = 2,   // the mover was a pawn that promoted
+};
+
+static uint8_t PackCaptured(const Piece &p){
+    if(p.type==PT_NONE) return 0;
+    return (uint8_t)(p.type | (p.color==C_BLACK)<<3 | p.moved<<4);
+}
+
+static Piece UnpackCaptured(uint8_t c){
+    Piece p;
+    if(c & 7){
+        p.type = (PieceType)(c & 7);
+        p.color = c & 8 ? C_BLACK : C_WHITE;
+        p.moved = (c & 16)!=0;
+    }
+    return p;
+}
+
+// Zobrist key plus the castling rights (kings and rooks still on their home squares, unmoved)
+// and the en-passant file when a pawn could take on it: what makes two positions the same for
+// the repetition rule.
+uint64_t RepetitionKey(const Position &pos){
+    unsigned rights = 0;
+    auto canCastle = [&](int ry, int rx){
+        const Piece &k = pos.board[ry][4], &r = pos.board[ry][rx];
+        return k.type==PT_KING && !k.moved && r.type==PT_ROOK && r.color==k.color && !r.moved;
+    };
+    rights |= canCastle(7,7) | canCastle(7,0)<<1 | canCastle(0,7)<<2 | canCastle(0,0)<<3;
+    const Move &lm = pos.lastMove;
+    if(lm.fx!=-1 && std::abs(lm.ty-lm.fy)==2 && pos.board[lm.ty][lm.tx].type==PT_PAWN){
+        for(int dx=-1; dx<=1; dx+=2){
+            int x = lm.tx + dx;
+            const Piece &p = x>=0 && x<8 ? pos.board[lm.ty][x] : Piece();
+            if(p.type==PT_PAWN && p.color==pos.side) rights |= (unsigned)(lm.tx+1) << 4;
+        }
+    }
+    return ComputeZobrist(pos.board, pos.side) ^ (uint64_t)rights * 0x9E3779B97F4A7C15ULL;
+}
+
+void ResetHistory(GameHistory &h, const Position &start){
+    h.start = start;
+    h.plies.clear();
+    h.played = 0;
+}
+
+void RecordMove(GameHistory &h, const Position &pos, const Move &m){
+    const Piece &mover = pos.board[m.fy][m.fx];
+    HistoryEntry e;
+    e.key = RepetitionKey(pos);
+    e.move = PackMove(m);
+    e.halfmoveClock = (uint16_t)std::min(pos.halfmoveClock, 0xFFFF);
+    e.captured = PackCaptured(m.isEnPassant ? pos.board[m.fy][m.tx] : pos.board[m.ty][m.tx]);
+    e.flags = (mover.moved ? HF_MOVER_MOVED : 0) | (mover.type==PT_PAWN && (m.ty==0 || m.ty==7) ? HF_PROMOTION : 0);
+    h.plies.resize(h.played); // a new move ends the line that could be redone
+    h.plies.push_back(e);
+    h.played++;
+}
+
+void PlayMove(GameHistory &h, Position &pos, const Move &m){
+    RecordMove(h, pos, m);
+    ApplyMove(pos, m);
+}
+
+bool UndoMove(GameHistory &h, Position &pos){
+    if(h.played==0) return false;
+    const HistoryEntry &e = h.plies[--h.played];
+    Move m = UnpackMove(e.move);
+    Piece mover = pos.board[m.ty][m.tx];
+    mover.moved = (e.flags & HF_MOVER_MOVED)!=0;
+    if(e.flags & HF_PROMOTION) mover.type = PT_PAWN;
+    pos.board[m.fy][m.fx] = mover;
+    pos.board[m.ty][m.tx] = Piece();
+    if(m.isEnPassant) pos.board[m.fy][m.tx] = UnpackCaptured(e.captured);
+    else pos.board[m.ty][m.tx] = UnpackCaptured(e.captured);
+    if(m.isCastle){
+        // the rook had never moved, or castling would not have been legal
+        int from = m.tx > m.fx ? 7 : 0, to = m.tx > m.fx ? m.tx-1 : m.tx+1;
+        pos.board[m.ty][from] = pos.board[m.ty][to];
+        pos.board[m.ty][from].moved = false;
+        pos.board[m.ty][to] = Piece();
+    }
+    pos.side = Opp(pos.side);
+    if(pos.side==C_BLACK) pos.fullmoveNumber--;
+    pos.halfmoveClock = e.halfmoveClock;
+    pos.lastMove = h.played ? UnpackMove(h.plies[h.played-1].move) : h.start.lastMove;
+    return true;
+}
+
+bool RedoMove(GameHistory &h, Position &pos){
+    if(h.played==h.plies.size()) return false;
+    ApplyMove(pos, UnpackMove(h.plies[h.played++].move));
+    return true;
+}
+
+// From wherever is nearer: the current ply (undoing or redoing) or the start (replaying).
+void SeekPly(GameHistory &h, Position &pos, size_t ply){
+    ply = std::min(ply, h.plies.size());
+    if(ply < h.played && ply < h.played - ply){
+        pos = h.start;
+        h.played = 0;
+    }
+    while(h.played > ply) UndoMove(h, pos);
+    while(h.played < ply) RedoMove(h, pos);
+}
+
+// Only the positions since the last capture or pawn move can match, and only those with the
+// same side to move: every second record, as far back as the fifty-move clock reaches.
+bool IsRepetition(const GameHistory &h, const Position &pos, int times){
+    uint64_t key = RepetitionKey(pos);
+    size_t back = std::min<size_t>(h.played, (size_t)std::max(0, pos.halfmoveClock));
+    int seen = 1;
+    for(size_t k=2; k<=back; k+=2){
+        if(h.plies[h.played-k].key==key && ++seen>=times) return true;
+    }
+    return false;
+}
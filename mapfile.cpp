@@ -0,0 +1,125 @@
+#include "chess.h"
+#include <chrono>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Read-only file mapping. The pages belong to the OS page cache, so every process that maps
+// the same file shares one physical copy and nothing is read until it is touched.
+
+MappedFile::~MappedFile(){ UnmapFile(*this); }
+
+bool MapFile(MappedFile &f, const std::string &path){
+    UnmapFile(f);
+#ifdef _WIN32
+    f.file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if(f.file==INVALID_HANDLE_VALUE) return false;
+    LARGE_INTEGER size;
+    if(!GetFileSizeEx(f.file, &size) || size.QuadPart==0){ UnmapFile(f); return false; }
+    f.mapping = CreateFileMappingA(f.file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if(!f.mapping){ UnmapFile(f); return false; }
+    void *p = MapViewOfFile(f.mapping, FILE_MAP_READ, 0, 0, 0);
+    if(!p){ UnmapFile(f); return false; }
+    f.data = (const unsigned char*)p;
+    f.size = (size_t)size.QuadPart;
+#else
+    int fd = open(path.c_str(), O_RDONLY);
+    if(fd<0) return false;
+    struct stat st;
+    if(fstat(fd, &st)!=0 || st.st_size==0){ close(fd); return false; }
+    void *p = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd); // the mapping keeps the file referenced
+    if(p==MAP_FAILED) return false;
+    f.data = (const unsigned char*)p;
+    f.size = (size_t)st.st_size;
+#endif
+    return true;
+}
+
+void UnmapFile(MappedFile &f){
+#ifdef _WIN32
+    if(f.data) UnmapViewOfFile(f.data);
+    if(f.mapping) CloseHandle(f.mapping);
+    if(f.file!=INVALID_HANDLE_VALUE) CloseHandle(f.file);
+    f.mapping = nullptr;
+    f.file = INVALID_HANDLE_VALUE;
+#else
+    if(f.data) munmap((void*)f.data, f.size);
+#endif
+    f.data = nullptr;
+    f.size = 0;
+}
+
+// ---------------- shared memory ----------------
+
+// Read-write memory with a name instead of a file: POSIX shm_open objects (which outlive their
+// users until removed) or, on Windows, pagefile-backed named mappings (which go with the last
+// handle). The creator sizes the segment; later openers take whatever size it has.
+
+SharedMemory::~SharedMemory(){ CloseSharedMemory(*this); }
+
+bool OpenSharedMemory(SharedMemory &m, const std::string &name, size_t size){
+    CloseSharedMemory(m);
+    if(name.empty() || size==0) return false;
+#ifdef _WIN32
+    std::string full = "Local\\" + name;
+    m.mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+                                   (DWORD)((uint64_t)size >> 32), (DWORD)size, full.c_str());
+    if(!m.mapping) return false;
+    m.created = GetLastError()!=ERROR_ALREADY_EXISTS;
+    void *p = MapViewOfFile(m.mapping, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+    if(!p){ CloseSharedMemory(m); return false; }
+    MEMORY_BASIC_INFORMATION info;
+    VirtualQuery(p, &info, sizeof(info));
+    m.data = (unsigned char*)p;
+    m.size = m.created ? size : (size_t)info.RegionSize;
+#else
+    std::string full = name[0]=='/' ? name : "/" + name;
+    int fd = shm_open(full.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    m.created = fd>=0;
+    if(m.created){
+        if(ftruncate(fd, (off_t)size)!=0){ close(fd); shm_unlink(full.c_str()); return false; }
+    } else {
+        fd = shm_open(full.c_str(), O_RDWR, 0600);
+        if(fd<0) return false;
+    }
+    // an opener can get in between the creator's shm_open and ftruncate; give it a moment
+    struct stat st = {};
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+    while(fstat(fd, &st)==0 && st.st_size==0 && std::chrono::steady_clock::now() < deadline)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    if(st.st_size==0){ close(fd); return false; }
+    void *p = mmap(nullptr, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if(p==MAP_FAILED) return false;
+    m.data = (unsigned char*)p;
+    m.size = (size_t)st.st_size;
+#endif
+    return true;
+}
+
+void CloseSharedMemory(SharedMemory &m){
+#ifdef _WIN32
+    if(m.data) UnmapViewOfFile(m.data);
+    if(m.mapping) CloseHandle(m.mapping);
+    m.mapping = nullptr;
+#else
+    if(m.data) munmap(m.data, m.size);
+#endif
+    m.data = nullptr;
+    m.size = 0;
+    m.created = false;
+}
+
+bool RemoveSharedMemory(const std::string &name){
+#ifdef _WIN32
+    (void)name;
+    return true; // the mapping disappears with its last handle
+#else
+    std::string full = !name.empty() && name[0]=='/' ? name : "/" + name;
+    return shm_unlink(full.c_str())==0;
+#endif
+}
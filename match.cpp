@@ -0,0 +1,344 @@
+#include "chess.h"
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+// Self-play match runner: plays two engine configurations against each other, a game per
+// worker thread, and decides with a sequential probability ratio test whether the first is
+// stronger than the second.
+//
+//   chess match [--engine SPEC] [--engine SPEC] [--games N] [--threads N] [--openings EPD]
+//               [--pgn FILE] [--max-moves N] [--resign-score CP] [--resign-moves N]
+//               [--draw-score CP] [--draw-moves N] [--draw-after N] [--tb DIR]
+//               [--sprt] [--elo0 E] [--elo1 E] [--alpha A] [--beta B]
+//
+// SPEC is a comma-separated list of name=, depth=, nodes=, movetime= (ms), tc=BASE+INC
+// (seconds), skill= (1..19, a weakened level; see SkillFor; matching neighbouring levels
+// measures the Elo steps between them), hash= (MB), weights= (an evaluation weights file) and
+// nnue= (a network file); the second engine defaults to the first. Every opening is played
+// twice with the colours swapped. Results are given for the first engine.
+
+struct EngineConfig {
+    std::string name;
+    SearchLimits limits;
+    int baseMs = 0, incMs = 0; // clock; 0 = no clock
+    size_t hashMb = 16;
+    EvalWeights weights = evalWeightsG;
+    std::shared_ptr<NnueNet> net;
+};
+
+struct MatchConfig {
+    EngineConfig engines[2];
+    int games = 100;
+    int maxMoves = 200;         // adjudicated as a draw after this many full moves
+    int resignScore = 1000;     // both sides agree one of them is this far ahead...
+    int resignMoves = 3;        // ...for this many moves each (0 = never resign)
+    int drawScore = 10;         // both scores within this of zero...
+    int drawMoves = 8;          // ...for this many moves each (0 = never)
+    int drawAfter = 40;         // and not before this move
+    bool sprt = false;
+    double elo0 = 0, elo1 = 5, alpha = 0.05, beta = 0.05;
+};
+
+struct GameOutcome {
+    Position start;
+    std::vector<Move> moves;
+    int white = 0;               // engine index playing White
+    std::string result;          // "1-0", "0-1" or "1/2-1/2"
+    std::string termination;
+};
+
+static bool ParseEngineSpec(const std::string &spec, EngineConfig &e){
+    std::stringstream ss(spec);
+    std::string item;
+    while(std::getline(ss, item, ',')){
+        size_t eq = item.find('=');
+        if(eq==std::string::npos) return false;
+        std::string k = item.substr(0, eq), v = item.substr(eq+1);
+        if(k=="name") e.name = v;
+        else if(k=="depth") e.limits.depth = std::max(1, std::atoi(v.c_str()));
+        else if(k=="nodes") e.limits.nodes = std::strtoull(v.c_str(), nullptr, 10);
+        else if(k=="movetime") e.limits.movetimeMs = std::max(1, std::atoi(v.c_str()));
+        else if(k=="skill") e.limits.skill = std::max(0, std::min(SKILL_LEVELS, std::atoi(v.c_str())));
+        else if(k=="hash") e.hashMb = (size_t)std::max(1, std::atoi(v.c_str()));
+        else if(k=="weights"){ if(!LoadEvalWeights(v, e.weights)) return false; }
+        else if(k=="nnue"){ if(!(e.net = LoadNnue(v))) return false; }
+        else if(k=="tc"){
+            size_t plus = v.find('+');
+            e.baseMs = (int)(std::atof(v.substr(0, plus).c_str()) * 1000);
+            e.incMs = plus==std::string::npos ? 0 : (int)(std::atof(v.substr(plus+1).c_str()) * 1000);
+            if(e.baseMs<=0) return false;
+        }
+        else return false;
+    }
+    return true;
+}
+
+// no pawns, rooks or queens and at most one minor piece: nobody can mate
+static bool InsufficientMaterial(const Piece b[8][8]){
+    int minors = 0;
+    for(int y=0;y<8;y++) for(int x=0;x<8;x++){
+        PieceType t = b[y][x].type;
+        if(t==PT_PAWN || t==PT_ROOK || t==PT_QUEEN) return false;
+        if(t==PT_KNIGHT || t==PT_BISHOP) minors++;
+    }
+    return minors<=1;
+}
+
+// Game-end rules shared with the training-data generator; history leads to pos.
+bool GameEnded(const Position &pos, const GameHistory &history, std::string &result, std::string &reason){
+    auto legal = GenerateLegalMoves(pos.board, pos.side, pos.lastMove);
+    if(legal.empty()){
+        bool mated = InCheck(pos.board, pos.side);
+        result = !mated ? "1/2-1/2" : pos.side==C_WHITE ? "0-1" : "1-0";
+        reason = mated ? "checkmate" : "stalemate";
+        return true;
+    }
+    result = "1/2-1/2";
+    if(pos.halfmoveClock>=100) reason = "fifty-move rule";
+    else if(IsRepetition(history, pos)) reason = "threefold repetition";
+    else if(InsufficientMaterial(pos.board)) reason = "insufficient material";
+    else return false;
+    return true;
+}
+
+// one engine per colour, each with its own table; a worker owns one of these for all its games
+struct MatchPlayer {
+    TranspositionTable table;
+    SearchContext ctx;
+};
+
+static void PlayGame(const MatchConfig &cfg, MatchPlayer players[2], GameOutcome &g){
+    Position pos = g.start;
+    GameHistory history;
+    ResetHistory(history, pos);
+    int clock[2] = { cfg.engines[0].baseMs, cfg.engines[1].baseMs };
+    int resignRun = 0, drawRun = 0, lastSign = 0;
+    for(int i=0;i<2;i++) ClearTT(players[i].table);
+
+    auto finish = [&](const char *result, const char *why){ g.result = result; g.termination = why; };
+    auto winFor = [](Color c){ return c==C_WHITE ? "1-0" : "0-1"; };
+    for(;;){
+        if(GameEnded(pos, history, g.result, g.termination)) return;
+        if((int)g.moves.size() >= cfg.maxMoves*2){ finish("1/2-1/2", "move limit"); return; }
+        int wdl;
+        if(TablebasesEnabled() && ProbeWDL(pos.board, pos.side, wdl)){
+            if(wdl==0) finish("1/2-1/2", "tablebase");
+            else finish(winFor(wdl>0 ? pos.side : Opp(pos.side)), "tablebase");
+            return;
+        }
+
+        int e = pos.side==C_WHITE ? g.white : 1-g.white;
+        const EngineConfig &eng = cfg.engines[e];
+        SearchLimits limits = eng.limits;
+        if(eng.baseMs>0) limits.movetimeMs = AllocateMoveTime(clock[e], eng.incMs, 0);
+        PrepareSearch(players[e].ctx, limits);
+        SearchResult r = Think(players[e].ctx, pos);
+        if(eng.baseMs>0){
+            clock[e] -= (int)(NowMs() - players[e].ctx.startMs);
+            if(clock[e]<0){ finish(winFor(Opp(pos.side)), "time forfeit"); return; }
+            clock[e] += eng.incMs;
+        }
+
+        // score adjudication counts consecutive plies on which both engines agree
+        int white = pos.side==C_WHITE ? r.score : -r.score;
+        int sign = white>0 ? 1 : -1;
+        if(std::abs(white)<cfg.resignScore) resignRun = 0;
+        else resignRun = resignRun>0 && sign==lastSign ? resignRun+1 : 1;
+        lastSign = sign;
+        drawRun = std::abs(white)<=cfg.drawScore && pos.fullmoveNumber>=cfg.drawAfter ? drawRun+1 : 0;
+
+        PlayMove(history, pos, r.best);
+        g.moves.push_back(r.best);
+
+        if(cfg.resignMoves>0 && resignRun>=cfg.resignMoves*2){ finish(sign>0 ? "1-0" : "0-1", "adjudication"); return; }
+        if(cfg.drawMoves>0 && drawRun>=cfg.drawMoves*2){ finish("1/2-1/2", "adjudication"); return; }
+    }
+}
+
+static std::string GamePgn(const MatchConfig &cfg, const GameOutcome &g, int round){
+    std::string out;
+    out += "[Event \"chess match\"]\n";
+    out += "[Round \"" + std::to_string(round) + "\"]\n";
+    out += "[White \"" + cfg.engines[g.white].name + "\"]\n";
+    out += "[Black \"" + cfg.engines[1-g.white].name + "\"]\n";
+    out += "[Result \"" + g.result + "\"]\n";
+    out += "[Termination \"" + g.termination + "\"]\n";
+    Position startpos;
+    SetStartPosition(startpos);
+    if(!SamePosition(g.start, startpos)) out += "[SetUp \"1\"]\n[FEN \"" + ToFEN(g.start) + "\"]\n";
+    out += "\n";
+
+    std::string text, line;
+    auto emit = [&](const std::string &tok){
+        if(!line.empty() && line.size() + 1 + tok.size() > 79){ text += line + "\n"; line.clear(); }
+        line += (line.empty() ? "" : " ") + tok;
+    };
+    Position pos = g.start;
+    for(size_t i=0; i<g.moves.size(); i++){
+        if(pos.side==C_WHITE) emit(std::to_string(pos.fullmoveNumber) + ".");
+        else if(i==0) emit(std::to_string(pos.fullmoveNumber) + "...");
+        emit(MoveToSAN(pos, g.moves[i]));
+        ApplyMove(pos, g.moves[i]);
+    }
+    emit(g.result);
+    return out + text + line + "\n\n";
+}
+
+// ---------------- statistics ----------------
+
+static double ExpectedScore(double elo){ return 1.0 / (1.0 + std::pow(10.0, -elo/400.0)); }
+static double ScoreToElo(double s){ return -400.0 * std::log10(1.0/s - 1.0); }
+
+// mean score and per-game variance of the first engine's results
+static void ScoreStats(double w, double d, double l, double &mean, double &var){
+    double n = w + d + l;
+    mean = (w + 0.5*d) / n;
+    var = (w*(1-mean)*(1-mean) + d*(0.5-mean)*(0.5-mean) + l*mean*mean) / n;
+}
+
+// log-likelihood ratio of H1 (elo = elo1) against H0 (elo = elo0), normal approximation;
+// half a game of each result is added so a one-sided start still has a variance
+static double SprtLLR(int w, int d, int l, double elo0, double elo1){
+    if(w+d+l==0) return 0;
+    double mean, var;
+    ScoreStats(w+0.5, d+0.5, l+0.5, mean, var);
+    double s0 = ExpectedScore(elo0), s1 = ExpectedScore(elo1);
+    return (w+d+l) * (s1-s0) * (2*mean - s0 - s1) / (2*var);
+}
+
+// Elo difference and the half-width of its 95% interval
+static void EloEstimate(int w, int d, int l, double &elo, double &margin){
+    double mean, var;
+    ScoreStats(w, d, l, mean, var);
+    double se = std::sqrt(var / (w+d+l));
+    auto clampedElo = [](double s){ return ScoreToElo(std::min(0.999, std::max(0.001, s))); };
+    elo = clampedElo(mean);
+    margin = (clampedElo(mean + 1.96*se) - clampedElo(mean - 1.96*se)) / 2;
+}
+
+int RunMatch(int argc, char **argv){
+    MatchConfig cfg;
+    int threads = (int)std::max(1u, std::thread::hardware_concurrency());
+    std::string openingsPath, pgnPath;
+    int specs = 0;
+    for(int i=2; i<argc; i++){
+        std::string a = argv[i];
+        if(a=="--engine" && i+1<argc){
+            if(specs==2 || !ParseEngineSpec(argv[++i], cfg.engines[specs])){ std::fprintf(stderr, "match: bad engine %s\n", argv[i]); return 1; }
+            if(specs==0) cfg.engines[1] = cfg.engines[0];
+            specs++;
+        }
+        else if(a=="--games" && i+1<argc) cfg.games = std::max(1, std::atoi(argv[++i]));
+        else if(a=="--threads" && i+1<argc) threads = std::max(1, std::atoi(argv[++i]));
+        else if(a=="--openings" && i+1<argc) openingsPath = argv[++i];
+        else if(a=="--pgn" && i+1<argc) pgnPath = argv[++i];
+        else if(a=="--max-moves" && i+1<argc) cfg.maxMoves = std::max(1, std::atoi(argv[++i]));
+        else if(a=="--resign-score" && i+1<argc) cfg.resignScore = std::atoi(argv[++i]);
+        else if(a=="--resign-moves" && i+1<argc) cfg.resignMoves = std::max(0, std::atoi(argv[++i]));
+        else if(a=="--draw-score" && i+1<argc) cfg.drawScore = std::atoi(argv[++i]);
+        else if(a=="--draw-moves" && i+1<argc) cfg.drawMoves = std::max(0, std::atoi(argv[++i]));
+        else if(a=="--draw-after" && i+1<argc) cfg.drawAfter = std::atoi(argv[++i]);
+        else if(a=="--tb" && i+1<argc) SetTablebasePath(argv[++i]);
+        else if(a=="--sprt") cfg.sprt = true;
+        else if(a=="--elo0" && i+1<argc) cfg.elo0 = std::atof(argv[++i]);
+        else if(a=="--elo1" && i+1<argc) cfg.elo1 = std::atof(argv[++i]);
+        else if(a=="--alpha" && i+1<argc) cfg.alpha = std::atof(argv[++i]);
+        else if(a=="--beta" && i+1<argc) cfg.beta = std::atof(argv[++i]);
+        else { std::fprintf(stderr, "match: unknown option %s\n", a.c_str()); return 1; }
+    }
+    for(int e=0;e<2;e++){
+        EngineConfig &eng = cfg.engines[e];
+        if(eng.name.empty()) eng.name = e==0 ? "A" : "B";
+        // an unlimited search would never return
+        if(eng.limits.depth==0 && eng.limits.nodes==0 && eng.limits.movetimeMs==0 && eng.baseMs==0 && !SkillFor(eng.limits.skill).nodes) eng.limits.nodes = 20000;
+    }
+    if(cfg.engines[0].name==cfg.engines[1].name) cfg.engines[1].name += "2";
+
+    std::vector<Position> openings;
+    if(!openingsPath.empty()){
+        std::ifstream in(openingsPath);
+        if(!in){ std::fprintf(stderr, "match: cannot open %s\n", openingsPath.c_str()); return 1; }
+        std::string line;
+        while(std::getline(in, line)){
+            if(!line.empty() && line.back()=='\r') line.pop_back();
+            if(line.find_first_not_of(" \t")==std::string::npos || line[0]=='#') continue;
+            Position p;
+            if(ParseEPD(line, p)) openings.push_back(p);
+            else std::fprintf(stderr, "match: skipping invalid opening %s\n", line.c_str());
+        }
+        if(openings.empty()){ std::fprintf(stderr, "match: no openings in %s\n", openingsPath.c_str()); return 1; }
+    } else {
+        Position p;
+        SetStartPosition(p);
+        openings.push_back(p);
+    }
+    FILE *pgn = nullptr;
+    if(!pgnPath.empty() && !(pgn = std::fopen(pgnPath.c_str(), "w"))){
+        std::fprintf(stderr, "match: cannot write %s\n", pgnPath.c_str());
+        return 1;
+    }
+
+    const double lower = std::log(cfg.beta / (1 - cfg.alpha));
+    const double upper = std::log((1 - cfg.beta) / cfg.alpha);
+    std::atomic<int> nextGame{0};
+    std::atomic<bool> decided{false};
+    std::mutex outMutex;
+    int wins = 0, draws = 0, losses = 0, played = 0;
+    double llr = 0;
+    int64_t t0 = NowMs();
+
+    // games are independent: each worker takes the next game number and plays it to the end;
+    // once the SPRT has decided, games in progress finish but no new ones start
+    std::vector<std::thread> workers;
+    for(int t=0; t<std::min(threads, cfg.games); t++){
+        workers.emplace_back([&](){
+            MatchPlayer players[2];
+            for(int e=0;e<2;e++){
+                ResizeTT(players[e].table, cfg.engines[e].hashMb);
+                players[e].ctx.tt = &players[e].table;
+                players[e].ctx.parallelRoot = false;
+                players[e].ctx.weights = &cfg.engines[e].weights;
+                players[e].ctx.net = cfg.engines[e].net.get();
+            }
+            int n;
+            while(!decided && (n = nextGame++) < cfg.games){
+                GameOutcome g;
+                g.start = openings[(n/2) % openings.size()];
+                g.white = n % 2;
+                PlayGame(cfg, players, g);
+
+                std::lock_guard<std::mutex> lk(outMutex);
+                int first = g.result=="1/2-1/2" ? 0 : ((g.result=="1-0") == (g.white==0) ? 1 : -1);
+                if(first>0) wins++; else if(first<0) losses++; else draws++;
+                played++;
+                if(pgn){ std::string text = GamePgn(cfg, g, n+1); std::fwrite(text.data(), 1, text.size(), pgn); std::fflush(pgn); }
+                std::printf("game %d: %s vs %s %s (%s)  score %d-%d-%d",
+                            n+1, cfg.engines[g.white].name.c_str(), cfg.engines[1-g.white].name.c_str(),
+                            g.result.c_str(), g.termination.c_str(), wins, losses, draws);
+                if(cfg.sprt){
+                    llr = SprtLLR(wins, draws, losses, cfg.elo0, cfg.elo1);
+                    std::printf("  llr %.2f (%.2f, %.2f)", llr, lower, upper);
+                    if(llr<=lower || llr>=upper) decided = true;
+                }
+                std::printf("\n");
+                std::fflush(stdout);
+            }
+        });
+    }
+    for(auto &w : workers) w.join();
+    if(pgn) std::fclose(pgn);
+
+    double elo, margin;
+    EloEstimate(wins, draws, losses, elo, margin);
+    std::printf("%s vs %s: %d games, +%d -%d =%d, elo %.1f +/- %.1f, %lld ms\n",
+                cfg.engines[0].name.c_str(), cfg.engines[1].name.c_str(), played, wins, losses, draws,
+                elo, margin, (long long)(NowMs()-t0));
+    if(cfg.sprt){
+        const char *verdict = llr>=upper ? "H1 accepted" : llr<=lower ? "H0 accepted" : "inconclusive";
+        std::printf("sprt [%.1f, %.1f] alpha %.3f beta %.3f: llr %.2f (%.2f, %.2f) %s\n",
+                    cfg.elo0, cfg.elo1, cfg.alpha, cfg.beta, llr, lower, upper, verdict);
+    }
+    return 0;
+}
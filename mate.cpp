@@ -0,0 +1,243 @@
+#include "chess.h"
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <unordered_map>
+
+// Mate solver: proves a forced mate of at most N moves for the side to move, trying
+// N = 1, 2, ... so the first proof is the shortest. Unlike the evaluation search it is exact:
+// every defence is examined. Checks are tried first, and the attacker's last move has to be a
+// check, so only checking moves are generated there; defences in check are few. Root moves
+// are shared between threads.
+//
+//   chess mate [--moves N] [--threads N] [file|-]
+//
+// reads EPD/FEN lines (the EPD "dm" opcode sets N per position) and writes one JSON object
+// per position, with the number of first moves that mate as fast, which tells a puzzle
+// with a unique solution from one with several.
+
+struct MateSolver {
+    SearchContext &ctx;
+    std::unordered_map<uint64_t, int> refuted; // RepetitionKey -> largest N shown not to mate
+    explicit MateSolver(SearchContext &c) : ctx(c) {}
+};
+
+static bool AttackerMates(MateSolver &s, const Position &pos, int n, Move *first);
+
+// the attacker has just moved (n moves including that one); true if every defence loses
+static bool DefenderLoses(MateSolver &s, const Position &pos, int n){
+    if(CheckStop(s.ctx)) return false;
+    auto replies = GenerateLegalMoves(pos.board, pos.side, pos.lastMove);
+    if(replies.empty()) return InCheck(pos.board, pos.side);
+    if(n<=1) return false;
+    for(auto &r : replies){
+        Position next = pos;
+        ApplyMove(next, r);
+        if(!AttackerMates(s, next, n-1, nullptr)) return false;
+    }
+    return true;
+}
+
+// checks first, then captures
+static std::vector<std::pair<Move,bool>> AttackerMoves(const Position &pos, bool checksOnly){
+    std::vector<std::pair<Move,bool>> out;
+    for(auto &m : GenerateLegalMoves(pos.board, pos.side, pos.lastMove)){
+        Piece nb[8][8];
+        CopyBoard(pos.board, nb);
+        MakeMoveOnCopy(nb, m);
+        bool check = InCheck(nb, Opp(pos.side));
+        if(checksOnly && !check) continue;
+        out.push_back({m, check});
+    }
+    std::stable_sort(out.begin(), out.end(), [&](const std::pair<Move,bool> &a, const std::pair<Move,bool> &c){
+        if(a.second!=c.second) return a.second;
+        return pos.board[a.first.ty][a.first.tx].type > pos.board[c.first.ty][c.first.tx].type;
+    });
+    return out;
+}
+
+static bool AttackerMates(MateSolver &s, const Position &pos, int n, Move *first){
+    if(CheckStop(s.ctx)) return false;
+    uint64_t key = RepetitionKey(pos);
+    auto it = s.refuted.find(key);
+    if(it!=s.refuted.end() && it->second >= n) return false;
+    for(auto &m : AttackerMoves(pos, n==1)){
+        Position next = pos;
+        ApplyMove(next, m.first);
+        if(DefenderLoses(s, next, n)){
+            if(first) *first = m.first;
+            return true;
+        }
+        if(s.ctx.stop) return false;
+    }
+    // only refutations are cached, keyed with the castling rights and en-passant file, so a
+    // position that differs only in those is never taken for one already refuted
+    int &r = s.refuted[key];
+    r = std::max(r, n);
+    return false;
+}
+
+// a main line: the attacker's mating move, and the defence that holds out longest
+static std::vector<Move> MatePV(SearchContext &ctx, const Position &root, const Move &first, int moves){
+    MateSolver s(ctx);
+    std::vector<Move> pv{first};
+    Position pos = root;
+    ApplyMove(pos, first);
+    for(int n=moves-1; n>=1; n--){
+        auto replies = GenerateLegalMoves(pos.board, pos.side, pos.lastMove);
+        if(replies.empty()) break;
+        Move defence = replies[0];
+        for(auto &r : replies){
+            Position next = pos;
+            ApplyMove(next, r);
+            if(n>1 && !AttackerMates(s, next, n-1, nullptr)){ defence = r; break; }
+        }
+        pv.push_back(defence);
+        ApplyMove(pos, defence);
+        Move attack;
+        if(!AttackerMates(s, pos, n, &attack)) break;
+        pv.push_back(attack);
+        ApplyMove(pos, attack);
+    }
+    return pv;
+}
+
+MateResult SolveMate(SearchContext &ctx, const Position &pos, int maxMoves, int threads, bool countSolutions){
+    MateResult res;
+    auto rootMoves = AttackerMoves(pos, false);
+    threads = std::max(1, std::min(threads, (int)rootMoves.size()));
+    for(int n=1; n<=maxMoves && !ctx.stop && !rootMoves.empty(); n++){
+        // the workers take root moves from a shared counter; each keeps its own refutation
+        // cache, which stays valid from one N to the next
+        std::atomic<size_t> next{0};
+        std::atomic<bool> found{false};
+        std::mutex m;
+        std::vector<bool> mates(rootMoves.size(), false);
+        auto work = [&](){
+            MateSolver s(ctx);
+            size_t i;
+            while((i = next++) < rootMoves.size()){
+                if(found && !countSolutions) break;
+                if(n==1 && !rootMoves[i].second) continue;
+                Position p = pos;
+                ApplyMove(p, rootMoves[i].first);
+                if(DefenderLoses(s, p, n)){
+                    std::lock_guard<std::mutex> lk(m);
+                    mates[i] = true;
+                    found = true;
+                }
+            }
+        };
+        std::vector<std::thread> pool;
+        for(int t=1; t<threads; t++) pool.emplace_back(work);
+        work();
+        for(auto &t : pool) t.join();
+        if(ctx.stop || !found) continue;
+
+        res.moves = n;
+        for(size_t i=0; i<rootMoves.size(); i++){
+            if(!mates[i]) continue;
+            if(res.solutions==0) res.best = rootMoves[i].first;
+            res.solutions++;
+        }
+        res.pv = MatePV(ctx, pos, res.best, n);
+        break;
+    }
+    return res;
+}
+
+// ---------------- mate tool ----------------
+
+struct MateJob {
+    uint64_t id = 0;
+    std::string line;
+};
+
+static std::string SolveJob(const MateJob &job, int defaultMoves){
+    std::string head = "{\"id\":" + std::to_string(job.id);
+    Position pos;
+    std::vector<std::pair<std::string,std::string>> ops;
+    if(!ParseEPD(job.line, pos, &ops))
+        return head + ",\"error\":\"invalid position\",\"line\":\"" + JsonEscape(job.line) + "\"}";
+    int moves = defaultMoves;
+    std::string epdId;
+    for(auto &op : ops){
+        if(op.first=="dm") moves = std::max(1, std::atoi(op.second.c_str()));
+        else if(op.first=="id") epdId = op.second;
+    }
+
+    SearchContext ctx;
+    PrepareSearch(ctx, SearchLimits());
+    MateResult res = SolveMate(ctx, pos, moves, 1, true);
+
+    std::string out = head;
+    if(!epdId.empty()) out += ",\"epd_id\":\"" + JsonEscape(epdId) + "\"";
+    out += ",\"fen\":\"" + JsonEscape(ToFEN(pos)) + "\"";
+    if(res.moves==0) out += ",\"mate\":null";
+    else {
+        std::string pv;
+        Position p = pos;
+        for(auto &m : res.pv){
+            pv += (pv.empty() ? "\"" : ",\"") + MoveToUci(p.board, m) + "\"";
+            ApplyMove(p, m);
+        }
+        out += ",\"mate\":" + std::to_string(res.moves);
+        out += ",\"bestmove\":\"" + MoveToUci(pos.board, res.best) + "\"";
+        out += ",\"solutions\":" + std::to_string(res.solutions);
+        out += ",\"pv\":[" + pv + "]";
+    }
+    out += ",\"nodes\":" + std::to_string(ctx.nodes.load());
+    out += ",\"time_ms\":" + std::to_string(NowMs() - ctx.startMs) + "}";
+    return out;
+}
+
+int RunMateTool(int argc, char **argv){
+    int moves = 3;
+    int threads = (int)std::max(1u, std::thread::hardware_concurrency());
+    std::string path = "-";
+    for(int i=2; i<argc; i++){
+        std::string a = argv[i];
+        if(a=="--moves" && i+1<argc) moves = std::max(1, std::atoi(argv[++i]));
+        else if(a=="--threads" && i+1<argc) threads = std::max(1, std::atoi(argv[++i]));
+        else if(!a.empty() && a[0]=='-' && a!="-"){ std::fprintf(stderr, "mate: unknown option %s\n", a.c_str()); return 1; }
+        else path = a;
+    }
+
+    std::ifstream file;
+    std::istream *in = &std::cin;
+    if(path!="-"){
+        file.open(path);
+        if(!file){ std::fprintf(stderr, "mate: cannot open %s\n", path.c_str()); return 1; }
+        in = &file;
+    }
+
+    // positions are independent, so each worker solves whole positions single-threaded
+    BoundedQueue<MateJob> queue((size_t)threads * 4);
+    std::mutex outMutex;
+    std::vector<std::thread> workers;
+    for(int t=0; t<threads; t++){
+        workers.emplace_back([&](){
+            MateJob job;
+            while(queue.Pop(job)){
+                std::string line = SolveJob(job, moves) + "\n";
+                std::lock_guard<std::mutex> lk(outMutex);
+                std::fwrite(line.data(), 1, line.size(), stdout);
+                std::fflush(stdout);
+            }
+        });
+    }
+    std::string line;
+    uint64_t id = 0;
+    while(std::getline(*in, line)){
+        id++;
+        if(!line.empty() && line.back()=='\r') line.pop_back();
+        if(line.find_first_not_of(" \t")==std::string::npos || line[0]=='#') continue;
+        MateJob job;
+        job.id = id;
+        job.line = line;
+        queue.Push(std::move(job));
+    }
+    queue.Close();
+    for(auto &w : workers) w.join();
+    return 0;
+}
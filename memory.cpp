@@ -0,0 +1,239 @@
+#include "chess.h"
+#include <cstdio>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#ifndef _WIN32
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+// Big tables and where they live. Multi-gigabyte tables probed at random miss the TLB on almost
+// every probe with 4 KB pages, so they are allocated in huge pages when the OS allows it:
+// explicit ones (MAP_HUGETLB, or Windows large pages with the lock-memory privilege) if any are
+// reserved, else transparent ones requested with madvise, else normal pages. On NUMA machines
+// a page lands on the node of the thread that first writes it, so FirstTouch can spread that
+// work over threads bound the same way as the search threads.
+
+bool largePagesG = true;
+bool parallelInitG = false;
+ThreadBinding threadBindingG = BIND_NONE;
+
+static const size_t HUGE_PAGE = 2u << 20; // x86-64 and arm64 (4 KB granule) PMD size
+
+static size_t RoundUp(size_t n, size_t to){ return (n + to - 1) / to * to; }
+
+LargeMemory::~LargeMemory(){ FreeLarge(*this); }
+
+#ifdef _WIN32
+// large pages need SeLockMemoryPrivilege granted to the user and enabled in the process
+static bool EnableLockMemoryPrivilege(){
+    HANDLE token;
+    if(!OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &token)) return false;
+    TOKEN_PRIVILEGES tp = {};
+    tp.PrivilegeCount = 1;
+    tp.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+    bool ok = LookupPrivilegeValueA(nullptr, "SeLockMemoryPrivilege", &tp.Privileges[0].Luid) &&
+              AdjustTokenPrivileges(token, FALSE, &tp, 0, nullptr, nullptr) && GetLastError()==ERROR_SUCCESS;
+    CloseHandle(token);
+    return ok;
+}
+#endif
+
+bool AllocateLarge(LargeMemory &m, size_t size){
+    FreeLarge(m);
+    if(size==0) return false;
+#ifdef _WIN32
+    size_t large = GetLargePageMinimum();
+    if(largePagesG && large && size >= large && EnableLockMemoryPrivilege()){
+        size_t rounded = RoundUp(size, large);
+        void *p = VirtualAlloc(nullptr, rounded, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+        if(p){ m.data = p; m.size = rounded; m.pageSize = large; return true; }
+    }
+    void *p = VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+    if(!p) return false;
+    SYSTEM_INFO si;
+    GetSystemInfo(&si);
+    m.data = p;
+    m.size = size;
+    m.pageSize = si.dwPageSize;
+#else
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    bool huge = largePagesG && size >= HUGE_PAGE;
+#ifdef MAP_HUGETLB
+    if(huge){
+        size_t rounded = RoundUp(size, HUGE_PAGE);
+        void *p = mmap(nullptr, rounded, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if(p!=MAP_FAILED){ m.data = p; m.size = rounded; m.pageSize = HUGE_PAGE; return true; }
+    }
+#endif
+    // over-map by a huge page and trim, so the block starts on a huge page boundary
+    size_t align = huge ? HUGE_PAGE : page;
+    size_t rounded = RoundUp(size, align);
+    size_t span = rounded + (huge ? HUGE_PAGE : 0);
+    void *raw = mmap(nullptr, span, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if(raw==MAP_FAILED) return false;
+    char *start = (char*)RoundUp((size_t)raw, align);
+    if(start > (char*)raw) munmap(raw, start - (char*)raw);
+    if((char*)raw + span > start + rounded) munmap(start + rounded, (char*)raw + span - (start + rounded));
+#ifdef MADV_HUGEPAGE
+    if(huge) m.transparent = madvise(start, rounded, MADV_HUGEPAGE)==0;
+#endif
+    m.data = start;
+    m.size = rounded;
+    m.pageSize = page;
+#endif
+    return true;
+}
+
+void FreeLarge(LargeMemory &m){
+#ifdef _WIN32
+    if(m.data) VirtualFree(m.data, 0, MEM_RELEASE);
+#else
+    if(m.data) munmap(m.data, m.size);
+#endif
+    m.data = nullptr;
+    m.size = 0;
+    m.pageSize = 0;
+    m.transparent = false;
+}
+
+void FirstTouch(LargeMemory &m, int threads){
+    size_t unit = std::max<size_t>(m.pageSize, HUGE_PAGE);
+    size_t chunks = (m.size + unit - 1) / unit;
+    threads = (int)std::max<size_t>(1, std::min<size_t>((size_t)threads, chunks));
+    auto work = [&m, unit, chunks, threads](int t){
+        if(threads>1) BindThisThread(t);
+        // contiguous ranges, so each thread's pages stay together on its node
+        size_t from = chunks * t / threads, to = chunks * (t+1) / threads;
+        size_t begin = from * unit, end = std::min(m.size, to * unit);
+        if(begin < end) std::memset((char*)m.data + begin, 0, end - begin);
+    };
+    if(threads==1){ work(0); return; }
+    std::vector<std::thread> pool;
+    for(int t=0; t<threads; t++) pool.emplace_back(work, t);
+    for(auto &th : pool) th.join();
+}
+
+#ifndef _WIN32
+// bytes of [data, data+size) the kernel has backed with transparent huge pages so far
+static size_t TransparentHugeBytes(const LargeMemory &m){
+    std::ifstream smaps("/proc/self/smaps");
+    std::string line;
+    size_t total = 0;
+    bool inside = false;
+    uintptr_t lo = (uintptr_t)m.data, hi = lo + m.size;
+    while(std::getline(smaps, line)){
+        unsigned long long a, b;
+        if(std::sscanf(line.c_str(), "%llx-%llx ", &a, &b)==2 && line.find(':') > line.find(' ')){
+            inside = a < hi && b > lo;
+            continue;
+        }
+        unsigned long long kb;
+        if(inside && std::sscanf(line.c_str(), "AnonHugePages: %llu kB", &kb)==1) total += (size_t)kb * 1024;
+    }
+    return total;
+}
+#endif
+
+std::string DescribeLarge(const LargeMemory &m){
+    char buf[160];
+    size_t mb = m.size >> 20;
+#ifndef _WIN32
+    if(m.transparent){
+        size_t huge = TransparentHugeBytes(m);
+        std::snprintf(buf, sizeof(buf), "%zu MB, transparent %zu KB pages requested, %zu MB in them so far", mb, HUGE_PAGE >> 10, huge >> 20);
+        return buf;
+    }
+#endif
+    std::snprintf(buf, sizeof(buf), "%zu MB in %zu KB pages", mb, m.pageSize >> 10);
+    return buf;
+}
+
+// ---------------- thread binding ----------------
+
+#ifdef _WIN32
+void BindThisThread(int index){
+    if(threadBindingG==BIND_NONE || index<0) return;
+    DWORD_PTR mask = 0;
+    if(threadBindingG==BIND_NODES){
+        ULONG highest = 0;
+        ULONGLONG nodeMask = 0;
+        if(GetNumaHighestNodeNumber(&highest) && GetNumaNodeProcessorMask((UCHAR)(index % (highest+1)), &nodeMask)) mask = (DWORD_PTR)nodeMask;
+    } else {
+        SYSTEM_INFO si;
+        GetSystemInfo(&si);
+        int cpus = std::max(1, (int)std::min<DWORD>(si.dwNumberOfProcessors, 8*sizeof(DWORD_PTR)));
+        mask = (DWORD_PTR)1 << (index % cpus);
+    }
+    if(mask) SetThreadAffinityMask(GetCurrentThread(), mask);
+}
+#else
+// "0-3,8-11" -> {0,1,2,3,8,9,10,11}
+static std::vector<int> ParseCpuList(const std::string &s){
+    std::vector<int> cpus;
+    std::stringstream ss(s);
+    std::string part;
+    while(std::getline(ss, part, ',')){
+        int a, b;
+        int n = std::sscanf(part.c_str(), "%d-%d", &a, &b);
+        if(n==1) b = a;
+        if(n>=1) for(int c=a; c<=b; c++) cpus.push_back(c);
+    }
+    return cpus;
+}
+
+// The processors this process may use, and the same split by NUMA node (one node when the
+// machine has none or sysfs is missing). Read once, before any thread is bound.
+struct CpuTopology {
+    std::vector<int> cpus;
+    std::vector<std::vector<int>> nodes;
+};
+
+static const CpuTopology &Topology(){
+    static CpuTopology topo;
+    static std::once_flag once;
+    std::call_once(once, [](){
+        cpu_set_t allowed;
+        CPU_ZERO(&allowed);
+        sched_getaffinity(0, sizeof(allowed), &allowed);
+        for(int c=0; c<CPU_SETSIZE; c++) if(CPU_ISSET(c, &allowed)) topo.cpus.push_back(c);
+        for(int node=0; ; node++){
+            std::ifstream f("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+            std::string list;
+            if(!f || !std::getline(f, list)) break;
+            std::vector<int> cpus;
+            for(int c : ParseCpuList(list)) if(c<CPU_SETSIZE && CPU_ISSET(c, &allowed)) cpus.push_back(c);
+            if(!cpus.empty()) topo.nodes.push_back(cpus);
+        }
+        if(topo.nodes.empty()) topo.nodes.push_back(topo.cpus);
+    });
+    return topo;
+}
+
+void BindThisThread(int index){
+    if(threadBindingG==BIND_NONE || index<0) return;
+    const CpuTopology &topo = Topology();
+    if(topo.cpus.empty()) return;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if(threadBindingG==BIND_NODES) for(int c : topo.nodes[index % topo.nodes.size()]) CPU_SET(c, &set);
+    else CPU_SET(topo.cpus[index % topo.cpus.size()], &set);
+    pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
+#endif
+
+bool ParseMemoryOption(int argc, char **argv, int &i){
+    std::string a = argv[i];
+    bool more = i+1<argc;
+    if(a=="--large-pages" && more){ largePagesG = std::string(argv[++i])!="off"; return true; }
+    if(a=="--parallel-init"){ parallelInitG = true; return true; }
+    if(a=="--bind" && more){
+        std::string v = argv[++i];
+        threadBindingG = v=="cores" ? BIND_CORES : v=="nodes" ? BIND_NODES : BIND_NONE;
+        return true;
+    }
+    return false;
+}
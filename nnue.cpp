@@ -0,0 +1,476 @@
+#include "chess.h"
+#include <cstdio>
+#include <iostream>
+#if defined(__AVX2__) || defined(__SSSE3__) || defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
+
+// Efficiently updatable neural network evaluation (NNUE), an alternative to EvaluateBoard.
+//
+// Features are HalfKP-style: for each perspective, the own king square (64) times the piece
+// kind (own/enemy pawn..queen, plus the enemy king) times its square, 64*11*64 inputs, with
+// the board flipped for Black. The feature transformer sums the weight columns of the active
+// features into 256 int16 values per perspective (the accumulator); then
+//   [stm | other] 512 -> clipped 0..127 -> 32 -> 32 -> 1,
+// with int8 weights, int32 sums shifted right by NNUE_SHIFT, and the output divided by
+// NNUE_OUT_SCALE to give centipawns for the side to move. Most clipped accumulator values are
+// 0, so the first layer runs column-wise over the nonzero inputs only, from a copy of its
+// weights regrouped by input pair when the network is loaded.
+//
+// The search copies boards rather than making and unmaking moves, so the accumulator is kept
+// incrementally against the last board this thread evaluated: only the squares that differ
+// change features, and a perspective is recomputed from scratch when its king has moved.
+// Sibling and parent/child nodes differ in a handful of squares, which is the common case.
+//
+// File: "CNN1", then uint32 feature count, half size, L1, L2 (little-endian), then ftBias,
+// ftWeights, l1Bias, l1Weights, l2Bias, l2Weights, outBias, outWeights in that order.
+//
+//   chess nnue export -o FILE [--weights FILE]   network reproducing the classical material
+//                                                and piece-square terms (no mobility)
+//   chess nnue eval FILE [FEN]                   network and classical evaluation
+//   chess nnue bench FILE [--depth N]            search speed with and without the network
+
+const int NNUE_KINDS = 11;
+const int NNUE_FEATURES = 64 * NNUE_KINDS * 64;
+const int NNUE_HALF = 256;
+const int NNUE_L1 = 32;
+const int NNUE_L2 = 32;
+const int NNUE_SHIFT = 6;
+const int NNUE_OUT_SCALE = 16;
+static const uint32_t NNUE_MAGIC = 0x314E4E43; // "CNN1"
+
+struct NnueNet {
+    std::vector<int16_t> ftBias;     // [NNUE_HALF]
+    std::vector<int16_t> ftWeights;  // [NNUE_FEATURES][NNUE_HALF]
+    std::vector<int32_t> l1Bias;     // [NNUE_L1]
+    std::vector<int8_t> l1Weights;   // [NNUE_L1][2*NNUE_HALF]
+    std::vector<int16_t> l1Pairs;    // l1Weights by input pair, [NNUE_HALF][NNUE_L1][2], not in the file
+    std::vector<int32_t> l2Bias;     // [NNUE_L2]
+    std::vector<int8_t> l2Weights;   // [NNUE_L2][NNUE_L1]
+    int32_t outBias = 0;
+    std::vector<int8_t> outWeights;  // [NNUE_L2]
+    uint64_t id = 0;                 // tells the accumulator caches apart from an older net
+};
+
+struct NnueAccumulator {
+    alignas(32) int16_t v[2][NNUE_HALF]; // [0] White's perspective, [1] Black's
+};
+
+// ---------------- kernels ----------------
+
+static void AddColumn(int16_t *acc, const int16_t *w){
+#if defined(__AVX2__)
+    for(int i=0;i<NNUE_HALF;i+=16){
+        __m256i a = _mm256_loadu_si256((const __m256i*)(acc+i));
+        _mm256_storeu_si256((__m256i*)(acc+i), _mm256_add_epi16(a, _mm256_loadu_si256((const __m256i*)(w+i))));
+    }
+#elif defined(__SSE2__) || defined(_M_X64)
+    for(int i=0;i<NNUE_HALF;i+=8){
+        __m128i a = _mm_loadu_si128((const __m128i*)(acc+i));
+        _mm_storeu_si128((__m128i*)(acc+i), _mm_add_epi16(a, _mm_loadu_si128((const __m128i*)(w+i))));
+    }
+#else
+    for(int i=0;i<NNUE_HALF;i++) acc[i] += w[i];
+#endif
+}
+
+static void SubColumn(int16_t *acc, const int16_t *w){
+#if defined(__AVX2__)
+    for(int i=0;i<NNUE_HALF;i+=16){
+        __m256i a = _mm256_loadu_si256((const __m256i*)(acc+i));
+        _mm256_storeu_si256((__m256i*)(acc+i), _mm256_sub_epi16(a, _mm256_loadu_si256((const __m256i*)(w+i))));
+    }
+#elif defined(__SSE2__) || defined(_M_X64)
+    for(int i=0;i<NNUE_HALF;i+=8){
+        __m128i a = _mm_loadu_si128((const __m128i*)(acc+i));
+        _mm_storeu_si128((__m128i*)(acc+i), _mm_sub_epi16(a, _mm_loadu_si128((const __m128i*)(w+i))));
+    }
+#else
+    for(int i=0;i<NNUE_HALF;i++) acc[i] -= w[i];
+#endif
+}
+
+// int16 clipped to 0..127, still int16: the first layer multiplies with madd
+static void ClipHalf(const int16_t *in, int16_t *out){
+#if defined(__AVX2__)
+    const __m256i zero = _mm256_setzero_si256(), max = _mm256_set1_epi16(127);
+    for(int i=0;i<NNUE_HALF;i+=16){
+        __m256i a = _mm256_loadu_si256((const __m256i*)(in+i));
+        _mm256_storeu_si256((__m256i*)(out+i), _mm256_min_epi16(_mm256_max_epi16(a, zero), max));
+    }
+#elif defined(__SSE2__) || defined(_M_X64)
+    const __m128i zero = _mm_setzero_si128(), max = _mm_set1_epi16(127);
+    for(int i=0;i<NNUE_HALF;i+=8){
+        __m128i a = _mm_loadu_si128((const __m128i*)(in+i));
+        _mm_storeu_si128((__m128i*)(out+i), _mm_min_epi16(_mm_max_epi16(a, zero), max));
+    }
+#else
+    for(int i=0;i<NNUE_HALF;i++) out[i] = (int16_t)std::max(0, std::min(127, (int)in[i]));
+#endif
+}
+
+// out[k] = bias[k] + sum of in[i] * l1Weights[k][i], over the nonzero input pairs only: most
+// clipped inputs are 0, and each pair left adds into all NNUE_L1 sums with one madd per four
+// of them (w is the pair-major copy, [pair][k][2])
+static void Layer1(const int16_t *in, const int16_t *w, const int32_t *bias, int32_t *out){
+#if defined(__AVX2__)
+    __m256i sum[NNUE_L1/8];
+    for(int j=0;j<NNUE_L1/8;j++) sum[j] = _mm256_loadu_si256((const __m256i*)(bias+j*8));
+    for(int p=0;p<NNUE_HALF;p++){
+        int32_t pair;
+        std::memcpy(&pair, in+2*p, sizeof(pair));
+        if(!pair) continue;
+        __m256i x = _mm256_set1_epi32(pair);
+        const int16_t *col = w + p*2*NNUE_L1;
+        for(int j=0;j<NNUE_L1/8;j++)
+            sum[j] = _mm256_add_epi32(sum[j], _mm256_madd_epi16(x, _mm256_loadu_si256((const __m256i*)(col+j*16))));
+    }
+    for(int j=0;j<NNUE_L1/8;j++) _mm256_storeu_si256((__m256i*)(out+j*8), sum[j]);
+#elif defined(__SSE2__) || defined(_M_X64)
+    __m128i sum[NNUE_L1/4];
+    for(int j=0;j<NNUE_L1/4;j++) sum[j] = _mm_loadu_si128((const __m128i*)(bias+j*4));
+    for(int p=0;p<NNUE_HALF;p++){
+        int32_t pair;
+        std::memcpy(&pair, in+2*p, sizeof(pair));
+        if(!pair) continue;
+        __m128i x = _mm_set1_epi32(pair);
+        const int16_t *col = w + p*2*NNUE_L1;
+        for(int j=0;j<NNUE_L1/4;j++)
+            sum[j] = _mm_add_epi32(sum[j], _mm_madd_epi16(x, _mm_loadu_si128((const __m128i*)(col+j*8))));
+    }
+    for(int j=0;j<NNUE_L1/4;j++) _mm_storeu_si128((__m128i*)(out+j*4), sum[j]);
+#else
+    for(int k=0;k<NNUE_L1;k++) out[k] = bias[k];
+    for(int p=0;p<NNUE_HALF;p++){
+        if(!in[2*p] && !in[2*p+1]) continue;
+        const int16_t *col = w + p*2*NNUE_L1;
+        for(int k=0;k<NNUE_L1;k++) out[k] += in[2*p]*col[2*k] + in[2*p+1]*col[2*k+1];
+    }
+#endif
+}
+
+// n is a multiple of 32; u8 * i8 pairs cannot saturate int16 with inputs of at most 127
+static int32_t Dot(const uint8_t *in, const int8_t *w, int n){
+#if defined(__AVX2__)
+    const __m256i ones = _mm256_set1_epi16(1);
+    __m256i sum = _mm256_setzero_si256();
+    for(int i=0;i<n;i+=32){
+        __m256i p = _mm256_maddubs_epi16(_mm256_loadu_si256((const __m256i*)(in+i)), _mm256_loadu_si256((const __m256i*)(w+i)));
+        sum = _mm256_add_epi32(sum, _mm256_madd_epi16(p, ones));
+    }
+    __m128i s = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0x4E));
+    s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0xB1));
+    return _mm_cvtsi128_si32(s);
+#elif defined(__SSSE3__)
+    const __m128i ones = _mm_set1_epi16(1);
+    __m128i sum = _mm_setzero_si128();
+    for(int i=0;i<n;i+=16){
+        __m128i p = _mm_maddubs_epi16(_mm_loadu_si128((const __m128i*)(in+i)), _mm_loadu_si128((const __m128i*)(w+i)));
+        sum = _mm_add_epi32(sum, _mm_madd_epi16(p, ones));
+    }
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0x4E));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0xB1));
+    return _mm_cvtsi128_si32(sum);
+#elif defined(__SSE2__) || defined(_M_X64)
+    // no maddubs: widen both sides to int16 (the weights sign-extended by unpacking each byte
+    // into the high half and shifting back) and let madd do the pairs
+    const __m128i zero = _mm_setzero_si128();
+    __m128i sum = _mm_setzero_si128();
+    for(int i=0;i<n;i+=16){
+        __m128i a = _mm_loadu_si128((const __m128i*)(in+i));
+        __m128i b = _mm_loadu_si128((const __m128i*)(w+i));
+        sum = _mm_add_epi32(sum, _mm_madd_epi16(_mm_unpacklo_epi8(a, zero), _mm_srai_epi16(_mm_unpacklo_epi8(b, b), 8)));
+        sum = _mm_add_epi32(sum, _mm_madd_epi16(_mm_unpackhi_epi8(a, zero), _mm_srai_epi16(_mm_unpackhi_epi8(b, b), 8)));
+    }
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0x4E));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0xB1));
+    return _mm_cvtsi128_si32(sum);
+#else
+    int32_t s = 0;
+    for(int i=0;i<n;i++) s += (int32_t)in[i] * w[i];
+    return s;
+#endif
+}
+
+// ---------------- features and accumulator ----------------
+
+static inline int SquareOf(int x, int y){ return (7-y)*8 + x; } // a1 = 0
+
+// the feature of a piece seen from persp, whose king is on (oriented) square ksq; -1 for
+// the own king, which only selects the bucket
+static inline int FeatureIndex(int persp, int ksq, int x, int y, const Piece &p){
+    bool own = (p.color==C_WHITE) == (persp==0);
+    int kind;
+    if(p.type==PT_KING){ if(own) return -1; kind = 10; }
+    else kind = (p.type-1)*2 + (own ? 0 : 1);
+    int sq = SquareOf(x, y) ^ (persp ? 56 : 0);
+    return (ksq*NNUE_KINDS + kind)*64 + sq;
+}
+
+static void RefreshPerspective(const NnueNet &net, const Piece b[8][8], int persp, int ksq, int16_t *acc){
+    std::memcpy(acc, net.ftBias.data(), sizeof(int16_t)*NNUE_HALF);
+    for(int y=0;y<8;y++) for(int x=0;x<8;x++){
+        if(b[y][x].type==PT_NONE) continue;
+        int f = FeatureIndex(persp, ksq, x, y, b[y][x]);
+        if(f>=0) AddColumn(acc, &net.ftWeights[(size_t)f*NNUE_HALF]);
+    }
+}
+
+// last board evaluated by this thread, with its accumulator
+struct NnueCache {
+    uint64_t netId = 0;
+    Piece board[8][8];
+    int kingSq[2] = {-1, -1};
+    NnueAccumulator acc;
+};
+static thread_local NnueCache nnueCacheT;
+
+static bool UpdateAccumulator(const NnueNet &net, const Piece b[8][8], NnueCache &c){
+    // one pass finds both kings (oriented squares) and the squares that differ from the cache
+    int ksq[2] = {-1, -1}, changed[64], n = 0;
+    bool diff = c.netId==net.id;
+    for(int s=0;s<64;s++){
+        const Piece &p = b[s/8][s%8];
+        if(p.type==PT_KING){ int persp = p.color==C_WHITE ? 0 : 1; ksq[persp] = SquareOf(s%8, s/8) ^ (persp ? 56 : 0); }
+        if(diff){ const Piece &o = c.board[s/8][s%8]; if(o.type!=p.type || o.color!=p.color) changed[n++] = s; }
+    }
+    if(ksq[0]<0 || ksq[1]<0){ c.netId = 0; return false; } // no king: not a real position
+    // past a dozen squares a full refresh is about as cheap
+    bool refreshAll = c.netId!=net.id || n>12;
+    for(int persp=0; persp<2; persp++){
+        int16_t *acc = c.acc.v[persp];
+        if(refreshAll || ksq[persp]!=c.kingSq[persp]){ RefreshPerspective(net, b, persp, ksq[persp], acc); continue; }
+        for(int i=0;i<n;i++){
+            int x = changed[i]%8, y = changed[i]/8;
+            const Piece &o = c.board[y][x], &p = b[y][x];
+            if(o.type!=PT_NONE){ int f = FeatureIndex(persp, ksq[persp], x, y, o); if(f>=0) SubColumn(acc, &net.ftWeights[(size_t)f*NNUE_HALF]); }
+            if(p.type!=PT_NONE){ int f = FeatureIndex(persp, ksq[persp], x, y, p); if(f>=0) AddColumn(acc, &net.ftWeights[(size_t)f*NNUE_HALF]); }
+        }
+    }
+    CopyBoard(b, c.board);
+    c.kingSq[0] = ksq[0];
+    c.kingSq[1] = ksq[1];
+    c.netId = net.id;
+    return true;
+}
+
+int NnueEvaluate(const NnueNet &net, const Piece b[8][8], Color side){
+    NnueCache &c = nnueCacheT;
+    if(!UpdateAccumulator(net, b, c)) return 0;
+
+    alignas(32) int16_t in[2*NNUE_HALF];
+    int stm = side==C_WHITE ? 0 : 1;
+    ClipHalf(c.acc.v[stm], in);
+    ClipHalf(c.acc.v[1-stm], in + NNUE_HALF);
+
+    alignas(32) int32_t s1[NNUE_L1];
+    alignas(32) uint8_t h1[NNUE_L1], h2[NNUE_L2];
+    Layer1(in, net.l1Pairs.data(), net.l1Bias.data(), s1);
+    for(int k=0;k<NNUE_L1;k++) h1[k] = (uint8_t)std::max(0, std::min(127, s1[k] >> NNUE_SHIFT));
+    for(int k=0;k<NNUE_L2;k++){
+        int32_t s = net.l2Bias[k] + Dot(h1, &net.l2Weights[k*NNUE_L1], NNUE_L1);
+        h2[k] = (uint8_t)std::max(0, std::min(127, s >> NNUE_SHIFT));
+    }
+    return (net.outBias + Dot(h2, net.outWeights.data(), NNUE_L2)) / NNUE_OUT_SCALE;
+}
+
+// ---------------- loading ----------------
+
+static std::atomic<uint64_t> nnueIds{0};
+static std::shared_ptr<NnueNet> activeNetG;
+
+static void AllocNet(NnueNet &net){
+    net.ftBias.assign(NNUE_HALF, 0);
+    net.ftWeights.assign((size_t)NNUE_FEATURES*NNUE_HALF, 0);
+    net.l1Bias.assign(NNUE_L1, 0);
+    net.l1Weights.assign(NNUE_L1*2*NNUE_HALF, 0);
+    net.l2Bias.assign(NNUE_L2, 0);
+    net.l2Weights.assign(NNUE_L2*NNUE_L1, 0);
+    net.outWeights.assign(NNUE_L2, 0);
+    net.id = ++nnueIds;
+}
+
+template<typename T>
+static bool ReadArray(FILE *f, std::vector<T> &v){ return std::fread(v.data(), sizeof(T), v.size(), f)==v.size(); }
+template<typename T>
+static bool WriteArray(FILE *f, const std::vector<T> &v){ return std::fwrite(v.data(), sizeof(T), v.size(), f)==v.size(); }
+
+std::shared_ptr<NnueNet> LoadNnue(const std::string &path){
+    FILE *f = std::fopen(path.c_str(), "rb");
+    if(!f) return nullptr;
+    auto net = std::make_shared<NnueNet>();
+    AllocNet(*net);
+    uint32_t header[5];
+    bool ok = std::fread(header, sizeof(header), 1, f)==1 && header[0]==NNUE_MAGIC && header[1]==(uint32_t)NNUE_FEATURES
+        && header[2]==(uint32_t)NNUE_HALF && header[3]==(uint32_t)NNUE_L1 && header[4]==(uint32_t)NNUE_L2
+        && ReadArray(f, net->ftBias) && ReadArray(f, net->ftWeights)
+        && ReadArray(f, net->l1Bias) && ReadArray(f, net->l1Weights)
+        && ReadArray(f, net->l2Bias) && ReadArray(f, net->l2Weights)
+        && std::fread(&net->outBias, sizeof(net->outBias), 1, f)==1 && ReadArray(f, net->outWeights);
+    std::fclose(f);
+    if(!ok) return nullptr;
+    net->l1Pairs.resize(NNUE_L1*2*NNUE_HALF);
+    for(int i=0;i<2*NNUE_HALF;i++) for(int k=0;k<NNUE_L1;k++)
+        net->l1Pairs[(i/2*NNUE_L1 + k)*2 + i%2] = net->l1Weights[k*2*NNUE_HALF + i];
+    return net;
+}
+
+static bool SaveNnue(const std::string &path, const NnueNet &net){
+    FILE *f = std::fopen(path.c_str(), "wb");
+    if(!f) return false;
+    uint32_t header[5] = { NNUE_MAGIC, (uint32_t)NNUE_FEATURES, (uint32_t)NNUE_HALF, (uint32_t)NNUE_L1, (uint32_t)NNUE_L2 };
+    bool ok = std::fwrite(header, sizeof(header), 1, f)==1
+        && WriteArray(f, net.ftBias) && WriteArray(f, net.ftWeights)
+        && WriteArray(f, net.l1Bias) && WriteArray(f, net.l1Weights)
+        && WriteArray(f, net.l2Bias) && WriteArray(f, net.l2Weights)
+        && std::fwrite(&net.outBias, sizeof(net.outBias), 1, f)==1 && WriteArray(f, net.outWeights);
+    return std::fclose(f)==0 && ok;
+}
+
+// must be called between searches, like SetTablebasePath; an empty path goes back to the
+// classical evaluation
+bool SetNnue(const std::string &path){
+    if(path.empty()){ activeNetG.reset(); return true; }
+    auto net = LoadNnue(path);
+    if(!net) return false;
+    activeNetG = net;
+    return true;
+}
+
+const NnueNet *ActiveNnue(){ return activeNetG.get(); }
+
+// ---------------- export from the classical weights ----------------
+
+// A network of this shape that computes the material and piece-square part of EvaluateBoard.
+// Each perspective holds the evaluation T from its own side in a thermometer code (neuron j
+// holds clamp(T + R - 127j, 0, 127), so the 128 neurons sum to T + R), and the first layer
+// takes half of T_stm - T_other. Both hidden layers repeat the thermometer code and the output
+// sums it back. Exact for evaluations within +-NNUE_EXPORT_RANGE centipawns.
+static const int NNUE_THERMO = 128;
+static const int NNUE_FT_RANGE = 8128;       // 64 * 127, centres the feature transformer code
+static const int NNUE_EXPORT_RANGE = 2032;   // 16 * 127, centres the hidden layer code
+
+static void ExportClassical(const EvalWeights &w, NnueNet &net){
+    AllocNet(net);
+    for(int j=0;j<NNUE_THERMO;j++) net.ftBias[j] = (int16_t)(NNUE_FT_RANGE - 127*j);
+    for(int ksq=0; ksq<64; ksq++){
+        for(int kind=0; kind<NNUE_KINDS; kind++){
+            for(int sq=0; sq<64; sq++){
+                int r = sq/8, x = sq%8, v;
+                // squares are oriented so that the own side moves up: own pieces read their table
+                // from White's side, enemy pieces from Black's
+                if(kind==10) v = -w.pst[PT_KING][r][x];
+                else {
+                    PieceType t = (PieceType)(kind/2 + 1);
+                    bool own = kind%2==0;
+                    v = own ? w.piece[t] + w.pst[t][7-r][x] : -(w.piece[t] + w.pst[t][r][x]);
+                }
+                int16_t *col = &net.ftWeights[((size_t)(ksq*NNUE_KINDS + kind)*64 + sq)*NNUE_HALF];
+                for(int j=0;j<NNUE_THERMO;j++) col[j] = (int16_t)v;
+            }
+        }
+    }
+    // the own king's table value is not a feature; it is added to every enemy king feature of
+    // the bucket instead (both kings are always present)
+    for(int ksq=0; ksq<64; ksq++){
+        int own = w.pst[PT_KING][7 - ksq/8][ksq%8];
+        for(int sq=0; sq<64; sq++){
+            int16_t *col = &net.ftWeights[((size_t)(ksq*NNUE_KINDS + 10)*64 + sq)*NNUE_HALF];
+            for(int j=0;j<NNUE_THERMO;j++) col[j] = (int16_t)(col[j] + own);
+        }
+    }
+    // 32 * (T_stm - T_other) = 64 * eval, so the shift leaves eval
+    for(int k=0;k<NNUE_L1;k++){
+        for(int j=0;j<NNUE_THERMO;j++){
+            net.l1Weights[k*2*NNUE_HALF + j] = 32;
+            net.l1Weights[k*2*NNUE_HALF + NNUE_HALF + j] = -32;
+        }
+        net.l1Bias[k] = 64 * (NNUE_EXPORT_RANGE - 127*k);
+    }
+    for(int k=0;k<NNUE_L2;k++){
+        for(int j=0;j<NNUE_L1;j++) net.l2Weights[k*NNUE_L1 + j] = 64;
+        net.l2Bias[k] = -64 * 127 * k;
+    }
+    for(int j=0;j<NNUE_L2;j++) net.outWeights[j] = NNUE_OUT_SCALE;
+    net.outBias = -NNUE_OUT_SCALE * NNUE_EXPORT_RANGE;
+}
+
+// ---------------- tool ----------------
+
+int RunNnueTool(int argc, char **argv){
+    std::string sub = argc>2 ? argv[2] : "";
+    if(sub=="export"){
+        std::string output, weightsPath;
+        for(int i=3; i<argc; i++){
+            std::string a = argv[i];
+            if(a=="-o" && i+1<argc) output = argv[++i];
+            else if(a=="--weights" && i+1<argc) weightsPath = argv[++i];
+            else { std::fprintf(stderr, "nnue: unknown option %s\n", a.c_str()); return 1; }
+        }
+        if(output.empty()){ std::fprintf(stderr, "nnue: -o FILE is required\n"); return 1; }
+        EvalWeights w = evalWeightsG;
+        if(!weightsPath.empty() && !LoadEvalWeights(weightsPath, w)){ std::fprintf(stderr, "nnue: cannot load %s\n", weightsPath.c_str()); return 1; }
+        NnueNet net;
+        ExportClassical(w, net);
+        if(!SaveNnue(output, net)){ std::fprintf(stderr, "nnue: cannot write %s\n", output.c_str()); return 1; }
+        return 0;
+    }
+    if(sub!="eval" && sub!="bench"){
+        std::fprintf(stderr, "usage: chess nnue export -o FILE [--weights FILE] | eval FILE [FEN] | bench FILE [--depth N]\n");
+        return 1;
+    }
+    if(argc<4){ std::fprintf(stderr, "nnue: network file required\n"); return 1; }
+    auto net = LoadNnue(argv[3]);
+    if(!net){ std::fprintf(stderr, "nnue: cannot load %s\n", argv[3]); return 1; }
+
+    if(sub=="eval"){
+        Position pos;
+        std::string fen;
+        for(int i=4; i<argc; i++) fen += (fen.empty() ? "" : " ") + std::string(argv[i]);
+        if(fen.empty()) SetStartPosition(pos);
+        else if(!ParseFEN(fen, pos)){ std::fprintf(stderr, "nnue: invalid FEN\n"); return 1; }
+        int classical = EvaluateBoard(pos.board);
+        if(pos.side==C_BLACK) classical = -classical;
+        std::printf("nnue %d classical %d (side to move)\n", NnueEvaluate(*net, pos.board, pos.side), classical);
+        return 0;
+    }
+
+    int depth = 6;
+    for(int i=4; i<argc; i++){
+        std::string a = argv[i];
+        if(a=="--depth" && i+1<argc) depth = std::max(1, std::atoi(argv[++i]));
+        else { std::fprintf(stderr, "nnue: unknown option %s\n", a.c_str()); return 1; }
+    }
+    static const char *BENCH_FENS[] = {
+        "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+        "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+        "r1bq1rk1/pp2bppp/2n1pn2/3p4/2PP4/2N1PN2/PP3PPP/R2QKB1R w KQ - 0 8",
+        "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+    };
+    // one thread, one table, the same positions: only the evaluation differs
+    for(int pass=0; pass<2; pass++){
+        TranspositionTable table;
+        ResizeTT(table, 16);
+        SearchContext ctx;
+        ctx.tt = &table;
+        ctx.parallelRoot = false;
+        ctx.net = pass ? net.get() : nullptr;
+        uint64_t nodes = 0;
+        int64_t t0 = NowMs();
+        for(auto *fen : BENCH_FENS){
+            Position pos;
+            ParseFEN(fen, pos);
+            SearchLimits limits;
+            limits.depth = depth;
+            ClearTT(table);
+            PrepareSearch(ctx, limits);
+            Think(ctx, pos);
+            nodes += ctx.nodes;
+        }
+        int64_t ms = std::max<int64_t>(1, NowMs()-t0);
+        std::printf("%-9s %llu nodes %lld ms %llu nps\n", pass ? "nnue" : "classical",
+                    (unsigned long long)nodes, (long long)ms, (unsigned long long)(nodes*1000/ms));
+    }
+    return 0;
+}
@@ -0,0 +1,257 @@
+#include "chess.h"
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+// Packed positions: datasets as fixed 32-byte records instead of FEN/EPD text. A file is an
+// 8-byte header (magic, record size) followed by the records in host byte order, so a reader
+// maps it and indexes the records in place: nothing is parsed and nothing is copied until a
+// position is unpacked, which is a walk over its occupied squares.
+//
+//   chess pack [-o FILE] [--pgn] [--skip-plies N] [file|-]
+//
+// converts EPD/FEN lines (c9 gives the result, ce the score, bm the best move) or, with --pgn,
+// every position of every game with the game's result and the move played from it.
+//
+//   chess unpack FILE [--from N] [--count N]
+//
+// prints records back as EPD lines in the same opcodes.
+
+static const uint32_t PACKED_MAGIC = 0x314B5043; // "CPK1"
+static const int RESULT_SHIFT = 5;
+
+// the pawn that just stepped two squares, when there is one: the one ToFEN gives a target for
+static int EnPassantSquare(const Position &pos){
+    const Move &lm = pos.lastMove;
+    if(lm.fx==-1 || std::abs(lm.ty-lm.fy)!=2 || pos.board[lm.ty][lm.tx].type!=PT_PAWN) return -1;
+    return lm.ty*8 + lm.tx;
+}
+
+bool PackPosition(const Position &pos, PackedPosition &r){
+    r = PackedPosition();
+    int ep = EnPassantSquare(pos), n = 0;
+    for(int sq=0; sq<64; sq++){
+        const Piece &p = pos.board[sq/8][sq%8];
+        if(p.type==PT_NONE) continue;
+        if(n==32) return false;
+        int code = (sq==ep ? PACKED_EP_PAWN : p.type) | (p.color==C_BLACK)<<3;
+        r.occupied |= 1ULL << sq;
+        r.pieces[n/2] |= (uint8_t)(code << (n%2*4));
+        n++;
+    }
+    auto canCastle = [&](int ry, int rx){
+        const Piece &k = pos.board[ry][4], &rk = pos.board[ry][rx];
+        return k.type==PT_KING && !k.moved && rk.type==PT_ROOK && rk.color==k.color && !rk.moved;
+    };
+    r.flags = (pos.side==C_BLACK ? PF_BLACK_TO_MOVE : 0) |
+              (canCastle(7,7) ? PF_WHITE_OO : 0) | (canCastle(7,0) ? PF_WHITE_OOO : 0) |
+              (canCastle(0,7) ? PF_BLACK_OO : 0) | (canCastle(0,0) ? PF_BLACK_OOO : 0);
+    r.halfmoveClock = (uint8_t)std::min(std::max(pos.halfmoveClock, 0), 255);
+    r.fullmoveNumber = (uint16_t)std::min(std::max(pos.fullmoveNumber, 1), 0xFFFF);
+    return true;
+}
+
+// the same position ParseFEN gives for the record's FEN; false for a record PackPosition never
+// writes (more than 32 pieces, an empty piece code, an en-passant pawn that is not the last
+// mover's or not on its fourth rank, other than one king a side), which leaves pos unusable
+bool UnpackPosition(const PackedPosition &r, Position &pos){
+    pos = Position();
+    Color mover = r.flags & PF_BLACK_TO_MOVE ? C_WHITE : C_BLACK;
+    int n = 0, kings[3] = {0, 0, 0}, eps = 0;
+    for(uint64_t m = r.occupied; m; m &= m-1, n++){
+        if(n==32) return false;
+        int sq = LowestBit(m), x = sq%8, y = sq/8;
+        int code = r.pieces[n/2] >> (n%2*4) & 15;
+        if((code & 7)==0) return false;
+        Piece &p = pos.board[y][x];
+        p.color = code & 8 ? C_BLACK : C_WHITE;
+        p.type = (code & 7)==PACKED_EP_PAWN ? PT_PAWN : (PieceType)(code & 7);
+        if(p.type==PT_PAWN) p.moved = y != (p.color==C_WHITE ? 6 : 1);
+        else p.moved = p.type==PT_KING || p.type==PT_ROOK;
+        if(p.type==PT_KING) kings[p.color]++;
+        if((code & 7)==PACKED_EP_PAWN){
+            if(p.color!=mover || y!=(p.color==C_WHITE ? 4 : 3) || ++eps > 1) return false;
+            pos.lastMove = p.color==C_WHITE ? Move(x,y+2,x,y) : Move(x,y-2,x,y);
+        }
+    }
+    if(kings[C_WHITE]!=1 || kings[C_BLACK]!=1) return false;
+    auto rights = [&](int ry, int rx, int flag){
+        if(!(r.flags & flag)) return;
+        pos.board[ry][4].moved = false;
+        pos.board[ry][rx].moved = false;
+    };
+    rights(7, 7, PF_WHITE_OO);
+    rights(7, 0, PF_WHITE_OOO);
+    rights(0, 7, PF_BLACK_OO);
+    rights(0, 0, PF_BLACK_OOO);
+    pos.side = r.flags & PF_BLACK_TO_MOVE ? C_BLACK : C_WHITE;
+    pos.halfmoveClock = r.halfmoveClock;
+    pos.fullmoveNumber = r.fullmoveNumber;
+    return true;
+}
+
+PackedResult GetPackedResult(const PackedPosition &r){ return (PackedResult)(r.flags >> RESULT_SHIFT & 3); }
+
+void SetPackedResult(PackedPosition &r, PackedResult result){
+    r.flags = (uint8_t)((r.flags & ~(3 << RESULT_SHIFT)) | result << RESULT_SHIFT);
+}
+
+PackedResult ParseResultToken(const std::string &s){
+    if(s=="1-0") return PR_WHITE_WINS;
+    if(s=="0-1") return PR_BLACK_WINS;
+    if(s=="1/2-1/2") return PR_DRAW;
+    return PR_UNKNOWN;
+}
+
+static const char *ResultToken(PackedResult r){
+    return r==PR_WHITE_WINS ? "1-0" : r==PR_BLACK_WINS ? "0-1" : "1/2-1/2";
+}
+
+// ---------------- files ----------------
+
+bool OpenPackedFile(PackedFile &f, const std::string &path){
+    f.records = nullptr;
+    f.count = 0;
+    if(!MapFile(f.map, path)) return false;
+    uint32_t header[2];
+    if(f.map.size < sizeof(header)){ UnmapFile(f.map); return false; }
+    std::memcpy(header, f.map.data, sizeof(header));
+    if(header[0]!=PACKED_MAGIC || header[1]!=sizeof(PackedPosition)){ UnmapFile(f.map); return false; }
+    f.records = (const PackedPosition*)(f.map.data + sizeof(header));
+    f.count = (f.map.size - sizeof(header)) / sizeof(PackedPosition); // a torn last record is ignored
+    return true;
+}
+
+PackedWriter::~PackedWriter(){ ClosePackedFile(*this); }
+
+bool CreatePackedFile(PackedWriter &w, const std::string &path){
+    ClosePackedFile(w);
+    w.count = 0;
+    w.failed = false;
+    w.file = std::fopen(path.c_str(), "wb");
+    if(!w.file) return false;
+    std::setvbuf(w.file, nullptr, _IOFBF, 1 << 20);
+    uint32_t header[2] = { PACKED_MAGIC, (uint32_t)sizeof(PackedPosition) };
+    w.failed = std::fwrite(header, sizeof(header), 1, w.file)!=1;
+    return !w.failed;
+}
+
+bool WritePacked(PackedWriter &w, const PackedPosition &r){
+    if(!w.file || w.failed) return false;
+    w.failed = std::fwrite(&r, sizeof(r), 1, w.file)!=1;
+    if(!w.failed) w.count++;
+    return !w.failed;
+}
+
+bool ClosePackedFile(PackedWriter &w){
+    if(!w.file) return !w.failed;
+    if(std::fclose(w.file)!=0) w.failed = true;
+    w.file = nullptr;
+    return !w.failed;
+}
+
+// ---------------- pack / unpack tools ----------------
+
+// an EPD line with its c9, ce and bm operations
+static bool PackEpdLine(const std::string &line, PackedPosition &r){
+    Position pos;
+    std::vector<std::pair<std::string,std::string>> ops;
+    if(!ParseEPD(line, pos, &ops) || !PackPosition(pos, r)) return false;
+    for(auto &op : ops){
+        if(op.first=="c9") SetPackedResult(r, ParseResultToken(op.second));
+        else if(op.first=="ce") r.score = (int16_t)std::min(std::max(std::atoi(op.second.c_str()), -32767), 32767);
+        else if(op.first=="bm"){
+            Move m;
+            std::string san = op.second.substr(0, op.second.find(' '));
+            if(ParseSAN(pos, san, m)) r.move = PolyglotMove(pos.board, m);
+        }
+    }
+    return true;
+}
+
+int RunPack(int argc, char **argv){
+    std::string output = "positions.bin", path = "-";
+    bool pgn = false;
+    int skipPlies = 0;
+    for(int i=2; i<argc; i++){
+        std::string a = argv[i];
+        if(a=="-o" && i+1<argc) output = argv[++i];
+        else if(a=="--pgn") pgn = true;
+        else if(a=="--skip-plies" && i+1<argc) skipPlies = std::max(0, std::atoi(argv[++i]));
+        else if(!a.empty() && a[0]=='-' && a!="-"){ std::fprintf(stderr, "pack: unknown option %s\n", a.c_str()); return 1; }
+        else path = a;
+    }
+    std::ifstream file;
+    std::istream *in = &std::cin;
+    if(path!="-"){
+        file.open(path, std::ios::binary);
+        if(!file){ std::fprintf(stderr, "pack: cannot open %s\n", path.c_str()); return 1; }
+        in = &file;
+    }
+    PackedWriter out;
+    if(!CreatePackedFile(out, output)){ std::fprintf(stderr, "pack: cannot write %s\n", output.c_str()); return 1; }
+
+    int64_t t0 = NowMs();
+    uint64_t skipped = 0;
+    PackedPosition r;
+    if(pgn){
+        PgnGame game;
+        while(ReadPgnGame(*in, game)){
+            Position pos;
+            std::vector<Move> moves;
+            if(!ReplayPgnGame(game, pos, moves)){ skipped++; continue; }
+            PackedResult result = ParseResultToken(game.result);
+            for(size_t i=0; i<moves.size(); i++){
+                if((int)i>=skipPlies && PackPosition(pos, r)){
+                    SetPackedResult(r, result);
+                    r.move = PolyglotMove(pos.board, moves[i]);
+                    WritePacked(out, r);
+                }
+                ApplyMove(pos, moves[i]);
+            }
+        }
+    } else {
+        std::string line;
+        while(std::getline(*in, line)){
+            if(!line.empty() && line.back()=='\r') line.pop_back();
+            if(line.find_first_not_of(" \t")==std::string::npos || line[0]=='#') continue;
+            if(PackEpdLine(line, r)) WritePacked(out, r);
+            else skipped++;
+        }
+    }
+    uint64_t count = out.count;
+    if(!ClosePackedFile(out)){ std::fprintf(stderr, "pack: error writing %s\n", output.c_str()); return 1; }
+    std::fprintf(stderr, "pack: %llu positions (%llu skipped) to %s, %llu bytes, %lld ms\n",
+                 (unsigned long long)count, (unsigned long long)skipped, output.c_str(),
+                 (unsigned long long)(8 + count*sizeof(PackedPosition)), (long long)(NowMs()-t0));
+    return 0;
+}
+
+int RunUnpack(int argc, char **argv){
+    std::string path;
+    uint64_t from = 0, count = UINT64_MAX;
+    for(int i=2; i<argc; i++){
+        std::string a = argv[i];
+        if(a=="--from" && i+1<argc) from = std::strtoull(argv[++i], nullptr, 10);
+        else if(a=="--count" && i+1<argc) count = std::strtoull(argv[++i], nullptr, 10);
+        else if(!a.empty() && a[0]=='-'){ std::fprintf(stderr, "unpack: unknown option %s\n", a.c_str()); return 1; }
+        else path = a;
+    }
+    PackedFile f;
+    if(path.empty() || !OpenPackedFile(f, path)){ std::fprintf(stderr, "unpack: %s is not a packed position file\n", path.c_str()); return 1; }
+    uint64_t skipped = 0;
+    for(uint64_t i=from; i<f.count && i-from<count; i++){
+        const PackedPosition &r = f.records[i];
+        Position pos;
+        if(!UnpackPosition(r, pos)){ skipped++; continue; }
+        std::string line = ToFEN(pos);
+        Move m;
+        if(r.move && DecodePolyglotMove(pos, r.move, m)) line += " bm " + MoveToSAN(pos, m) + ";";
+        if(r.score!=PACKED_NO_SCORE) line += " ce " + std::to_string(r.score) + ";";
+        if(GetPackedResult(r)!=PR_UNKNOWN) line += std::string(" c9 \"") + ResultToken(GetPackedResult(r)) + "\";";
+        line += "\n";
+        std::fwrite(line.data(), 1, line.size(), stdout);
+    }
+    if(skipped) std::fprintf(stderr, "unpack: skipped %llu invalid records\n", (unsigned long long)skipped);
+    return 0;
+}
@@ -0,0 +1,150 @@
+#include "chess.h"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+// Perft: counts the leaves of the legal move tree to a fixed depth, the standard check of a
+// move generator (and a benchmark for it). A promotion counts once per piece it can become,
+// so totals compare with published tables.
+//
+//   chess perft [--depth N] [--divide] [--verify] [file|-]
+//
+// reads EPD/FEN lines and writes one JSON object per position. Perft-suite opcodes
+// "D<n> <count>" give expected totals; without --depth the deepest one listed is run (else 4).
+// --divide adds the count below each root move; --verify compares the generator with the
+// make-and-test reference at every node.
+
+static const PieceType PROMOTIONS[4] = { PT_QUEEN, PT_ROOK, PT_BISHOP, PT_KNIGHT };
+
+struct PerftState {
+    bool verify = false;
+    uint64_t mismatches = 0;
+};
+
+static bool IsPromotion(const Piece b[8][8], const Move &m){
+    return b[m.fy][m.fx].type==PT_PAWN && (m.ty==0 || m.ty==7);
+}
+
+static bool SameMoveSet(std::vector<Move> a, std::vector<Move> b){
+    auto key = [](const Move &m){ return ((m.fy*8+m.fx)*64 + m.ty*8+m.tx)*4 + m.isEnPassant*2 + m.isCastle; };
+    auto less = [&](const Move &x, const Move &y){ return key(x) < key(y); };
+    std::sort(a.begin(), a.end(), less);
+    std::sort(b.begin(), b.end(), less);
+    return a.size()==b.size() && std::equal(a.begin(), a.end(), b.begin(), [&](const Move &x, const Move &y){ return key(x)==key(y); });
+}
+
+template<Color Us>
+static uint64_t Perft(PerftState &st, const Piece b[8][8], const Move &lastMove, int depth){
+    if(depth==0) return 1;
+    auto moves = GenerateLegalMoves<Us>(b, lastMove);
+    if(st.verify && !SameMoveSet(moves, GenerateLegalMovesReference(b, Us, lastMove)) && st.mismatches++ < 3){
+        Position pos;
+        CopyBoard(b, pos.board);
+        pos.side = Us;
+        pos.lastMove = lastMove;
+        std::fprintf(stderr, "perft: generator differs from reference at %s\n", ToFEN(pos).c_str());
+    }
+    uint64_t n = 0;
+    for(auto m : moves){
+        int variants = IsPromotion(b, m) ? 4 : 1;
+        if(depth==1){ n += variants; continue; }
+        for(int v=0; v<variants; v++){
+            if(variants>1) m.promoteTo = PROMOTIONS[v];
+            Piece nb[8][8];
+            CopyBoard(b, nb);
+            MakeMoveOnCopy(nb, m);
+            n += Perft<SideTraits<Us>::Them>(st, nb, m, depth-1);
+        }
+    }
+    return n;
+}
+
+static uint64_t PerftFrom(PerftState &st, const Piece b[8][8], Color side, const Move &lastMove, int depth){
+    return side==C_WHITE ? Perft<C_WHITE>(st, b, lastMove, depth) : Perft<C_BLACK>(st, b, lastMove, depth);
+}
+
+int RunPerft(int argc, char **argv){
+    int depth = 0;
+    bool divide = false;
+    PerftState st;
+    std::string path = "-";
+    for(int i=2; i<argc; i++){
+        std::string a = argv[i];
+        if(a=="--depth" && i+1<argc) depth = std::max(0, std::atoi(argv[++i]));
+        else if(a=="--divide") divide = true;
+        else if(a=="--verify") st.verify = true;
+        else if(!a.empty() && a[0]=='-' && a!="-"){ std::fprintf(stderr, "perft: unknown option %s\n", a.c_str()); return 1; }
+        else path = a;
+    }
+
+    std::ifstream file;
+    std::istream *in = &std::cin;
+    if(path!="-"){
+        file.open(path);
+        if(!file){ std::fprintf(stderr, "perft: cannot open %s\n", path.c_str()); return 1; }
+        in = &file;
+    }
+
+    std::string line;
+    uint64_t id = 0, totalNodes = 0;
+    int failures = 0;
+    int64_t totalMs = 0;
+    while(std::getline(*in, line)){
+        id++;
+        if(!line.empty() && line.back()=='\r') line.pop_back();
+        if(line.find_first_not_of(" \t")==std::string::npos || line[0]=='#') continue;
+        Position pos;
+        std::vector<std::pair<std::string,std::string>> ops;
+        if(!ParseEPD(line, pos, &ops)){
+            std::printf("{\"id\":%llu,\"error\":\"bad position\"}\n", (unsigned long long)id);
+            failures++;
+            continue;
+        }
+        int d = depth;
+        std::string expected;
+        for(auto &op : ops){
+            if(op.first.size()<2 || op.first[0]!='D') continue;
+            int n = std::atoi(op.first.c_str()+1);
+            if(depth ? n==depth : n>d){ d = n; expected = op.second; }
+        }
+        if(!d) d = 4;
+
+        int64_t t0 = NowMs();
+        uint64_t nodes = 0;
+        std::string div;
+        if(divide && d>0){
+            for(auto &m : GenerateLegalMoves(pos.board, pos.side, pos.lastMove)){
+                int variants = IsPromotion(pos.board, m) ? 4 : 1;
+                for(int v=0; v<variants; v++){
+                    Move mv = m;
+                    if(variants>1) mv.promoteTo = PROMOTIONS[v];
+                    Piece nb[8][8];
+                    CopyBoard(pos.board, nb);
+                    MakeMoveOnCopy(nb, mv);
+                    uint64_t n = PerftFrom(st, nb, Opp(pos.side), mv, d-1);
+                    nodes += n;
+                    div += std::string(div.empty() ? "" : ",") + "\"" + MoveToUci(pos.board, mv) + "\":" + std::to_string(n);
+                }
+            }
+        }
+        else nodes = PerftFrom(st, pos.board, pos.side, pos.lastMove, d);
+        int64_t ms = NowMs() - t0;
+        totalNodes += nodes;
+        totalMs += ms;
+
+        bool ok = expected.empty() || std::strtoull(expected.c_str(), nullptr, 10)==nodes;
+        if(!ok) failures++;
+        std::string out = "{\"id\":" + std::to_string(id) + ",\"fen\":\"" + ToFEN(pos) + "\"";
+        out += ",\"depth\":" + std::to_string(d) + ",\"nodes\":" + std::to_string(nodes);
+        if(!expected.empty()) out += ",\"expected\":" + expected + ",\"ok\":" + (ok ? "true" : "false");
+        if(divide) out += ",\"divide\":{" + div + "}";
+        out += ",\"time_ms\":" + std::to_string(ms) + "}\n";
+        std::fwrite(out.data(), 1, out.size(), stdout);
+        std::fflush(stdout);
+    }
+    std::fprintf(stderr, "perft: %llu nodes in %lld ms (%.0f nodes/s)\n", (unsigned long long)totalNodes,
+                 (long long)totalMs, totalNodes * 1000.0 / std::max<int64_t>(1, totalMs));
+    if(st.mismatches) std::fprintf(stderr, "perft: %llu generator mismatches\n", (unsigned long long)st.mismatches);
+    return failures || st.mismatches ? 1 : 0;
+}
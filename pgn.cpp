@@ -0,0 +1,279 @@
+#include "chess.h"
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <map>
+
+// Streaming PGN reader and the "annotate" tool built on it.
+// ReadPgnGame pulls one game at a time straight from the stream buffer, so memory depends on
+// the longest game, not on the size of the database.
+
+static bool IsResultToken(const std::string &t){
+    return t=="1-0" || t=="0-1" || t=="1/2-1/2" || t=="*";
+}
+
+// skip a {comment}, honouring nothing inside it
+static void SkipBrace(std::streambuf *sb){
+    int c;
+    while((c = sb->sbumpc()) != EOF && c!='}') {}
+}
+
+static void SkipLine(std::streambuf *sb){
+    int c;
+    while((c = sb->sbumpc()) != EOF && c!='\n') {}
+}
+
+// skip a (variation), which may nest and contain comments
+static void SkipVariation(std::streambuf *sb){
+    int depth = 1, c;
+    while(depth>0 && (c = sb->sbumpc()) != EOF){
+        if(c=='(') depth++;
+        else if(c==')') depth--;
+        else if(c=='{') SkipBrace(sb);
+        else if(c==';') SkipLine(sb);
+    }
+}
+
+// [Name "value"]
+static void ReadTag(std::streambuf *sb, PgnGame &game){
+    std::string name, value;
+    int c;
+    while((c = sb->sbumpc()) != EOF && isspace(c)) {}
+    while(c!=EOF && !isspace(c) && c!='"' && c!=']'){ name += (char)c; c = sb->sbumpc(); }
+    while(c!=EOF && c!='"' && c!=']') c = sb->sbumpc();
+    if(c=='"'){
+        while((c = sb->sbumpc()) != EOF && c!='"'){
+            if(c=='\\'){ c = sb->sbumpc(); if(c==EOF) break; }
+            value += (char)c;
+        }
+        while(c!=EOF && c!=']') c = sb->sbumpc();
+    }
+    if(!name.empty()) game.tags.push_back({name, value});
+}
+
+bool ReadPgnGame(std::istream &in, PgnGame &game){
+    game.tags.clear();
+    game.sans.clear();
+    game.result.clear();
+    std::streambuf *sb = in.rdbuf();
+    bool any = false, inMoves = false, lineStart = true;
+    int c;
+    while((c = sb->sbumpc()) != EOF){
+        bool atLineStart = lineStart;
+        lineStart = (c=='\n');
+        if(isspace(c)) continue;
+        if(c=='%' && atLineStart){ SkipLine(sb); lineStart = true; continue; }
+        if(c=='['){
+            if(inMoves){ sb->sungetc(); break; } // next game's tags; this one had no result token
+            ReadTag(sb, game);
+            any = true;
+            continue;
+        }
+        if(c=='{'){ SkipBrace(sb); continue; }
+        if(c==';'){ SkipLine(sb); lineStart = true; continue; }
+        if(c=='('){ SkipVariation(sb); continue; }
+        if(c==')') continue;
+
+        std::string tok(1, (char)c);
+        while((c = sb->sgetc()) != EOF && !isspace(c) && !std::strchr("{}();[", c)) tok += (char)sb->sbumpc();
+        if(IsResultToken(tok)){ game.result = tok; return true; }
+        if(tok[0]=='$') continue; // NAG
+        size_t k = 0;
+        while(k<tok.size() && isdigit((unsigned char)tok[k])) k++;
+        if(k>0 && k<=tok.size() && (k==tok.size() || tok[k]=='.')){
+            while(k<tok.size() && tok[k]=='.') k++;
+            tok = tok.substr(k);
+        }
+        if(tok.empty()) continue;
+        game.sans.push_back(tok);
+        inMoves = any = true;
+    }
+    if(game.result.empty()) game.result = PgnTag(game, "Result");
+    if(game.result.empty()) game.result = "*";
+    return any;
+}
+
+std::string PgnTag(const PgnGame &game, const std::string &name){
+    for(auto &t : game.tags) if(t.first==name) return t.second;
+    return "";
+}
+
+// Decode the SAN moves from the game's start position (FEN tag or the standard start).
+// Stops at the first move that does not decode and returns false in that case.
+bool ReplayPgnGame(const PgnGame &game, Position &start, std::vector<Move> &moves){
+    moves.clear();
+    std::string fen = PgnTag(game, "FEN");
+    if(fen.empty()) SetStartPosition(start);
+    else if(!ParseFEN(fen, start)) return false;
+    Position pos = start;
+    for(auto &san : game.sans){
+        Move m;
+        if(!ParseSAN(pos, san, m)) return false;
+        moves.push_back(m);
+        ApplyMove(pos, m);
+    }
+    return true;
+}
+
+// ---------------- annotate ----------------
+
+//   chess annotate [--depth N] [--threads N] [--hash MB] [--blunder CP] [--mistake CP] [file|-]
+//
+// Searches every position of every game at a fixed depth and writes the games back as PGN
+// with the evaluation after each move and ?/?? on moves that lose more than the thresholds.
+// Games are spread over worker threads and written in input order.
+
+struct AnnotateJob {
+    uint64_t index = 0;
+    PgnGame game;
+};
+
+struct AnnotateOptions {
+    int depth = 6;
+    int blunder = 300;
+    int mistake = 100;
+};
+
+static std::string FormatEval(int whiteScore){
+    if(IsMateScore(whiteScore)){
+        int n = MateInMoves(whiteScore);
+        return n==0 ? "#" : "#" + std::to_string(n); // "#-2": Black mates in 2
+    }
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "%+.2f", whiteScore/100.0);
+    return buf;
+}
+
+// score of 'pos' from the side to move's point of view, plus the best move
+static int ScorePosition(SearchContext &ctx, const Position &pos, int depth, Move &best){
+    best = Move();
+    if(GenerateLegalMoves(pos.board, pos.side, pos.lastMove).empty()){
+        int kx, ky;
+        bool mated = FindKing(pos.board, pos.side, kx, ky) && IsSquareAttacked(pos.board, kx, ky, Opp(pos.side));
+        return mated ? -MATE_SCORE : 0;
+    }
+    SearchLimits limits;
+    limits.depth = depth;
+    PrepareSearch(ctx, limits);
+    SearchResult res = Think(ctx, pos);
+    best = res.best;
+    return res.score;
+}
+
+static std::string AnnotateGame(SearchContext &ctx, const PgnGame &game, const AnnotateOptions &opt){
+    std::string out;
+    for(auto &t : game.tags) out += "[" + t.first + " \"" + t.second + "\"]\n";
+    out += "[Annotator \"chess annotate depth " + std::to_string(opt.depth) + "\"]\n\n";
+
+    Position start;
+    std::vector<Move> moves;
+    bool complete = ReplayPgnGame(game, start, moves);
+
+    // score every position once; scores[i] is for the position before moves[i]
+    std::vector<int> scores(moves.size()+1);
+    std::vector<Move> bests(moves.size()+1);
+    Position pos = start;
+    for(size_t i=0; i<=moves.size(); i++){
+        scores[i] = ScorePosition(ctx, pos, opt.depth, bests[i]);
+        if(i<moves.size()) ApplyMove(pos, moves[i]);
+    }
+
+    std::string text, line;
+    auto emit = [&](const std::string &tok){
+        if(!line.empty() && line.size() + 1 + tok.size() > 79){ text += line + "\n"; line.clear(); }
+        line += (line.empty() ? "" : " ") + tok;
+    };
+    pos = start;
+    for(size_t i=0; i<moves.size(); i++){
+        if(pos.side==C_WHITE) emit(std::to_string(pos.fullmoveNumber) + ".");
+        else if(i==0) emit(std::to_string(pos.fullmoveNumber) + "...");
+        std::string san = MoveToSAN(pos, moves[i]);
+        int after = -scores[i+1];          // value of the played move for the mover
+        int loss = scores[i] - after;
+        int white = pos.side==C_WHITE ? after : -after;
+        std::string comment = FormatEval(white) + "/" + std::to_string(opt.depth);
+        if(loss >= opt.mistake && bests[i].fx!=-1){
+            san += loss >= opt.blunder ? "??" : "?";
+            comment += "; best " + MoveToSAN(pos, bests[i]);
+        }
+        emit(san);
+        emit("{" + comment + "}");
+        ApplyMove(pos, moves[i]);
+    }
+    if(!complete) emit("{unreadable move " + (moves.size() < game.sans.size() ? game.sans[moves.size()] : std::string("?")) + "}");
+    emit(game.result);
+    text += line + "\n";
+    return out + text + "\n";
+}
+
+int RunAnnotate(int argc, char **argv){
+    AnnotateOptions opt;
+    int threads = (int)std::max(1u, std::thread::hardware_concurrency());
+    size_t hashMb = 16;
+    std::string path = "-";
+    for(int i=2; i<argc; i++){
+        std::string a = argv[i];
+        if(a=="--depth" && i+1<argc) opt.depth = std::max(1, std::atoi(argv[++i]));
+        else if(a=="--threads" && i+1<argc) threads = std::max(1, std::atoi(argv[++i]));
+        else if(a=="--hash" && i+1<argc) hashMb = std::max(1, std::atoi(argv[++i]));
+        else if(a=="--blunder" && i+1<argc) opt.blunder = std::atoi(argv[++i]);
+        else if(a=="--mistake" && i+1<argc) opt.mistake = std::atoi(argv[++i]);
+        else if(!a.empty() && a[0]=='-' && a!="-"){ std::fprintf(stderr, "annotate: unknown option %s\n", a.c_str()); return 1; }
+        else path = a;
+    }
+
+    std::ifstream file;
+    std::istream *in = &std::cin;
+    if(path!="-"){
+        file.open(path, std::ios::binary);
+        if(!file){ std::fprintf(stderr, "annotate: cannot open %s\n", path.c_str()); return 1; }
+        in = &file;
+    }
+
+    // finished games wait here until every earlier game has been written; the reader stays at
+    // most 'window' games ahead of the writer so this buffer is bounded too
+    const uint64_t window = (uint64_t)threads * 4;
+    BoundedQueue<AnnotateJob> queue((size_t)threads * 2);
+    std::mutex outMutex;
+    std::condition_variable written;
+    std::map<uint64_t, std::string> done;
+    uint64_t nextWrite = 0;
+
+    std::vector<std::thread> workers;
+    for(int t=0; t<threads; t++){
+        workers.emplace_back([&](){
+            TranspositionTable table;
+            ResizeTT(table, hashMb);
+            SearchContext ctx;
+            ctx.tt = &table;
+            ctx.parallelRoot = false;
+            AnnotateJob job;
+            while(queue.Pop(job)){
+                std::string text = AnnotateGame(ctx, job.game, opt);
+                std::lock_guard<std::mutex> lk(outMutex);
+                done[job.index] = std::move(text);
+                while(!done.empty() && done.begin()->first==nextWrite){
+                    std::fwrite(done.begin()->second.data(), 1, done.begin()->second.size(), stdout);
+                    done.erase(done.begin());
+                    nextWrite++;
+                }
+                std::fflush(stdout);
+                written.notify_all();
+            }
+        });
+    }
+
+    AnnotateJob job;
+    uint64_t index = 0;
+    while(ReadPgnGame(*in, job.game)){
+        {
+            std::unique_lock<std::mutex> lk(outMutex);
+            written.wait(lk, [&]{ return index - nextWrite < window; });
+        }
+        job.index = index++;
+        queue.Push(job);
+    }
+    queue.Close();
+    for(auto &w : workers) w.join();
+    return 0;
+}
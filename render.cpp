@@ -0,0 +1,166 @@
+#include "chess.h"
+#include <cmath>
+#include <cstdio>
+
+// Board compositor. The board lives in a plain 32-bit pixel buffer (0x00RRGGBB, top row
+// first: the layout of a top-down 32bpp DIB), built from square sprites composed once per
+// square size: each background with each piece already blended in. A frame repaints only the
+// squares whose piece, colour or highlight differs from what the buffer shows, and reports
+// them so the front-end copies just those to the screen. Piece coverage masks come from the
+// front-end (GDI glyphs in the GUI, plain shapes in renderbench).
+
+static const uint32_t LIGHT_SQUARE = 0xF0D9B5, DARK_SQUARE = 0xB58863;
+static const uint32_t WHITE_PIECE = 0xFFFFFF, BLACK_PIECE = 0x0A0A0A;
+static const uint32_t TARGET_FRAME = 0x00FF00;
+
+static inline uint32_t Blend(uint32_t bg, uint32_t fg, int a){
+    uint32_t out = 0;
+    for(int s=0; s<24; s+=8){
+        int b = (bg>>s) & 255, f = (fg>>s) & 255;
+        out |= (uint32_t)((b*(255-a) + f*a + 127) / 255) << s;
+    }
+    return out;
+}
+
+static void ComposeCell(BoardRenderer &r, int shade, int colour, int type){
+    int n = r.squareSize * r.squareSize;
+    std::vector<uint32_t> &cell = r.cells[shade][colour][type];
+    cell.assign(n, shade ? DARK_SQUARE : LIGHT_SQUARE);
+    const std::vector<uint8_t> &mask = r.pieceMask[colour][type];
+    if(type==PT_NONE || (int)mask.size()!=n) return;
+    uint32_t fg = colour ? BLACK_PIECE : WHITE_PIECE;
+    for(int i=0;i<n;i++) if(mask[i]) cell[i] = Blend(cell[i], fg, mask[i]);
+}
+
+void ResetBoardRenderer(BoardRenderer &r, int squareSize){
+    r.squareSize = std::max(1, squareSize);
+    int side = 8 * r.squareSize;
+    r.pixels.assign((size_t)side * side, 0);
+    for(int c=0;c<2;c++) for(int t=0;t<7;t++) r.pieceMask[c][t].clear();
+    for(int s=0;s<2;s++) for(int c=0;c<2;c++) for(int t=0;t<7;t++) ComposeCell(r, s, c, t);
+    r.valid = false;
+}
+
+void SetPieceSprite(BoardRenderer &r, Color c, PieceType t, const std::vector<uint8_t> &mask){
+    int colour = c==C_BLACK;
+    r.pieceMask[colour][t] = mask;
+    for(int s=0;s<2;s++) ComposeCell(r, s, colour, t);
+    r.valid = false;
+}
+
+static bool SameSquare(const BoardView &a, const BoardView &b, int x, int y){
+    const Piece &p = a.board[y][x], &q = b.board[y][x];
+    uint64_t bit = 1ULL << (y*8 + x);
+    return p.type==q.type && (p.type==PT_NONE || p.color==q.color) && ((a.targets ^ b.targets) & bit)==0;
+}
+
+static void DrawSquare(BoardRenderer &r, const BoardView &v, int col, int row){
+    int x = v.flip ? 7-col : col, y = v.flip ? 7-row : row;
+    const Piece &p = v.board[y][x];
+    int S = r.squareSize, stride = 8*S;
+    const uint32_t *src = r.cells[(x+y)&1][p.type!=PT_NONE && p.color==C_BLACK][p.type].data();
+    uint32_t *dst = &r.pixels[(size_t)row*S*stride + col*S];
+    for(int i=0;i<S;i++) std::memcpy(dst + (size_t)i*stride, src + i*S, S*sizeof(uint32_t));
+    if(v.targets & (1ULL << (y*8 + x))){
+        for(int i=0;i<S;i++){
+            dst[i] = dst[(size_t)(S-1)*stride + i] = TARGET_FRAME;
+            dst[(size_t)i*stride] = dst[(size_t)i*stride + S-1] = TARGET_FRAME;
+        }
+    }
+}
+
+void RenderBoard(BoardRenderer &r, const BoardView &v, std::vector<PixelRect> &dirty){
+    dirty.clear();
+    bool all = !r.valid || v.flip!=r.shown.flip;
+    int S = r.squareSize;
+    for(int row=0; row<8; row++) for(int col=0; col<8; col++){
+        int x = v.flip ? 7-col : col, y = v.flip ? 7-row : row;
+        if(!all && SameSquare(v, r.shown, x, y)) continue;
+        DrawSquare(r, v, col, row);
+        dirty.push_back({col*S, row*S, S, S});
+    }
+    r.shown = v;
+    r.valid = true;
+}
+
+// ---------------- renderbench tool ----------------
+
+// stand-in glyphs: a pawn-sized disc growing with the piece, kings with a bar across
+static std::vector<uint8_t> ShapeMask(int S, PieceType t, bool filled){
+    std::vector<uint8_t> m((size_t)S*S, 0);
+    double c = (S-1) / 2.0, outer = S * (0.18 + 0.04*(int)t), inner = outer - std::max(1.0, S*0.06);
+    for(int y=0;y<S;y++) for(int x=0;x<S;x++){
+        double d = std::sqrt((x-c)*(x-c) + (y-c)*(y-c));
+        bool on = d<=outer && (filled || d>=inner);
+        if(t==PT_KING && std::abs(y-c) < S*0.05 && std::abs(x-c) < outer) on = true;
+        m[(size_t)y*S + x] = on ? 255 : 0;
+    }
+    return m;
+}
+
+//   chess renderbench [--size N] [--games N] [--seed N]
+// plays random games through the compositor (select a piece, then move it, as in the GUI),
+// checks after every frame that the incrementally updated buffer equals a full redraw, and
+// compares the time of incremental frames with full redraws.
+int RunRenderBench(int argc, char **argv){
+    int size = 80, games = 20;
+    unsigned seed = 1;
+    for(int i=2; i<argc; i++){
+        std::string a = argv[i];
+        if(a=="--size" && i+1<argc) size = std::max(4, std::atoi(argv[++i]));
+        else if(a=="--games" && i+1<argc) games = std::max(1, std::atoi(argv[++i]));
+        else if(a=="--seed" && i+1<argc) seed = (unsigned)std::atoi(argv[++i]);
+        else { std::fprintf(stderr, "renderbench: unknown option %s\n", a.c_str()); return 1; }
+    }
+    BoardRenderer inc, full;
+    for(BoardRenderer *r : {&inc, &full}){
+        ResetBoardRenderer(*r, size);
+        for(int t=PT_PAWN; t<=PT_KING; t++){
+            SetPieceSprite(*r, C_WHITE, (PieceType)t, ShapeMask(size, (PieceType)t, false));
+            SetPieceSprite(*r, C_BLACK, (PieceType)t, ShapeMask(size, (PieceType)t, true));
+        }
+    }
+
+    std::mt19937 gen(seed);
+    std::vector<PixelRect> dirty;
+    uint64_t frames = 0, squares = 0, mismatches = 0;
+    int64_t incUs = 0, fullUs = 0;
+    auto frame = [&](const BoardView &v){
+        auto t0 = std::chrono::steady_clock::now();
+        RenderBoard(inc, v, dirty);
+        auto t1 = std::chrono::steady_clock::now();
+        squares += dirty.size();
+        full.valid = false;
+        RenderBoard(full, v, dirty);
+        auto t2 = std::chrono::steady_clock::now();
+        incUs += std::chrono::duration_cast<std::chrono::microseconds>(t1-t0).count();
+        fullUs += std::chrono::duration_cast<std::chrono::microseconds>(t2-t1).count();
+        if(inc.pixels!=full.pixels) mismatches++;
+        frames++;
+    };
+    for(int g=0; g<games; g++){
+        Position pos;
+        SetStartPosition(pos);
+        BoardView v;
+        v.flip = g & 1;
+        for(int ply=0; ply<200; ply++){
+            auto legal = GenerateLegalMoves(pos.board, pos.side, pos.lastMove);
+            if(legal.empty()) break;
+            Move m = legal[gen() % legal.size()];
+            CopyBoard(pos.board, v.board);
+            v.targets = 0;
+            for(auto &l : legal) if(l.fx==m.fx && l.fy==m.fy) v.targets |= 1ULL << (l.ty*8 + l.tx);
+            frame(v);
+            ApplyMove(pos, m);
+            CopyBoard(pos.board, v.board);
+            v.targets = 0;
+            frame(v);
+        }
+    }
+    std::printf("%llu frames at %dpx squares, %.2f squares repainted per frame\n",
+                (unsigned long long)frames, size, (double)squares / frames);
+    std::printf("incremental %8.1f us/frame\n", (double)incUs / frames);
+    std::printf("full redraw %8.1f us/frame\n", (double)fullUs / frames);
+    std::printf("%s\n", mismatches ? "MISMATCH: incremental frames differ from full redraws" : "incremental frames match full redraws");
+    return mismatches ? 1 : 0;
+}
@@ -0,0 +1,297 @@
+#include "chess.h"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+// ---------------- cooperative scheduler ----------------
+
+TaskScheduler::TaskScheduler(int n){
+    n = std::max(1, n);
+    for(int i=0; i<n; i++) queues.emplace_back(new Queue);
+    for(int i=0; i<n; i++) threads.emplace_back(&TaskScheduler::Run, this, i);
+}
+
+TaskScheduler::~TaskScheduler(){
+    Wait();
+    {
+        std::lock_guard<std::mutex> lk(m);
+        quit = true;
+    }
+    work.notify_all();
+    for(auto &t : threads) t.join();
+}
+
+void TaskScheduler::Submit(std::function<bool()> job){
+    {
+        std::lock_guard<std::mutex> lk(m);
+        pending++;
+    }
+    Requeue((int)(nextQueue++ % queues.size()), std::move(job));
+}
+
+void TaskScheduler::Wait(){
+    std::unique_lock<std::mutex> lk(m);
+    finished.wait(lk, [this]{ return pending==0; });
+}
+
+void TaskScheduler::Requeue(int index, std::function<bool()> job){
+    {
+        std::lock_guard<std::mutex> lk(queues[index]->m);
+        queues[index]->jobs.push_back(std::move(job));
+    }
+    queued++;
+    // an idle worker counts itself under m before it checks queued, so it cannot miss this
+    if(idle.load()){
+        std::lock_guard<std::mutex> lk(m);
+        work.notify_one();
+    }
+}
+
+// the front of our own queue, else the back of the longest other one
+bool TaskScheduler::Take(int index, std::function<bool()> &job){
+    int n = (int)queues.size();
+    for(int k=0; k<n; k++){
+        int victim = k==0 ? index : -1;
+        if(k==1){
+            size_t longest = 0;
+            for(int i=0; i<n; i++){
+                if(i==index) continue;
+                std::lock_guard<std::mutex> lk(queues[i]->m);
+                if(queues[i]->jobs.size() > longest){ longest = queues[i]->jobs.size(); victim = i; }
+            }
+        }
+        if(victim<0) break;
+        Queue &q = *queues[victim];
+        std::lock_guard<std::mutex> lk(q.m);
+        if(q.jobs.empty()) continue;
+        if(victim==index){ job = std::move(q.jobs.front()); q.jobs.pop_front(); }
+        else { job = std::move(q.jobs.back()); q.jobs.pop_back(); }
+        queued--;
+        return true;
+    }
+    return false;
+}
+
+void TaskScheduler::Run(int index){
+    BindThisThread(index);
+    for(;;){
+        std::function<bool()> job;
+        if(!Take(index, job)){
+            std::unique_lock<std::mutex> lk(m);
+            idle++;
+            work.wait(lk, [this]{ return quit || queued.load()>0; });
+            idle--;
+            if(quit && queued.load()==0) return;
+            continue;
+        }
+        if(!job()){ Requeue(index, std::move(job)); continue; }
+        std::lock_guard<std::mutex> lk(m);
+        if(--pending==0) finished.notify_all();
+    }
+}
+
+// ---------------- casual tool ----------------
+
+// A casual game: a position and the search for its next move
+struct CasualGame {
+    Position pos;
+    std::shared_ptr<SearchTask> search;
+    int64_t searchStartUs = 0;
+    int plies = 0;
+};
+
+static int64_t NowUs(){
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static bool CasualGameOver(const Position &pos, int plies, int maxPlies){
+    return plies>=maxPlies || pos.halfmoveClock>=100 || GenerateLegalMoves(pos.board, pos.side, pos.lastMove).empty();
+}
+
+struct CasualStats {
+    std::mutex m;
+    std::vector<int64_t> latencyUs; // per move, from the search's start to its result
+    uint64_t moves = 0, nodes = 0;
+    size_t peakTaskBytes = 0;
+};
+
+//   chess casual [--games N] [--threads N] [--depth N] [--nodes N] [--skill N] [--slice N]
+//                [--hash MB] [--plies N] [--seed N] [--baseline]
+// plays many self-play games at once, the load of a casual-play service. Every search is a
+// resumable task advanced --slice nodes at a time by a scheduler on --threads threads, sharing
+// one transposition table. --baseline instead gives every game its own OS thread running
+// Think, the pattern this replaces. The first four plies of each game are random, so the
+// games differ. --skill plays at that level, with its node budget and its weaker moves.
+// Reports per-move latency and memory per game.
+int RunCasual(int argc, char **argv){
+    int games = 1000, threads = (int)std::max(1u, std::thread::hardware_concurrency());
+    int maxPlies = 60, slice = 1024;
+    size_t hashMb = 64;
+    unsigned seed = 1;
+    bool baseline = false;
+    SearchLimits limits;
+    limits.depth = 3;
+    for(int i=2; i<argc; i++){
+        std::string a = argv[i];
+        bool more = i+1<argc;
+        if(a=="--games" && more) games = std::max(1, std::atoi(argv[++i]));
+        else if(a=="--threads" && more) threads = std::max(1, std::atoi(argv[++i]));
+        else if(a=="--depth" && more) limits.depth = std::max(1, std::atoi(argv[++i]));
+        else if(a=="--nodes" && more) limits.nodes = std::strtoull(argv[++i], nullptr, 10);
+        else if(a=="--skill" && more){ limits.skill = std::atoi(argv[++i]); limits.depth = 0; }
+        else if(a=="--slice" && more) slice = std::max(1, std::atoi(argv[++i]));
+        else if(a=="--hash" && more) hashMb = std::max(1, std::atoi(argv[++i]));
+        else if(a=="--plies" && more) maxPlies = std::max(1, std::atoi(argv[++i]));
+        else if(a=="--seed" && more) seed = (unsigned)std::atoi(argv[++i]);
+        else if(a=="--baseline") baseline = true;
+        else if(ParseMemoryOption(argc, argv, i)) continue;
+        else { std::fprintf(stderr, "casual: unknown option %s\n", a.c_str()); return 1; }
+    }
+
+    LoadBitbases(".");
+    TranspositionTable table;
+    ResizeTT(table, hashMb);
+    std::vector<CasualGame> all(games);
+    std::mt19937 gen(seed);
+    for(auto &g : all){
+        SetStartPosition(g.pos);
+        for(int p=0; p<4; p++){
+            auto legal = GenerateLegalMoves(g.pos.board, g.pos.side, g.pos.lastMove);
+            ApplyMove(g.pos, legal[gen() % legal.size()]);
+        }
+    }
+
+    CasualStats stats;
+    auto finishMove = [&](CasualGame &g, uint64_t nodes, size_t taskBytes){
+        int64_t us = NowUs() - g.searchStartUs;
+        std::lock_guard<std::mutex> lk(stats.m);
+        stats.latencyUs.push_back(us);
+        if(++stats.moves % all.size() == 0) NextTTGeneration(table); // a move per game ages the table once
+        stats.nodes += nodes;
+        stats.peakTaskBytes = std::max(stats.peakTaskBytes, taskBytes);
+    };
+
+    int64_t t0 = NowUs();
+    for(auto &g : all) g.searchStartUs = t0; // every game wants its first move now
+    if(baseline){
+        std::vector<std::thread> pool;
+        for(auto &g : all){
+            pool.emplace_back([&, limits](){
+                SearchContext ctx;
+                ctx.tt = &table;
+                ctx.parallelRoot = false;
+                ctx.ageTT = false;
+                while(!CasualGameOver(g.pos, g.plies, maxPlies)){
+                    PrepareSearch(ctx, limits);
+                    SearchResult res = Think(ctx, g.pos);
+                    finishMove(g, ctx.nodes.load(), 0);
+                    ApplyMove(g.pos, res.best);
+                    g.plies++;
+                    g.searchStartUs = NowUs();
+                }
+            });
+        }
+        for(auto &t : pool) t.join();
+    } else {
+        TaskScheduler scheduler(threads);
+        for(auto &g : all){
+            scheduler.Submit([&, limits]()->bool{
+                if(!g.search){
+                    if(CasualGameOver(g.pos, g.plies, maxPlies)) return true;
+                    g.search = StartSearchTask(g.pos, limits, &table);
+                }
+                if(!StepSearchTask(*g.search, (uint64_t)slice)) return false;
+                const SearchResult &res = SearchTaskResult(*g.search);
+                finishMove(g, SearchTaskNodes(*g.search), SearchTaskBytes(*g.search));
+                ApplyMove(g.pos, res.best);
+                g.plies++;
+                g.searchStartUs = NowUs(); // the reply is wanted from now, not from when it gets a turn
+                g.search.reset();
+                return false; // the next move's search starts on the next slice
+            });
+        }
+        scheduler.Wait();
+    }
+    double secs = (NowUs() - t0) / 1e6;
+
+    std::vector<int64_t> &lat = stats.latencyUs;
+    std::sort(lat.begin(), lat.end());
+    auto pct = [&](double p)->double{ return lat.empty() ? 0 : lat[std::min(lat.size()-1, (size_t)(p * lat.size()))] / 1000.0; };
+    std::printf("%d games, %s, %llu moves in %.2f s (%.0f moves/s, %.0f nodes/s)\n", games,
+                baseline ? "one thread per game" : (std::to_string(threads) + " scheduler threads, slice " + std::to_string(slice)).c_str(),
+                (unsigned long long)stats.moves, secs, stats.moves / secs, stats.nodes / secs);
+    std::printf("move latency ms: p50 %.1f  p90 %.1f  p99 %.1f  max %.1f\n", pct(0.5), pct(0.9), pct(0.99), pct(1.0));
+    if(!baseline) std::printf("memory per game: %zu bytes game state + at most %zu bytes search\n", sizeof(CasualGame), stats.peakTaskBytes);
+    return 0;
+}
+
+//   chess tasktest [--depth N] [--skill N] [--slice N] [file|-]
+// searches each position (built-in ones without a file) with Think and with a search task
+// stepped --slice nodes at a time, each on its own fresh table, and checks they agree on the
+// move, the score and the node count. Exits 1 on any difference.
+int RunTaskTest(int argc, char **argv){
+    static const char *TASK_TEST_FENS[] = {
+        "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+        "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+        "r1bq1rk1/pp2bppp/2n1pn2/3p4/2PP4/2N1PN2/PP3PPP/R2QKB1R w KQ - 0 8",
+        "rnbqkbnr/ppp1p1pp/8/3pPp2/8/8/PPPP1PPP/RNBQKBNR w KQkq f6 0 3",
+        "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+        "6k1/5ppp/8/8/8/8/5PPP/R5K1 w - - 0 1",
+        "8/P6k/8/8/8/8/6K1/8 w - - 0 1",
+        "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 b - - 0 10",
+    };
+    SearchLimits limits;
+    limits.depth = 5;
+    uint64_t slice = 1000;
+    std::string path;
+    for(int i=2; i<argc; i++){
+        std::string a = argv[i];
+        bool more = i+1<argc;
+        if(a=="--depth" && more) limits.depth = std::max(1, std::atoi(argv[++i]));
+        else if(a=="--skill" && more){ limits.skill = std::atoi(argv[++i]); limits.depth = 0; }
+        else if(a=="--slice" && more) slice = std::max(1, std::atoi(argv[++i]));
+        else if(!a.empty() && a[0]=='-' && a!="-"){ std::fprintf(stderr, "tasktest: unknown option %s\n", a.c_str()); return 1; }
+        else path = a;
+    }
+    std::vector<std::string> lines;
+    if(path.empty()) lines.assign(std::begin(TASK_TEST_FENS), std::end(TASK_TEST_FENS));
+    else {
+        std::ifstream file;
+        std::istream *in = &std::cin;
+        if(path!="-"){
+            file.open(path);
+            if(!file){ std::fprintf(stderr, "tasktest: cannot open %s\n", path.c_str()); return 1; }
+            in = &file;
+        }
+        std::string line;
+        while(std::getline(*in, line)) lines.push_back(line);
+    }
+
+    LoadBitbases(".");
+    int positions = 0, failures = 0;
+    for(auto &line : lines){
+        Position pos;
+        if(!ParseEPD(line, pos)) continue;
+        positions++;
+        TranspositionTable thinkTable, taskTable;
+        ResizeTT(thinkTable, 16);
+        ResizeTT(taskTable, 16);
+        SearchContext ctx;
+        ctx.tt = &thinkTable;
+        ctx.parallelRoot = false;
+        PrepareSearch(ctx, limits);
+        SearchResult a = Think(ctx, pos);
+        auto task = StartSearchTask(pos, limits, &taskTable);
+        while(!StepSearchTask(*task, slice)){}
+        const SearchResult &b = SearchTaskResult(*task);
+        uint64_t an = ctx.nodes.load(), bn = SearchTaskNodes(*task);
+        if(PackMove(a.best)==PackMove(b.best) && a.score==b.score && an==bn) continue;
+        failures++;
+        std::printf("differs: %s\n  think %s %d %llu nodes\n  task  %s %d %llu nodes\n", ToFEN(pos).c_str(),
+                    MoveToUci(pos.board, a.best).c_str(), a.score, (unsigned long long)an,
+                    MoveToUci(pos.board, b.best).c_str(), b.score, (unsigned long long)bn);
+    }
+    std::printf("%d positions, %d differ\n", positions, failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,401 @@
+#ifdef _WIN32
+#include <winsock2.h> // before windows.h (via chess.h), which would pull in the old winsock.h
+#include <ws2tcpip.h>
+#endif
+#include "chess.h"
+#include <cstdio>
+#include <list>
+#include <map>
+#include <unordered_map>
+#ifndef _WIN32
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+// Analysis server: a long-running process answering position-analysis requests from local
+// clients over loopback TCP, one JSON object per line each way.
+//
+//   chess serve [--port N] [--threads N] [--hash MB] [--cache N] [--depth N]
+//               [--max-depth N] [--max-movetime MS] [--max-nodes N]
+//               [--large-pages on|off] [--parallel-init] [--bind none|cores|nodes]
+//
+// Request:  {"id":7, "fen":"..." or "startpos":true, "moves":["e2e4",...],
+//            "depth":N, "movetime":MS, "nodes":N, "nocache":true}
+// Response: {"id":7, "fen":..., "bestmove":..., "score":..., "depth":..., "pv":[...],
+//            "nodes":N, "time_ms":N, "cached":false}, or {"id":7, "error":"..."}
+// {"cmd":"stats"} reports the request, search and cache counters. A line longer than 64 KB
+// gets {"error":"request too long"} and the connection is closed.
+//
+// Requests from every connection go through one queue to a fixed pool of single-threaded
+// searches sharing one transposition table, so the table stays warm across requests and
+// clients. Results are kept in an LRU cache by position and answer any later request whose
+// budget they cover; a request identical to one being searched waits for that search instead
+// of starting another. The --max-* caps bound every budget.
+
+#ifdef _WIN32
+#pragma comment(lib, "ws2_32.lib")
+typedef SOCKET SocketHandle;
+static void CloseSocket(SocketHandle s){ closesocket(s); }
+static void ShutdownSocket(SocketHandle s){ shutdown(s, SD_BOTH); }
+#else
+typedef int SocketHandle;
+static const SocketHandle INVALID_SOCKET = -1;
+static void CloseSocket(SocketHandle s){ close(s); }
+static void ShutdownSocket(SocketHandle s){ shutdown(s, SHUT_RDWR); }
+#endif
+
+// ---------------- requests ----------------
+
+// Just enough JSON for requests: one flat object whose values are strings, numbers,
+// true/false/null or arrays of strings. Each member keeps its raw text, to echo the id back.
+struct JsonMember {
+    std::string raw, text;          // text: unescaped string, or the raw literal
+    std::vector<std::string> items; // array elements
+};
+
+static bool ParseJsonString(const std::string &s, size_t &i, std::string &out){
+    if(i>=s.size() || s[i]!='"') return false;
+    out.clear();
+    for(i++; i<s.size(); i++){
+        char c = s[i];
+        if(c=='"'){ i++; return true; }
+        if(c!='\\'){ out += c; continue; }
+        if(++i>=s.size()) return false;
+        switch(s[i]){
+            case 'n': out += '\n'; break;
+            case 't': out += '\t'; break;
+            case 'r': out += '\r'; break;
+            case 'b': out += '\b'; break;
+            case 'f': out += '\f'; break;
+            case 'u': {
+                if(i+4>=s.size()) return false;
+                int code = (int)std::strtol(s.substr(i+1, 4).c_str(), nullptr, 16);
+                out += code < 0x80 ? (char)code : '?';
+                i += 4;
+                break;
+            }
+            default: out += s[i];
+        }
+    }
+    return false;
+}
+
+static bool ParseJsonObject(const std::string &s, std::map<std::string, JsonMember> &out){
+    size_t i = 0;
+    auto ws = [&](){ while(i<s.size() && isspace((unsigned char)s[i])) i++; };
+    ws();
+    if(i>=s.size() || s[i++]!='{') return false;
+    ws();
+    if(i<s.size() && s[i]=='}') return true;
+    while(i<s.size()){
+        std::string key;
+        ws();
+        if(!ParseJsonString(s, i, key)) return false;
+        ws();
+        if(i>=s.size() || s[i++]!=':') return false;
+        ws();
+        JsonMember m;
+        size_t start = i;
+        if(i<s.size() && s[i]=='"'){
+            if(!ParseJsonString(s, i, m.text)) return false;
+        } else if(i<s.size() && s[i]=='['){
+            i++;
+            ws();
+            while(i<s.size() && s[i]!=']'){
+                std::string item;
+                if(!ParseJsonString(s, i, item)) return false;
+                m.items.push_back(item);
+                ws();
+                if(i<s.size() && s[i]==','){ i++; ws(); }
+            }
+            if(i>=s.size()) return false;
+            i++;
+        } else {
+            while(i<s.size() && s[i]!=',' && s[i]!='}' && !isspace((unsigned char)s[i])) i++;
+            m.text = s.substr(start, i-start);
+            if(m.text.empty()) return false;
+        }
+        m.raw = s.substr(start, i-start);
+        out[key] = m;
+        ws();
+        if(i<s.size() && s[i]==','){ i++; continue; }
+        return i<s.size() && s[i]=='}';
+    }
+    return false;
+}
+
+struct ServerOptions {
+    int port = 8731;
+    int threads = (int)std::max(1u, std::thread::hardware_concurrency());
+    size_t hashMb = 64;
+    size_t cacheEntries = 10000;
+    int defaultDepth = 8;
+    int maxDepth = 64, maxMovetimeMs = 60000;
+    uint64_t maxNodes = 0; // 0 = no cap
+};
+
+struct ServerConnection {
+    SocketHandle sock = INVALID_SOCKET;
+    std::mutex writeMutex;
+    ~ServerConnection(){ if(sock!=INVALID_SOCKET) CloseSocket(sock); }
+    void Send(const std::string &line){
+        std::lock_guard<std::mutex> lk(writeMutex);
+        size_t off = 0;
+        while(off < line.size()){
+            int n = (int)send(sock, line.data()+off, (int)(line.size()-off), 0);
+            if(n<=0) return; // the client went away; its reader thread notices
+            off += (size_t)n;
+        }
+    }
+};
+
+struct AnalysisRequest {
+    std::shared_ptr<ServerConnection> conn;
+    std::string id;       // raw JSON of the client's id, echoed in the reply
+    Position pos;
+    SearchLimits limits;
+    std::string key;      // position, for the result cache
+    std::string budgetKey; // position and budget, for matching identical requests
+    bool useCache = true;
+};
+
+struct CachedAnalysis {
+    std::string json; // AnalysisJson members plus nodes and time_ms
+    int depth = 0;
+    uint64_t nodes = 0;
+    int64_t timeMs = 0;
+};
+
+// a cached result answers a request if its search went at least as far as every set budget
+static bool Covers(const CachedAnalysis &c, const SearchLimits &l){
+    return (!l.depth || c.depth>=l.depth) && (!l.nodes || c.nodes>=l.nodes) && (!l.movetimeMs || c.timeMs>=l.movetimeMs);
+}
+
+struct AnalysisServer {
+    ServerOptions opt;
+    TranspositionTable table;
+    BoundedQueue<AnalysisRequest> queue;
+    std::mutex m; // everything below
+    std::list<std::pair<std::string, CachedAnalysis>> lru; // most recent first
+    std::unordered_map<std::string, std::list<std::pair<std::string, CachedAnalysis>>::iterator> cacheIndex;
+    std::unordered_map<std::string, std::vector<AnalysisRequest>> waiting; // budgetKey of a search -> identical requests
+    uint64_t requests = 0, searches = 0, cacheHits = 0, coalesced = 0;
+    uint64_t started = 0; // searches begun; every opt.threads of them are one table generation
+    explicit AnalysisServer(const ServerOptions &o) : opt(o), queue((size_t)o.threads * 16) {}
+};
+
+static void Reply(const AnalysisRequest &r, const std::string &body){
+    std::string line = "{";
+    if(!r.id.empty()) line += "\"id\":" + r.id + ",";
+    r.conn->Send(line + body + "}\n");
+}
+
+static bool LookupCache(AnalysisServer &s, const AnalysisRequest &r, std::string &json){
+    auto it = s.cacheIndex.find(r.key);
+    if(it==s.cacheIndex.end() || !Covers(it->second->second, r.limits)) return false;
+    s.lru.splice(s.lru.begin(), s.lru, it->second);
+    json = it->second->second.json;
+    return true;
+}
+
+// keeps the deeper of the old and new result
+static void StoreCache(AnalysisServer &s, const std::string &key, const CachedAnalysis &c){
+    auto it = s.cacheIndex.find(key);
+    if(it!=s.cacheIndex.end()){
+        if(c.depth >= it->second->second.depth) it->second->second = c;
+        s.lru.splice(s.lru.begin(), s.lru, it->second);
+        return;
+    }
+    s.lru.push_front({key, c});
+    s.cacheIndex[key] = s.lru.begin();
+    while(s.lru.size() > s.opt.cacheEntries){
+        s.cacheIndex.erase(s.lru.back().first);
+        s.lru.pop_back();
+    }
+}
+
+static void SearchWorker(AnalysisServer &s, int index){
+    BindThisThread(index);
+    SearchContext ctx;
+    ctx.tt = &s.table;
+    ctx.parallelRoot = false;
+    ctx.ageTT = false; // the workers' searches run side by side: the table ages once per batch
+    AnalysisRequest r;
+    while(s.queue.Pop(r)){
+        {
+            std::lock_guard<std::mutex> lk(s.m);
+            if(s.started++ % s.opt.threads == 0) NextTTGeneration(s.table);
+        }
+        PrepareSearch(ctx, r.limits);
+        SearchResult res = Think(ctx, r.pos);
+        CachedAnalysis c;
+        c.depth = res.depth;
+        c.nodes = ctx.nodes.load();
+        c.timeMs = NowMs() - ctx.startMs;
+        c.json = AnalysisJson(r.pos, res) + ",\"nodes\":" + std::to_string(c.nodes) + ",\"time_ms\":" + std::to_string(c.timeMs);
+        std::vector<AnalysisRequest> waiters;
+        {
+            std::lock_guard<std::mutex> lk(s.m);
+            s.searches++;
+            StoreCache(s, r.key, c);
+            if(r.useCache){
+                auto it = s.waiting.find(r.budgetKey);
+                if(it!=s.waiting.end()){ waiters.swap(it->second); s.waiting.erase(it); }
+            }
+        }
+        Reply(r, c.json + ",\"cached\":false");
+        for(auto &w : waiters) Reply(w, c.json + ",\"cached\":true");
+    }
+}
+
+static const size_t SERVER_MAX_LINE = 64 * 1024; // bytes of one request line
+
+static std::string ErrorBody(const std::string &msg){ return "\"error\":\"" + JsonEscape(msg) + "\""; }
+
+static void HandleLine(AnalysisServer &s, const std::shared_ptr<ServerConnection> &conn, const std::string &line){
+    AnalysisRequest r;
+    r.conn = conn;
+    std::map<std::string, JsonMember> req;
+    if(!ParseJsonObject(line, req)){ Reply(r, ErrorBody("invalid JSON")); return; }
+    if(req.count("id")) r.id = req["id"].raw;
+    auto number = [&](const char *name)->int64_t{ return req.count(name) ? std::atoll(req[name].text.c_str()) : 0; };
+
+    if(req.count("cmd")){
+        if(req["cmd"].text!="stats"){ Reply(r, ErrorBody("unknown cmd")); return; }
+        std::lock_guard<std::mutex> lk(s.m);
+        Reply(r, "\"requests\":" + std::to_string(s.requests) + ",\"searches\":" + std::to_string(s.searches) +
+                 ",\"cache_hits\":" + std::to_string(s.cacheHits) + ",\"coalesced\":" + std::to_string(s.coalesced) +
+                 ",\"cached_positions\":" + std::to_string(s.lru.size()) + ",\"threads\":" + std::to_string(s.opt.threads) +
+                 ",\"hash_mb\":" + std::to_string(s.opt.hashMb));
+        return;
+    }
+
+    if(req.count("fen")){
+        if(!ParseFEN(req["fen"].text, r.pos)){ Reply(r, ErrorBody("invalid fen")); return; }
+    }
+    else if(req.count("startpos")) SetStartPosition(r.pos);
+    else { Reply(r, ErrorBody("fen or startpos required")); return; }
+    for(auto &u : req["moves"].items){
+        Move m;
+        if(!ParseUciMove(r.pos, u, m)){ Reply(r, ErrorBody("illegal move " + u)); return; }
+        ApplyMove(r.pos, m);
+    }
+
+    SearchLimits &l = r.limits;
+    l.depth = (int)std::min<int64_t>(std::max<int64_t>(0, number("depth")), s.opt.maxDepth);
+    l.movetimeMs = (int)std::min<int64_t>(std::max<int64_t>(0, number("movetime")), s.opt.maxMovetimeMs);
+    l.nodes = (uint64_t)std::max<int64_t>(0, number("nodes"));
+    if(s.opt.maxNodes) l.nodes = l.nodes ? std::min(l.nodes, s.opt.maxNodes) : s.opt.maxNodes;
+    if(!l.depth && !l.movetimeMs && !l.nodes) l.depth = s.opt.defaultDepth;
+    // clocks do not change the analysis, so a position is its first four FEN fields
+    std::string fen = ToFEN(r.pos);
+    size_t cut = fen.size();
+    for(int spaces=0, i=0; i<(int)fen.size(); i++) if(fen[i]==' ' && ++spaces==4){ cut = i; break; }
+    r.key = fen.substr(0, cut);
+    r.budgetKey = r.key + "|" + std::to_string(l.depth) + "|" + std::to_string(l.movetimeMs) + "|" + std::to_string(l.nodes);
+    r.useCache = !(req.count("nocache") && req["nocache"].text=="true");
+
+    std::string json;
+    {
+        std::lock_guard<std::mutex> lk(s.m);
+        s.requests++;
+        if(r.useCache && LookupCache(s, r, json)) s.cacheHits++;
+        else if(r.useCache && s.waiting.count(r.budgetKey)){
+            s.coalesced++;
+            s.waiting[r.budgetKey].push_back(r);
+            return;
+        }
+        else if(r.useCache) s.waiting[r.budgetKey]; // later identical requests wait for this search
+    }
+    if(!json.empty()) Reply(r, json + ",\"cached\":true");
+    else s.queue.Push(std::move(r));
+}
+
+static void ServeConnection(AnalysisServer &s, std::shared_ptr<ServerConnection> conn){
+    std::string buf;
+    char chunk[4096];
+    for(;;){
+        int n = (int)recv(conn->sock, chunk, sizeof(chunk), 0);
+        if(n<=0) break;
+        buf.append(chunk, (size_t)n);
+        size_t nl;
+        while((nl = buf.find('\n'))!=std::string::npos){
+            std::string line = buf.substr(0, nl);
+            buf.erase(0, nl+1);
+            if(!line.empty() && line.back()=='\r') line.pop_back();
+            if(line.find_first_not_of(" \t")!=std::string::npos) HandleLine(s, conn, line);
+        }
+        if(buf.size() > SERVER_MAX_LINE){ // no newline in sight: drop the client, not the server
+            AnalysisRequest r;
+            r.conn = conn;
+            Reply(r, ErrorBody("request too long"));
+            ShutdownSocket(conn->sock); // now, even while its queued requests keep conn alive
+            break;
+        }
+    }
+}
+
+int RunServer(int argc, char **argv){
+    ServerOptions opt;
+    for(int i=2; i<argc; i++){
+        std::string a = argv[i];
+        bool more = i+1<argc;
+        if(a=="--port" && more) opt.port = std::atoi(argv[++i]);
+        else if(a=="--threads" && more) opt.threads = std::max(1, std::atoi(argv[++i]));
+        else if(a=="--hash" && more) opt.hashMb = std::max(1, std::atoi(argv[++i]));
+        else if(a=="--cache" && more) opt.cacheEntries = std::max(1, std::atoi(argv[++i]));
+        else if(a=="--depth" && more) opt.defaultDepth = std::max(1, std::atoi(argv[++i]));
+        else if(a=="--max-depth" && more) opt.maxDepth = std::max(1, std::atoi(argv[++i]));
+        else if(a=="--max-movetime" && more) opt.maxMovetimeMs = std::max(1, std::atoi(argv[++i]));
+        else if(a=="--max-nodes" && more) opt.maxNodes = std::strtoull(argv[++i], nullptr, 10);
+        else if(ParseMemoryOption(argc, argv, i)) continue;
+        else { std::fprintf(stderr, "serve: unknown option %s\n", a.c_str()); return 1; }
+    }
+    opt.defaultDepth = std::min(opt.defaultDepth, opt.maxDepth);
+
+#ifdef _WIN32
+    WSADATA wsa;
+    if(WSAStartup(MAKEWORD(2,2), &wsa)!=0){ std::fprintf(stderr, "serve: winsock unavailable\n"); return 1; }
+#else
+    signal(SIGPIPE, SIG_IGN); // a client closing early must not kill the server
+#endif
+    SocketHandle listener = socket(AF_INET, SOCK_STREAM, 0);
+    if(listener==INVALID_SOCKET){ std::fprintf(stderr, "serve: cannot create socket\n"); return 1; }
+    int yes = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, (const char*)&yes, sizeof(yes));
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK); // local clients only
+    addr.sin_port = htons((unsigned short)opt.port);
+    if(bind(listener, (sockaddr*)&addr, sizeof(addr))!=0 || listen(listener, 64)!=0){
+        std::fprintf(stderr, "serve: cannot listen on 127.0.0.1:%d\n", opt.port);
+        CloseSocket(listener);
+        return 1;
+    }
+
+    LoadBitbases(".");
+    AnalysisServer server(opt);
+    ResizeTT(server.table, opt.hashMb);
+    std::vector<std::thread> workers;
+    for(int t=0; t<opt.threads; t++) workers.emplace_back(SearchWorker, std::ref(server), t);
+    std::fprintf(stderr, "serve: listening on 127.0.0.1:%d, %d search threads, hash %s\n", opt.port, opt.threads, DescribeTT(server.table).c_str());
+
+    for(;;){
+        SocketHandle client = accept(listener, nullptr, nullptr);
+        if(client==INVALID_SOCKET) break;
+        auto conn = std::make_shared<ServerConnection>();
+        conn->sock = client;
+        std::thread(ServeConnection, std::ref(server), conn).detach();
+    }
+    std::fprintf(stderr, "serve: accept failed, shutting down\n");
+    CloseSocket(listener);
+    server.queue.Close();
+    for(auto &w : workers) w.join();
+#ifdef _WIN32
+    WSACleanup();
+#endif
+    return 1;
+}
@@ -0,0 +1,338 @@
+#include "chess.h"
+#include "endgame.h"
+#include <cstdio>
+
+// Endgame tablebases: win/draw/loss (WDL) and distance-to-zeroing (DTZ) for every position
+// with one piece besides the kings, generated locally by "chess tbgen" and read back through
+// read-only file mappings.
+//
+// Files, per material (KQvK, KRvK, KBvK, KNvK, KPvK):
+//   <name>.tbw  16-byte header, then 2 bits per position (0 draw, 1 win, 2 loss, 3 illegal)
+//               for the side to move
+//   <name>.tbz  16-byte header, then a little-endian uint16 per position: plies to the next
+//               capture or pawn move with best play (0 for draws and for mated positions)
+// The index is the bitbase one: side to move x strong king x weak king x piece, with the side
+// that owns the piece mirrored to White. Search only needs the small WDL files; DTZ is read
+// at the root. Each file is mapped the first time a position needs it, from any thread.
+
+enum TBKind { TB_KNK, TB_KBK, TB_KRK, TB_KQK, TB_KPK, TB_COUNT };
+static const PieceType TB_PIECE[TB_COUNT] = { PT_KNIGHT, PT_BISHOP, PT_ROOK, PT_QUEEN, PT_PAWN };
+static const char *TB_NAME[TB_COUNT] = { "KNvK", "KBvK", "KRvK", "KQvK", "KPvK" };
+static const int TB_SIZE = ENDGAME_SIZE;
+static const uint32_t TBW_MAGIC = 0x57425443, TBZ_MAGIC = 0x5A425443; // "CTBW", "CTBZ"
+static const size_t TB_HEADER = 16;
+static const uint16_t DTZ_UNKNOWN = 0xFFFF;
+
+enum { TBS_UNKNOWN=0, TBS_WIN, TBS_DRAW, TBS_INVALID };
+
+// ---------------- generation ----------------
+
+struct TBWork {
+    std::unique_ptr<std::atomic<uint8_t>[]> st;
+    std::unique_ptr<std::atomic<uint16_t>[]> dtz;
+};
+
+// every strong-side move of a position, as (child index, zeroing?, promotion table or -1)
+struct TBMove { int child; bool zeroing; int promoTable; };
+
+static int StrongMoves(TBKind kind, int sk, int wk, int ps, TBMove out[40]){
+    PieceType pt = TB_PIECE[kind];
+    int n = 0;
+    for(int d=0; d<8; d++){
+        int x = (sk&7)+KING_DX[d], y = (sk>>3)+KING_DY[d], t = y*8+x;
+        if(OnBoard(x,y) && t!=ps && !KingsTouch(t, wk)) out[n++] = {EndgameIndex(1, t, wk, ps), false, -1};
+    }
+    if(pt==PT_PAWN){
+        int t = ps-8;
+        if(t==sk || t==wk) return n;
+        if((t>>3)==0){
+            for(int k : {TB_KQK, TB_KRK, TB_KBK, TB_KNK}) out[n++] = {EndgameIndex(1, sk, wk, t), true, k};
+            return n;
+        }
+        out[n++] = {EndgameIndex(1, sk, wk, t), true, -1};
+        if((ps>>3)==6 && t-8!=sk && t-8!=wk) out[n++] = {EndgameIndex(1, sk, wk, t-8), true, -1};
+        return n;
+    }
+    int targets[32];
+    int m = PieceTargets(pt, ps, sk, wk, targets);
+    for(int i=0; i<m; i++) out[n++] = {EndgameIndex(1, sk, wk, targets[i]), false, -1};
+    return n;
+}
+
+static void GenerateTable(TBKind kind, TBWork work[TB_COUNT], int threads){
+    PieceType pt = TB_PIECE[kind];
+    TBWork &w = work[kind];
+    w.st.reset(new std::atomic<uint8_t>[TB_SIZE]);
+    w.dtz.reset(new std::atomic<uint16_t>[TB_SIZE]);
+    auto state = [&](int i){ return w.st[i].load(std::memory_order_relaxed); };
+    auto dtzOf = [&](int i){ return w.dtz[i].load(std::memory_order_relaxed); };
+    auto promoWins = [&](const TBMove &m){ return work[m.promoTable].st[m.child].load(std::memory_order_relaxed)==TBS_WIN; };
+
+    RunParallel(threads, [&](int lo, int hi){
+        for(int idx=lo; idx<hi; idx++){
+            w.st[idx].store(EndgameInvalid(pt, idx) ? TBS_INVALID : TBS_UNKNOWN, std::memory_order_relaxed);
+            w.dtz[idx].store(DTZ_UNKNOWN, std::memory_order_relaxed);
+        }
+    });
+
+    // WDL: wins only ever get added, so passes can run in place
+    Iterate(threads, [&](int idx){
+        if(state(idx)!=TBS_UNKNOWN) return false;
+        int stm, sk, wk, ps;
+        SplitEndgameIndex(idx, stm, sk, wk, ps);
+        int r = TBS_UNKNOWN;
+        if(stm==0){
+            TBMove moves[40];
+            int n = StrongMoves(kind, sk, wk, ps, moves);
+            for(int i=0; i<n && r==TBS_UNKNOWN; i++)
+                if(moves[i].promoTable>=0 ? promoWins(moves[i]) : state(moves[i].child)==TBS_WIN) r = TBS_WIN;
+        } else {
+            int moves[8];
+            int n = WeakMoves(pt, sk, wk, ps, moves);
+            if(n<0) r = TBS_DRAW;
+            else if(n==0) r = PieceAttacks(pt, ps, wk, sk) ? TBS_WIN : TBS_DRAW;
+            else {
+                bool allLose = true;
+                for(int i=0; i<n && allLose; i++) allLose = state(moves[i])==TBS_WIN;
+                if(allLose) r = TBS_WIN;
+            }
+        }
+        if(r==TBS_UNKNOWN) return false;
+        w.st[idx].store((uint8_t)r, std::memory_order_relaxed);
+        return true;
+    });
+    RunParallel(threads, [&](int lo, int hi){
+        for(int idx=lo; idx<hi; idx++){
+            int s = state(idx);
+            if(s==TBS_UNKNOWN) w.st[idx].store(TBS_DRAW, std::memory_order_relaxed);
+            if(s!=TBS_WIN) w.dtz[idx].store(0, std::memory_order_relaxed);
+            else if((idx>>18)==1){
+                int moves[8];
+                if(WeakMoves(pt, (idx>>12)&63, (idx>>6)&63, idx&63, moves)==0)
+                    w.dtz[idx].store(0, std::memory_order_relaxed); // mated
+            }
+        }
+    });
+
+    // DTZ: pass k settles the positions whose distance is k. Only children settled in earlier
+    // passes (dtz <= k-1) are used, which keeps the in-place update exact.
+    for(uint16_t k=1; ; k++){
+        std::atomic<bool> pending{false};
+        RunParallel(threads, [&](int lo, int hi){
+            bool left = false;
+            for(int idx=lo; idx<hi; idx++){
+                if(state(idx)!=TBS_WIN || dtzOf(idx)!=DTZ_UNKNOWN) continue;
+                int stm, sk, wk, ps;
+                SplitEndgameIndex(idx, stm, sk, wk, ps);
+                bool settled = false;
+                if(stm==0){
+                    TBMove moves[40];
+                    int n = StrongMoves(kind, sk, wk, ps, moves);
+                    for(int i=0; i<n && !settled; i++){
+                        const TBMove &m = moves[i];
+                        if(m.promoTable>=0) settled = k==1 && promoWins(m);
+                        else if(state(m.child)==TBS_WIN) settled = m.zeroing ? k==1 : dtzOf(m.child) <= k-1;
+                    }
+                } else {
+                    int moves[8];
+                    int n = WeakMoves(pt, sk, wk, ps, moves);
+                    settled = true;
+                    for(int i=0; i<n && settled; i++) settled = dtzOf(moves[i]) <= k-1;
+                }
+                if(settled) w.dtz[idx].store(k, std::memory_order_relaxed);
+                else left = true;
+            }
+            if(left) pending = true;
+        });
+        if(!pending || k==DTZ_UNKNOWN-1) break;
+    }
+}
+
+static void PutLE(unsigned char *p, uint32_t v, int n){
+    for(int i=0;i<n;i++){ p[i] = (unsigned char)(v & 0xFF); v >>= 8; }
+}
+
+static bool WriteTable(const std::string &dir, TBKind kind, const TBWork &w){
+    unsigned char header[TB_HEADER] = {};
+    std::vector<unsigned char> wdl(TB_SIZE/4), dtz((size_t)TB_SIZE*2);
+    for(int idx=0; idx<TB_SIZE; idx++){
+        int s = w.st[idx], v;
+        if(s==TBS_INVALID) v = 3;
+        else if(s==TBS_WIN) v = (idx>>18)==0 ? 1 : 2; // strong to move wins, weak to move loses
+        else v = 0;
+        wdl[idx>>2] |= (unsigned char)(v << ((idx&3)*2));
+        PutLE(&dtz[(size_t)idx*2], w.dtz[idx], 2);
+    }
+    std::string base = dir + "/" + TB_NAME[kind];
+    for(int z=0; z<2; z++){
+        PutLE(header, z ? TBZ_MAGIC : TBW_MAGIC, 4);
+        PutLE(header+4, (uint32_t)kind, 4);
+        PutLE(header+8, (uint32_t)TB_SIZE, 4);
+        const std::vector<unsigned char> &body = z ? dtz : wdl;
+        FILE *f = std::fopen((base + (z ? ".tbz" : ".tbw")).c_str(), "wb");
+        if(!f) return false;
+        bool ok = std::fwrite(header, 1, TB_HEADER, f)==TB_HEADER && std::fwrite(body.data(), 1, body.size(), f)==body.size();
+        if(std::fclose(f)!=0 || !ok) return false;
+    }
+    return true;
+}
+
+bool GenerateTablebases(const std::string &dir){
+    int threads = (int)std::max(1u, std::thread::hardware_concurrency());
+    TBWork work[TB_COUNT];
+    for(int k=0; k<TB_COUNT; k++){ // KPvK last: its promotions look up the others
+        GenerateTable((TBKind)k, work, threads);
+        if(!WriteTable(dir, (TBKind)k, work[k])) return false;
+    }
+    return true;
+}
+
+// ---------------- probing ----------------
+
+struct TBFile {
+    std::once_flag once;
+    MappedFile map;
+    bool ok = false;
+};
+struct TBSet {
+    std::string dir;
+    TBFile wdl[TB_COUNT], dtz[TB_COUNT];
+};
+static std::unique_ptr<TBSet> tbSetOwner;
+static std::atomic<TBSet*> tbSetG{nullptr};
+
+// "" disables probing. Mappings of the previous directory are released, so only call this
+// while no search is running.
+void SetTablebasePath(const std::string &dir){
+    tbSetG = nullptr;
+    tbSetOwner.reset();
+    if(dir.empty()) return;
+    tbSetOwner.reset(new TBSet);
+    tbSetOwner->dir = dir;
+    tbSetG = tbSetOwner.get();
+}
+
+bool TablebasesEnabled(){ return tbSetG.load() != nullptr; }
+
+static uint32_t ReadLE32(const unsigned char *p){
+    return p[0] | p[1]<<8 | p[2]<<16 | (uint32_t)p[3]<<24;
+}
+
+static const unsigned char *TableData(TBSet *set, TBKind kind, bool dtz){
+    TBFile &f = dtz ? set->dtz[kind] : set->wdl[kind];
+    std::call_once(f.once, [&](){
+        std::string path = set->dir + "/" + TB_NAME[kind] + (dtz ? ".tbz" : ".tbw");
+        size_t body = dtz ? (size_t)TB_SIZE*2 : TB_SIZE/4;
+        f.ok = MapFile(f.map, path) && f.map.size==TB_HEADER+body
+            && ReadLE32(f.map.data)==(dtz ? TBZ_MAGIC : TBW_MAGIC)
+            && ReadLE32(f.map.data+4)==(uint32_t)kind && ReadLE32(f.map.data+8)==(uint32_t)TB_SIZE;
+        if(!f.ok) UnmapFile(f.map);
+    });
+    return f.ok ? f.map.data + TB_HEADER : nullptr;
+}
+
+// table and index of a position, or false if no table covers its material.
+// kingsOnly is set for bare kings, which need no table.
+static bool LocateTB(const Piece b[8][8], Color side, TBKind &kind, int &idx, bool &kingsOnly){
+    int count = 0, kings[3] = {-1,-1,-1}, ps = -1;
+    PieceType pt = PT_NONE;
+    Color strong = C_NONE;
+    for(int y=0;y<8;y++) for(int x=0;x<8;x++){
+        const Piece &p = b[y][x];
+        if(p.type==PT_NONE) continue;
+        if(++count > 3) return false;
+        if(p.type==PT_KING) kings[p.color] = y*8+x;
+        else { pt = p.type; strong = p.color; ps = y*8+x; }
+    }
+    if(kings[C_WHITE]<0 || kings[C_BLACK]<0) return false;
+    kingsOnly = count==2;
+    if(kingsOnly) return true;
+    int k = 0;
+    while(k<TB_COUNT && TB_PIECE[k]!=pt) k++;
+    if(k==TB_COUNT) return false;
+    kind = (TBKind)k;
+    auto norm = [&](int sq){ return strong==C_WHITE ? sq : (7-(sq>>3))*8 + (sq&7); };
+    idx = EndgameIndex(side==strong ? 0 : 1, norm(kings[strong]), norm(kings[Opp(strong)]), norm(ps));
+    return true;
+}
+
+bool ProbeWDL(const Piece b[8][8], Color side, int &wdl){
+    TBSet *set = tbSetG.load(std::memory_order_acquire);
+    if(!set) return false;
+    TBKind kind;
+    int idx;
+    bool kingsOnly;
+    if(!LocateTB(b, side, kind, idx, kingsOnly)) return false;
+    if(kingsOnly){ wdl = 0; return true; }
+    const unsigned char *data = TableData(set, kind, false);
+    if(!data) return false;
+    int v = (data[idx>>2] >> ((idx&3)*2)) & 3;
+    if(v==3) return false;
+    wdl = v==1 ? 1 : v==2 ? -1 : 0;
+    return true;
+}
+
+bool ProbeDTZ(const Piece b[8][8], Color side, int &wdl, int &dtz){
+    if(!ProbeWDL(b, side, wdl)) return false;
+    dtz = 0;
+    if(wdl==0) return true;
+    TBKind kind;
+    int idx;
+    bool kingsOnly;
+    LocateTB(b, side, kind, idx, kingsOnly);
+    const unsigned char *data = TableData(tbSetG.load(), kind, true);
+    if(!data) return false;
+    dtz = data[(size_t)idx*2] | data[(size_t)idx*2+1] << 8;
+    return true;
+}
+
+// Score every root move from the tables: wins by how soon they reach a zeroing move, losses
+// by how long they hold out. A win that cannot zero before the 50-move rule is scored as a
+// draw. Returns false unless every root move could be probed.
+bool TablebaseRootMoves(const Position &pos, std::vector<std::pair<Move,int>> &scored){
+    scored.clear();
+    if(!TablebasesEnabled()) return false;
+    for(auto &m : GenerateLegalMoves(pos.board, pos.side, pos.lastMove)){
+        Position child = pos;
+        ApplyMove(child, m);
+        int wdl, dtz;
+        if(!ProbeDTZ(child.board, child.side, wdl, dtz)) return false;
+        bool zeroing = child.halfmoveClock==0;
+        int plies = zeroing ? 1 : dtz+1;           // to the next zeroing move, from here
+        bool inTime = (zeroing ? 0 : pos.halfmoveClock) + plies <= 100;
+        int score = 0;
+        if(wdl < 0) score = inTime ? TB_WIN_SCORE - plies : 0;      // opponent loses
+        else if(wdl > 0) score = inTime ? -TB_WIN_SCORE + plies : 0;
+        scored.push_back({m, score});
+    }
+    std::stable_sort(scored.begin(), scored.end(), [](const std::pair<Move,int> &a, const std::pair<Move,int> &c){ return a.second > c.second; });
+    return !scored.empty();
+}
+
+//   chess tbgen [--dir DIR]          generate all 3-piece tables into DIR
+//   chess tbprobe [--dir DIR] FEN    WDL/DTZ of a position and its moves ranked by the tables
+int RunTablebaseTool(int argc, char **argv){
+    std::string cmd = argv[1], dir = ".", fen;
+    for(int i=2; i<argc; i++){
+        std::string a = argv[i];
+        if(a=="--dir" && i+1<argc) dir = argv[++i];
+        else if(a.size()>2 && a.compare(0, 2, "--")==0){ std::fprintf(stderr, "%s: unknown option %s\n", cmd.c_str(), a.c_str()); return 1; }
+        else fen += (fen.empty() ? "" : " ") + a;
+    }
+    if(cmd=="tbgen"){
+        int64_t t0 = NowMs();
+        if(!GenerateTablebases(dir)){ std::fprintf(stderr, "tbgen: cannot write to %s\n", dir.c_str()); return 1; }
+        std::printf("generated %d tables in %lld ms\n", (int)TB_COUNT, (long long)(NowMs()-t0));
+        return 0;
+    }
+    Position pos;
+    if(!ParseFEN(fen, pos)){ std::fprintf(stderr, "tbprobe: invalid fen\n"); return 1; }
+    SetTablebasePath(dir);
+    int wdl, dtz;
+    if(!ProbeDTZ(pos.board, pos.side, wdl, dtz)){ std::printf("not in the tablebases\n"); return 0; }
+    std::printf("wdl %d dtz %d\n", wdl, dtz);
+    std::vector<std::pair<Move,int>> scored;
+    if(TablebaseRootMoves(pos, scored))
+        for(auto &s : scored) std::printf("%s %d\n", MoveToUci(pos.board, s.first).c_str(), s.second);
+    return 0;
+}
@@ -0,0 +1,363 @@
+#include "chess.h"
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+// Evaluation tuning in two steps.
+//
+//   chess gendata -o FILE [--games N] [--nodes N] [--random-plies N] [--seed N]
+//                 [--pgn FILE] [--skip-plies N] [--per-game N] [--threads N]
+//
+// writes quiet positions labelled with the result of the game they came from, as EPD lines
+// with a c9 opcode ("1-0", "0-1", "1/2-1/2"). Games are self-play with a node limit after a
+// few random plies, or are read from a PGN file. A position is quiet when the side to move is
+// not in check and the quiescence search agrees with the static evaluation.
+//
+//   chess tune DATA [-o FILE] [--init FILE] [--epochs N] [--lr X] [--k K] [--threads N]
+//
+// fits the evaluation weights to the labels (Texel's method): the evaluation is linear in the
+// weights, so every position is reduced once to a short list of (weight, count) pairs and the
+// mean squared error of sigmoid(eval) against the result is minimised by full-batch gradient
+// descent (Adam), the batch split over threads. The result is a weights file for
+// LoadEvalWeights, the match runner (weights=) or the UCI EvalFile option. DATA may also be
+// the positions packed with "chess pack", which are read straight from the mapped file.
+
+// ---------------- training data ----------------
+
+struct GenOptions {
+    int games = 1000;
+    uint64_t nodes = 5000;
+    int randomPlies = 8;
+    int skipPlies = 8;
+    int perGame = 10;      // positions kept per game (0 = every quiet one)
+    int maxPlies = 400;
+    int decidedScore = 1500; // the game is scored as won once the search sees this much
+    uint32_t seed = 1;
+};
+
+static bool IsQuiet(const Position &pos){
+    if(InCheck(pos.board, pos.side)) return false;
+    int known;
+    if(ProbeBitbase(pos.board, pos.side, known)) return false;
+    Piece b[8][8];
+    CopyBoard(pos.board, b);
+    return Quiescence(b, pos.side, pos.lastMove, -MATE_SCORE, MATE_SCORE) == EvalForSide(pos.board, pos.side);
+}
+
+// label the quiet positions of one game and keep a random sample of them
+static std::string LabelGame(const GenOptions &opt, const std::vector<Position> &positions, const std::string &result, std::mt19937 &gen){
+    std::vector<const Position*> quiet;
+    for(size_t i=opt.skipPlies; i<positions.size(); i++)
+        if(IsQuiet(positions[i])) quiet.push_back(&positions[i]);
+    std::shuffle(quiet.begin(), quiet.end(), gen);
+    if(opt.perGame>0 && (int)quiet.size()>opt.perGame) quiet.resize(opt.perGame);
+    std::string out;
+    for(auto *p : quiet) out += ToFEN(*p) + " c9 \"" + result + "\";\n";
+    return out;
+}
+
+static std::string SelfPlayGame(const GenOptions &opt, SearchContext &ctx, std::mt19937 &gen){
+    Position pos;
+    SetStartPosition(pos);
+    GameHistory history;
+    ResetHistory(history, pos);
+    std::vector<Position> positions;
+    std::string result, reason;
+    for(int ply=0; ; ply++){
+        if(GameEnded(pos, history, result, reason)) break;
+        if(ply>=opt.maxPlies){ result = "1/2-1/2"; break; }
+        Move m;
+        if(ply<opt.randomPlies){
+            auto legal = GenerateLegalMoves(pos.board, pos.side, pos.lastMove);
+            m = legal[gen() % legal.size()];
+        } else {
+            positions.push_back(pos);
+            SearchLimits limits;
+            limits.nodes = opt.nodes;
+            PrepareSearch(ctx, limits);
+            SearchResult r = Think(ctx, pos);
+            // a decided position would only add noise to the labels from here on
+            if(IsMateScore(r.score) || std::abs(r.score)>=opt.decidedScore){
+                bool whiteWins = (r.score>0) == (pos.side==C_WHITE);
+                result = whiteWins ? "1-0" : "0-1";
+                break;
+            }
+            m = r.best;
+        }
+        PlayMove(history, pos, m);
+    }
+    return LabelGame(opt, positions, result, gen);
+}
+
+static std::string PgnGamePositions(const GenOptions &opt, const PgnGame &game, std::mt19937 &gen){
+    if(game.result!="1-0" && game.result!="0-1" && game.result!="1/2-1/2") return "";
+    Position pos;
+    std::vector<Move> moves;
+    ReplayPgnGame(game, pos, moves);
+    std::vector<Position> positions;
+    for(auto &m : moves){
+        positions.push_back(pos);
+        ApplyMove(pos, m);
+    }
+    return LabelGame(opt, positions, game.result, gen);
+}
+
+int RunGenData(int argc, char **argv){
+    GenOptions opt;
+    int threads = (int)std::max(1u, std::thread::hardware_concurrency());
+    std::string output, pgnPath;
+    for(int i=2; i<argc; i++){
+        std::string a = argv[i];
+        if(a=="-o" && i+1<argc) output = argv[++i];
+        else if(a=="--games" && i+1<argc) opt.games = std::max(1, std::atoi(argv[++i]));
+        else if(a=="--nodes" && i+1<argc) opt.nodes = std::strtoull(argv[++i], nullptr, 10);
+        else if(a=="--random-plies" && i+1<argc) opt.randomPlies = std::max(0, std::atoi(argv[++i]));
+        else if(a=="--skip-plies" && i+1<argc) opt.skipPlies = std::max(0, std::atoi(argv[++i]));
+        else if(a=="--per-game" && i+1<argc) opt.perGame = std::max(0, std::atoi(argv[++i]));
+        else if(a=="--seed" && i+1<argc) opt.seed = (uint32_t)std::strtoul(argv[++i], nullptr, 10);
+        else if(a=="--pgn" && i+1<argc) pgnPath = argv[++i];
+        else if(a=="--threads" && i+1<argc) threads = std::max(1, std::atoi(argv[++i]));
+        else { std::fprintf(stderr, "gendata: unknown option %s\n", a.c_str()); return 1; }
+    }
+    if(output.empty()){ std::fprintf(stderr, "gendata: -o FILE is required\n"); return 1; }
+    FILE *out = std::fopen(output.c_str(), "w");
+    if(!out){ std::fprintf(stderr, "gendata: cannot write %s\n", output.c_str()); return 1; }
+    std::ifstream pgn;
+    if(!pgnPath.empty()){
+        pgn.open(pgnPath, std::ios::binary);
+        if(!pgn){ std::fprintf(stderr, "gendata: cannot open %s\n", pgnPath.c_str()); std::fclose(out); return 1; }
+    }
+
+    // every game gets its own random stream: the same seed gives the same positions whatever
+    // the thread count (in a different order)
+    int64_t t0 = NowMs();
+    std::mutex outMutex;
+    std::atomic<int> nextGame{0};
+    std::atomic<uint64_t> positions{0}, games{0};
+    BoundedQueue<std::pair<int,PgnGame>> queue((size_t)threads * 16);
+    auto emit = [&](const std::string &text){
+        std::lock_guard<std::mutex> lk(outMutex);
+        std::fwrite(text.data(), 1, text.size(), out);
+        positions += std::count(text.begin(), text.end(), '\n');
+        games++;
+    };
+    std::vector<std::thread> workers;
+    for(int t=0; t<threads; t++){
+        workers.emplace_back([&](){
+            TranspositionTable table;
+            ResizeTT(table, 16);
+            SearchContext ctx;
+            ctx.tt = &table;
+            ctx.parallelRoot = false;
+            if(pgnPath.empty()){
+                int n;
+                while((n = nextGame++) < opt.games){
+                    std::mt19937 gen(opt.seed * 1000003u + n);
+                    ClearTT(table);
+                    emit(SelfPlayGame(opt, ctx, gen));
+                }
+            } else {
+                std::pair<int,PgnGame> job;
+                while(queue.Pop(job)){
+                    std::mt19937 gen(opt.seed * 1000003u + job.first);
+                    emit(PgnGamePositions(opt, job.second, gen));
+                }
+            }
+        });
+    }
+    if(!pgnPath.empty()){
+        PgnGame game;
+        int n = 0;
+        while(ReadPgnGame(pgn, game)) queue.Push({n++, game});
+    }
+    queue.Close();
+    for(auto &w : workers) w.join();
+    bool ok = std::fclose(out)==0;
+    std::fprintf(stderr, "gendata: %llu games, %llu positions, %lld ms\n",
+                 (unsigned long long)games.load(), (unsigned long long)positions.load(), (long long)(NowMs()-t0));
+    return ok ? 0 : 1;
+}
+
+// ---------------- tuner ----------------
+
+struct TuneFeature {
+    uint16_t param;
+    int16_t count;
+};
+
+// positions reduced to their features, in flat arrays
+struct TuneData {
+    std::vector<float> results;        // 1, 0.5 or 0 for White
+    std::vector<uint32_t> begin;       // first feature of each position, plus an end marker
+    std::vector<TuneFeature> features;
+};
+
+static bool ParseLabelled(const std::string &line, Position &pos, float &result){
+    std::vector<std::pair<std::string,std::string>> ops;
+    if(!ParseEPD(line, pos, &ops)) return false;
+    for(auto &op : ops){
+        if(op.first!="c9") continue;
+        if(op.second=="1-0") result = 1.0f;
+        else if(op.second=="0-1") result = 0.0f;
+        else if(op.second=="1/2-1/2") result = 0.5f;
+        else return false;
+        return true;
+    }
+    return false;
+}
+
+// a well-formed packed record with a known result
+static bool UnpackLabelled(const PackedPosition &r, Position &pos, float &result){
+    PackedResult res = GetPackedResult(r);
+    if(res==PR_UNKNOWN || !UnpackPosition(r, pos)) return false;
+    result = res==PR_WHITE_WINS ? 1.0f : res==PR_BLACK_WINS ? 0.0f : 0.5f;
+    return true;
+}
+
+static bool LoadTuneData(const std::string &path, int threads, TuneData &data){
+    PackedFile packed;
+    std::vector<std::string> lines;
+    if(!OpenPackedFile(packed, path)){
+        std::ifstream in(path, std::ios::binary);
+        if(!in) return false;
+        std::string line;
+        while(std::getline(in, line)) if(!line.empty() && line[0]!='#') lines.push_back(line);
+    }
+    size_t total = packed.records ? packed.count : lines.size();
+
+    // each thread converts a contiguous slice; the slices are appended in order
+    std::vector<TuneData> parts(threads);
+    std::vector<std::thread> pool;
+    for(int t=0; t<threads; t++){
+        pool.emplace_back([&, t](){
+            TuneData &d = parts[t];
+            std::vector<std::pair<int,int>> feats;
+            size_t lo = total*t/threads, hi = total*(t+1)/threads;
+            for(size_t i=lo; i<hi; i++){
+                Position pos;
+                float result;
+                bool ok = packed.records ? UnpackLabelled(packed.records[i], pos, result) : ParseLabelled(lines[i], pos, result);
+                if(!ok) continue;
+                EvalFeatures(pos.board, feats);
+                d.results.push_back(result);
+                d.begin.push_back((uint32_t)d.features.size());
+                for(auto &f : feats) d.features.push_back({(uint16_t)f.first, (int16_t)f.second});
+            }
+        });
+    }
+    for(auto &th : pool) th.join();
+    for(auto &d : parts){
+        uint32_t base = (uint32_t)data.features.size();
+        for(auto b : d.begin) data.begin.push_back(base + b);
+        data.results.insert(data.results.end(), d.results.begin(), d.results.end());
+        data.features.insert(data.features.end(), d.features.begin(), d.features.end());
+    }
+    data.begin.push_back((uint32_t)data.features.size());
+    return true;
+}
+
+// Mean squared error of the predicted score over the data; with grad set, also adds its
+// gradient with respect to every weight. The work is split over threads in contiguous slices.
+static double TuneError(const TuneData &data, const std::vector<double> &w, double k, int threads, std::vector<double> *grad){
+    const size_t n = data.results.size();
+    const double scale = k * std::log(10.0) / 400.0;
+    std::vector<double> errors(threads, 0.0);
+    std::vector<std::vector<double>> grads(threads);
+    std::vector<std::thread> pool;
+    for(int t=0; t<threads; t++){
+        pool.emplace_back([&, t](){
+            std::vector<double> &g = grads[t];
+            if(grad) g.assign(w.size(), 0.0);
+            double err = 0;
+            for(size_t i=n*t/threads, hi=n*(t+1)/threads; i<hi; i++){
+                const TuneFeature *f = &data.features[data.begin[i]];
+                const TuneFeature *end = &data.features[0] + data.begin[i+1];
+                double eval = 0;
+                for(const TuneFeature *p=f; p<end; p++) eval += w[p->param] * p->count;
+                double s = 1.0 / (1.0 + std::exp(-scale * eval));
+                double diff = s - data.results[i];
+                err += diff * diff;
+                if(grad){
+                    double d = 2.0 * diff * s * (1.0 - s) * scale;
+                    for(const TuneFeature *p=f; p<end; p++) g[p->param] += d * p->count;
+                }
+            }
+            errors[t] = err;
+        });
+    }
+    for(auto &th : pool) th.join();
+    double err = 0;
+    for(double e : errors) err += e;
+    if(grad){
+        grad->assign(w.size(), 0.0);
+        for(auto &g : grads) for(size_t j=0; j<g.size(); j++) (*grad)[j] += g[j] / n;
+    }
+    return err / n;
+}
+
+// the sigmoid scale that best fits the current weights (golden-section search)
+static double FitK(const TuneData &data, const std::vector<double> &w, int threads){
+    double lo = 0.1, hi = 4.0;
+    const double phi = (std::sqrt(5.0) - 1) / 2;
+    double a = hi - phi*(hi-lo), b = lo + phi*(hi-lo);
+    double ea = TuneError(data, w, a, threads, nullptr), eb = TuneError(data, w, b, threads, nullptr);
+    for(int i=0; i<40; i++){
+        if(ea < eb){ hi = b; b = a; eb = ea; a = hi - phi*(hi-lo); ea = TuneError(data, w, a, threads, nullptr); }
+        else { lo = a; a = b; ea = eb; b = lo + phi*(hi-lo); eb = TuneError(data, w, b, threads, nullptr); }
+    }
+    return (lo + hi) / 2;
+}
+
+int RunTune(int argc, char **argv){
+    int threads = (int)std::max(1u, std::thread::hardware_concurrency());
+    int epochs = 1000;
+    double lr = 1.0, k = 0;
+    std::string dataPath, output = "weights.txt", init;
+    for(int i=2; i<argc; i++){
+        std::string a = argv[i];
+        if(a=="-o" && i+1<argc) output = argv[++i];
+        else if(a=="--init" && i+1<argc) init = argv[++i];
+        else if(a=="--epochs" && i+1<argc) epochs = std::max(1, std::atoi(argv[++i]));
+        else if(a=="--lr" && i+1<argc) lr = std::atof(argv[++i]);
+        else if(a=="--k" && i+1<argc) k = std::atof(argv[++i]);
+        else if(a=="--threads" && i+1<argc) threads = std::max(1, std::atoi(argv[++i]));
+        else if(!a.empty() && a[0]=='-'){ std::fprintf(stderr, "tune: unknown option %s\n", a.c_str()); return 1; }
+        else dataPath = a;
+    }
+    EvalWeights weights = DefaultEvalWeights();
+    if(!init.empty() && !LoadEvalWeights(init, weights)){ std::fprintf(stderr, "tune: cannot load %s\n", init.c_str()); return 1; }
+
+    int64_t t0 = NowMs();
+    TuneData data;
+    if(dataPath.empty() || !LoadTuneData(dataPath, threads, data)){ std::fprintf(stderr, "tune: cannot read %s\n", dataPath.c_str()); return 1; }
+    if(data.results.empty()){ std::fprintf(stderr, "tune: no labelled positions in %s\n", dataPath.c_str()); return 1; }
+    std::fprintf(stderr, "tune: %zu positions, %zu features, loaded in %lld ms\n",
+                 data.results.size(), data.features.size(), (long long)(NowMs()-t0));
+
+    std::vector<double> w(EVAL_PARAM_COUNT);
+    for(int i=0; i<EVAL_PARAM_COUNT; i++) w[i] = EvalParam(weights, i);
+    if(k<=0) k = FitK(data, w, threads);
+    std::fprintf(stderr, "tune: k %.4f, initial error %.6f\n", k, TuneError(data, w, k, threads, nullptr));
+
+    // Adam: a per-weight step size copes with counts that range from 1 (a piece-square entry)
+    // to dozens (mobility)
+    const double beta1 = 0.9, beta2 = 0.999, eps = 1e-8;
+    std::vector<double> m(w.size(), 0.0), v(w.size(), 0.0), grad;
+    for(int epoch=1; epoch<=epochs; epoch++){
+        double err = TuneError(data, w, k, threads, &grad);
+        double c1 = 1 - std::pow(beta1, epoch), c2 = 1 - std::pow(beta2, epoch);
+        for(size_t j=0; j<w.size(); j++){
+            m[j] = beta1*m[j] + (1-beta1)*grad[j];
+            v[j] = beta2*v[j] + (1-beta2)*grad[j]*grad[j];
+            w[j] -= lr * (m[j]/c1) / (std::sqrt(v[j]/c2) + eps);
+        }
+        if(epoch%50==0 || epoch==epochs)
+            std::fprintf(stderr, "tune: epoch %d error %.6f (%lld ms)\n", epoch, err, (long long)(NowMs()-t0));
+    }
+
+    for(int i=0; i<EVAL_PARAM_COUNT; i++) EvalParam(weights, i) = (int)std::lround(w[i]);
+    if(!SaveEvalWeights(output, weights)){ std::fprintf(stderr, "tune: cannot write %s\n", output.c_str()); return 1; }
+    std::fprintf(stderr, "tune: wrote %s\n", output.c_str());
+    return 0;
+}
@@ -0,0 +1,235 @@
+#include "chess.h"
+#include <iostream>
+#include <sstream>
+#include <mutex>
+
+// UCI front-end: lets external GUIs and tools drive the engine over stdin/stdout.
+// Searches run on a background thread so "stop" and "ponderhit" are handled while thinking.
+
+static std::mutex outMutex;
+static SearchContext uciCtx;
+static std::thread searchThread;
+static Position uciPos;
+static int multiPVOption = 1;
+static int skillOption = SKILL_LEVELS;
+static bool ownBookOption = false;
+static std::string hashFileOption;
+static int hashMbOption = 16;
+static std::string sharedHashOption; // segment name, empty for a private table
+
+static void Send(const std::string &line){
+    std::lock_guard<std::mutex> lk(outMutex);
+    std::cout << line << std::endl;
+}
+
+static std::string FormatPV(const Position &pos, const std::vector<Move> &pv){
+    std::string s;
+    Position p = pos;
+    for(auto &m : pv){
+        if(!s.empty()) s += ' ';
+        s += MoveToUci(p.board, m);
+        ApplyMove(p, m);
+    }
+    return s;
+}
+
+static std::string FormatScore(int score){
+    if(IsMateScore(score)) return "mate " + std::to_string(MateInMoves(score));
+    return "cp " + std::to_string(score);
+}
+
+static void WaitSearch(){
+    if(searchThread.joinable()) searchThread.join();
+}
+
+static void StopSearch(){
+    uciCtx.stop = true;
+    WaitSearch();
+}
+
+// position [startpos | fen <fen>] [moves m1 m2 ...]
+static void CmdPosition(std::istringstream &is){
+    std::string tok, fen;
+    is >> tok;
+    if(tok=="startpos"){
+        SetStartPosition(uciPos);
+        is >> tok;
+    } else if(tok=="fen"){
+        while(is >> tok && tok!="moves") fen += (fen.empty() ? "" : " ") + tok;
+        if(!ParseFEN(fen, uciPos)){ Send("info string invalid fen"); return; }
+    } else return;
+    if(tok!="moves") return;
+    while(is >> tok){
+        Move m;
+        if(!ParseUciMove(uciPos, tok, m)){ Send("info string illegal move " + tok); return; }
+        ApplyMove(uciPos, m);
+    }
+}
+
+static void CmdGo(std::istringstream &is){
+    StopSearch();
+    SearchLimits limits;
+    int wtime=0, btime=0, winc=0, binc=0, movestogo=0;
+    std::string tok;
+    while(is >> tok){
+        if(tok=="depth") is >> limits.depth;
+        else if(tok=="movetime") is >> limits.movetimeMs;
+        else if(tok=="nodes") is >> limits.nodes;
+        else if(tok=="wtime") is >> wtime;
+        else if(tok=="btime") is >> btime;
+        else if(tok=="winc") is >> winc;
+        else if(tok=="binc") is >> binc;
+        else if(tok=="movestogo") is >> movestogo;
+        else if(tok=="infinite") limits.infinite = true;
+        else if(tok=="ponder") limits.ponder = true;
+        else if(tok=="mate") is >> limits.mate;
+    }
+    int left = uciPos.side==C_WHITE ? wtime : btime;
+    int inc = uciPos.side==C_WHITE ? winc : binc;
+    if(limits.movetimeMs==0 && left>0) limits.movetimeMs = AllocateMoveTime(left, inc, movestogo);
+
+    // book moves answer at once; analysis ("infinite") and pondering always search
+    Move bookMove;
+    if(ownBookOption && !limits.infinite && !limits.ponder && ProbeBook(uciPos, bookMove)){
+        Send("bestmove " + MoveToUci(uciPos.board, bookMove));
+        return;
+    }
+
+    limits.multiPV = multiPVOption;
+    limits.skill = skillOption<SKILL_LEVELS ? skillOption : 0;
+    PrepareSearch(uciCtx, limits);
+    Position pos = uciPos;
+    searchThread = std::thread([pos](){
+        if(uciCtx.limits.mate > 0){
+            MateResult mr = SolveMate(uciCtx, pos, uciCtx.limits.mate, (int)std::max(1u, std::thread::hardware_concurrency()));
+            if(mr.moves > 0){
+                Send("info depth " + std::to_string(2*mr.moves-1) + " score mate " + std::to_string(mr.moves) +
+                     " nodes " + std::to_string(uciCtx.nodes.load()) + " time " + std::to_string(NowMs()-uciCtx.startMs) +
+                     " pv " + FormatPV(pos, mr.pv));
+                Send("bestmove " + MoveToUci(pos.board, mr.best));
+                return;
+            }
+            // no mate within the limit: answer with an ordinary search of the same length
+            Send("info string no mate in " + std::to_string(uciCtx.limits.mate));
+            SearchLimits limits = uciCtx.limits;
+            limits.mate = 0;
+            limits.depth = 2*uciCtx.limits.mate;
+            if(!uciCtx.stop) PrepareSearch(uciCtx, limits);
+        }
+        SearchResult res = Think(uciCtx, pos, [&pos](const SearchInfo &info){
+            uint64_t nps = info.timeMs>0 ? info.nodes*1000/info.timeMs : 0;
+            Send("info depth " + std::to_string(info.depth) + " multipv " + std::to_string(info.multiPV) +
+                 " score " + FormatScore(info.score) +
+                 " nodes " + std::to_string(info.nodes) + " nps " + std::to_string(nps) +
+                 " time " + std::to_string(info.timeMs) + " pv " + FormatPV(pos, info.pv));
+        });
+        std::string line = "bestmove " + MoveToUci(pos.board, res.best);
+        if(res.ponder.fx!=-1){
+            Position after = pos;
+            ApplyMove(after, res.best);
+            line += " ponder " + MoveToUci(after.board, res.ponder);
+        }
+        Send(line);
+    });
+}
+
+// setoption name <id> [value <x>]
+static void CmdSetOption(std::istringstream &is){
+    std::string tok, name, value;
+    is >> tok;
+    while(is >> tok && tok!="value") name += (name.empty() ? "" : " ") + tok;
+    std::getline(is >> std::ws, value);
+    if(name=="MultiPV") multiPVOption = std::max(1, std::min(64, std::atoi(value.c_str())));
+    else if(name=="Skill Level") skillOption = std::max(1, std::min(SKILL_LEVELS, std::atoi(value.c_str())));
+    else if(name=="Hash" || name=="SharedHash"){
+        StopSearch();
+        if(name=="Hash") hashMbOption = std::max(1, std::atoi(value.c_str()));
+        else sharedHashOption = value=="<empty>" ? "" : value;
+        // a shared table takes the size of the segment if another process made it first
+        if(sharedHashOption.empty()) SetHashSize(hashMbOption);
+        else if(!AttachSharedTT(sharedHashOption, hashMbOption)){
+            Send("info string cannot attach shared hash " + sharedHashOption + ", using a private table");
+            sharedHashOption.clear();
+            SetHashSize(hashMbOption);
+        }
+        Send("info string hash " + DescribeTT());
+    }
+    else if(name=="LargePages" || name=="ParallelInit"){
+        StopSearch();
+        (name=="LargePages" ? largePagesG : parallelInitG) = value=="true";
+        if(sharedHashOption.empty()){ SetHashSize(hashMbOption); Send("info string hash " + DescribeTT()); }
+    }
+    else if(name=="ThreadBinding") threadBindingG = value=="cores" ? BIND_CORES : value=="nodes" ? BIND_NODES : BIND_NONE;
+    else if(name=="TablebasePath"){ StopSearch(); SetTablebasePath(value=="<empty>" ? "" : value); }
+    else if(name=="BitbasePath"){
+        StopSearch();
+        if(!LoadBitbases(value=="<empty>" ? "." : value)) Send("info string no complete bitbases in " + value);
+    }
+    else if(name=="OwnBook") ownBookOption = value=="true";
+    else if(name=="HashFile") hashFileOption = value=="<empty>" ? "" : value;
+    else if(name=="SaveHash" || name=="LoadHash"){
+        StopSearch();
+        bool save = name=="SaveHash";
+        if(hashFileOption.empty()) Send("info string set HashFile first");
+        else if(save ? SaveTT(hashFileOption) : LoadTT(hashFileOption)) Send("info string hash " + std::string(save ? "saved to " : "loaded from ") + hashFileOption);
+        else Send("info string cannot " + std::string(save ? "save hash to " : "load hash from ") + hashFileOption);
+    }
+    else if(name=="NNUEFile"){
+        StopSearch();
+        if(!SetNnue(value=="<empty>" ? "" : value)) Send("info string cannot load network " + value);
+    }
+    else if(name=="EvalFile"){
+        StopSearch();
+        if(value.empty() || value=="<empty>") evalWeightsG = DefaultEvalWeights();
+        else if(!LoadEvalWeights(value, evalWeightsG)) Send("info string cannot load weights " + value);
+    }
+    else if(name=="BookFile"){
+        if(value.empty() || value=="<empty>") CloseBook();
+        else if(!OpenBook(value)) Send("info string cannot open book " + value);
+    }
+    // "Ponder" needs no action: pondering is driven by "go ponder"
+}
+
+int RunUci(){
+    SetStartPosition(uciPos);
+    LoadBitbases("."); // whatever "chess bitbase --generate" left in the working directory
+    std::string line;
+    while(std::getline(std::cin, line)){
+        std::istringstream is(line);
+        std::string cmd;
+        is >> cmd;
+        if(cmd=="uci"){
+            Send("id name Chess");
+            Send("id author hananel42");
+            Send("option name Ponder type check default false");
+            Send("option name Hash type spin default 16 min 1 max 65536");
+            Send("option name MultiPV type spin default 1 min 1 max 64");
+            Send("option name Skill Level type spin default " + std::to_string(SKILL_LEVELS) + " min 1 max " + std::to_string(SKILL_LEVELS));
+            Send("option name OwnBook type check default false");
+            Send("option name BookFile type string default <empty>");
+            Send("option name TablebasePath type string default <empty>");
+            Send("option name BitbasePath type string default <empty>");
+            Send("option name EvalFile type string default <empty>");
+            Send("option name NNUEFile type string default <empty>");
+            Send("option name LargePages type check default true");
+            Send("option name ParallelInit type check default false");
+            Send("option name ThreadBinding type combo default none var none var cores var nodes");
+            Send("option name SharedHash type string default <empty>");
+            Send("option name HashFile type string default <empty>");
+            Send("option name SaveHash type button");
+            Send("option name LoadHash type button");
+            Send("uciok");
+            Send("info string hash " + DescribeTT()); // after the handshake, which wants nothing before id
+        }
+        else if(cmd=="isready") Send("readyok");
+        else if(cmd=="ucinewgame"){ StopSearch(); ClearTT(); }
+        else if(cmd=="position"){ StopSearch(); CmdPosition(is); }
+        else if(cmd=="go") CmdGo(is);
+        else if(cmd=="stop") StopSearch();
+        else if(cmd=="ponderhit") PonderHit(uciCtx);
+        else if(cmd=="setoption") CmdSetOption(is);
+        else if(cmd=="quit") break;
+    }
+    StopSearch();
+    return 0;
+}
@@ -51,110 +51,189 @@ void CreateFonts(){
                          OUT_DEFAULT_PRECIS,CLIP_DEFAULT_PRECIS,DEFAULT_QUALITY,VARIABLE_PITCH,L"Segoe UI");
 }
 
-void DrawBoardAndUI(HDC hdcScreen){
-    RECT rc; 
+// ---------------- screen state ----------------
+// The window is drawn from two persistent buffers: a client-sized bitmap with the controls and
+// labels, and a DIB section holding the board, which the compositor (render.cpp) updates one
+// square at a time. WM_PAINT only copies the invalidated part of them to the screen.
+
+static HDC chromeDC = NULL, boardDC = NULL;
+static HBITMAP chromeBmp = NULL, boardBmp = NULL, chromeOld = NULL, boardOld = NULL;
+static uint32_t *boardBits = nullptr;
+static int chromeW = 0, chromeH = 0;
+static BoardRenderer rendererG;
+static int selX = -1, selY = -1;   // selected square, board coordinates
+static uint64_t selTargets = 0;    // its legal destinations, bit y*8+x
+
+static const RECT btnNew = {10,40,110,80}, btnUndo = {120,40,220,80}, btnAIToggle = {230,40,330,80},
+                  btnFlip = {340,40,440,80}, btnShow = {450,40,600,80};
+
+static RECT StatusRect(){ RECT r = {10, clientH-60, 300, clientH-20}; return r; }
+
+// glyph coverage masks, rendered once per square size with the glyph font
+static void BuildGlyphSprites(HDC ref){
+    int S = squareSize;
+    BITMAPINFO bmi = {};
+    bmi.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+    bmi.bmiHeader.biWidth = S;
+    bmi.bmiHeader.biHeight = -S; // top-down
+    bmi.bmiHeader.biPlanes = 1;
+    bmi.bmiHeader.biBitCount = 32;
+    bmi.bmiHeader.biCompression = BI_RGB;
+    void *bits = nullptr;
+    HDC dc = CreateCompatibleDC(ref);
+    HBITMAP bmp = CreateDIBSection(ref, &bmi, DIB_RGB_COLORS, &bits, NULL, 0);
+    if(!dc || !bmp){ if(bmp) DeleteObject(bmp); if(dc) DeleteDC(dc); return; }
+    HBITMAP oldBmp = (HBITMAP)SelectObject(dc, bmp);
+    HFONT oldFont = (HFONT)SelectObject(dc, glyphFont);
+    SetBkMode(dc, TRANSPARENT);
+    SetTextColor(dc, RGB(255,255,255));
+    RECT r = {0, 0, S, S};
+    for(int c=C_WHITE; c<=C_BLACK; c++) for(int t=PT_PAWN; t<=PT_KING; t++){
+        FillRect(dc, &r, (HBRUSH)GetStockObject(BLACK_BRUSH));
+        Piece p; p.type = (PieceType)t; p.color = (Color)c;
+        wchar_t g[2] = { Glyph(p), 0 };
+        DrawTextW(dc, g, 1, &r, DT_CENTER|DT_VCENTER|DT_SINGLELINE);
+        GdiFlush();
+        std::vector<uint8_t> mask((size_t)S*S);
+        const uint32_t *px = (const uint32_t*)bits;
+        for(size_t i=0; i<mask.size(); i++) mask[i] = (uint8_t)((px[i] >> 8) & 255);
+        SetPieceSprite(rendererG, (Color)c, (PieceType)t, mask);
+    }
+    SelectObject(dc, oldFont);
+    SelectObject(dc, oldBmp);
+    DeleteObject(bmp);
+    DeleteDC(dc);
+}
+
+// (re)creates the buffers when the client area or square size changed; true if it did
+static bool EnsureBuffers(){
+    RECT rc;
     GetClientRect(g_hwnd, &rc);
+    bool resized = !chromeDC || rc.right!=chromeW || rc.bottom!=chromeH;
+    bool rescaled = !boardDC || rendererG.squareSize!=squareSize;
+    if(!resized && !rescaled) return false;
+    HDC screen = GetDC(g_hwnd);
+    if(resized){
+        if(chromeDC){ SelectObject(chromeDC, chromeOld); DeleteObject(chromeBmp); DeleteDC(chromeDC); }
+        chromeW = std::max<int>(1, rc.right); chromeH = std::max<int>(1, rc.bottom);
+        chromeDC = CreateCompatibleDC(screen);
+        chromeBmp = CreateCompatibleBitmap(screen, chromeW, chromeH);
+        chromeOld = (HBITMAP)SelectObject(chromeDC, chromeBmp);
+    }
+    if(rescaled){
+        if(boardDC){ SelectObject(boardDC, boardOld); DeleteObject(boardBmp); DeleteDC(boardDC); }
+        ResetBoardRenderer(rendererG, squareSize);
+        BITMAPINFO bmi = {};
+        bmi.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+        bmi.bmiHeader.biWidth = 8*squareSize;
+        bmi.bmiHeader.biHeight = -8*squareSize;
+        bmi.bmiHeader.biPlanes = 1;
+        bmi.bmiHeader.biBitCount = 32;
+        bmi.bmiHeader.biCompression = BI_RGB;
+        void *bits = nullptr;
+        boardDC = CreateCompatibleDC(screen);
+        boardBmp = CreateDIBSection(screen, &bmi, DIB_RGB_COLORS, &bits, NULL, 0);
+        boardBits = (uint32_t*)bits;
+        boardOld = (HBITMAP)SelectObject(boardDC, boardBmp);
+        BuildGlyphSprites(screen);
+    }
+    ReleaseDC(g_hwnd, screen);
+    return true;
+}
 
-    // create memory DC for double buffering
-    HDC hdcMem = CreateCompatibleDC(hdcScreen);
-    HBITMAP hbmMem = CreateCompatibleBitmap(hdcScreen, rc.right, rc.bottom);
-    HBITMAP hOldBitmap = (HBITMAP)SelectObject(hdcMem, hbmMem);
+static void DrawStatus(){
+    RECT r = StatusRect();
+    FillRect(chromeDC, &r, (HBRUSH)GetStockObject(GRAY_BRUSH));
+    HFONT old = (HFONT)SelectObject(chromeDC, uiFont);
+    SetBkMode(chromeDC, TRANSPARENT);
+    SetTextColor(chromeDC, RGB(0,0,0));
+    std::wstring status = gameOverG ? L"Game Over" : (sideToMoveG==C_WHITE?L"White to move":L"Black to move");
+    DrawTextW(chromeDC, status.c_str(), -1, &r, DT_LEFT|DT_VCENTER|DT_SINGLELINE);
+    SelectObject(chromeDC, old);
+}
 
-    // fill background
-    FillRect(hdcMem, &rc, (HBRUSH)GetStockObject(GRAY_BRUSH));
+// background, title, buttons and labels
+static void DrawChrome(){
+    RECT rc = {0, 0, chromeW, chromeH};
+    FillRect(chromeDC, &rc, (HBRUSH)GetStockObject(GRAY_BRUSH));
 
     // compute board placement
-    int boardPixelW = squareSize * 8;
-    boardLeft = (rc.right - boardPixelW) / 2;
+    boardLeft = (chromeW - squareSize*8) / 2;
     boardTop = 120;
 
-    // title + controls at top
-    HFONT oldf = (HFONT)SelectObject(hdcMem, uiFont);
-    SetBkMode(hdcMem, TRANSPARENT);
+    HFONT oldf = (HFONT)SelectObject(chromeDC, uiFont);
+    SetBkMode(chromeDC, TRANSPARENT);
+    SetTextColor(chromeDC, RGB(0,0,0));
     std::wstring title = L"Chess — Full rules, AI & local play";
-    TextOutW(hdcMem, 10, 10, title.c_str(), (int)title.size());
-
-    // buttons: New, Undo, AI toggle, Flip, ShowLegal
-    RECT btnNew = {10,40,110,80}, btnUndo={120,40,220,80}, btnAIToggle={230,40,330,80},
-         btnFlip={340,40,440,80}, btnShow={450,40,600,80};
+    TextOutW(chromeDC, 10, 10, title.c_str(), (int)title.size());
 
     HBRUSH bbg = CreateSolidBrush(RGB(200,200,200));
-    FillRect(hdcMem, &btnNew, bbg); FillRect(hdcMem, &btnUndo, bbg);
-    FillRect(hdcMem, &btnAIToggle, bbg); FillRect(hdcMem, &btnFlip, bbg); FillRect(hdcMem, &btnShow, bbg);
+    for(const RECT *b : {&btnNew, &btnUndo, &btnAIToggle, &btnFlip, &btnShow}) FillRect(chromeDC, b, bbg);
     DeleteObject(bbg);
 
-    DrawTextW(hdcMem, L"New Game", -1, &btnNew, DT_CENTER|DT_VCENTER|DT_SINGLELINE);
-    DrawTextW(hdcMem, L"Undo", -1, &btnUndo, DT_CENTER|DT_VCENTER|DT_SINGLELINE);
-    DrawTextW(hdcMem, aiOnG ? L"AI: ON" : L"AI: OFF", -1, &btnAIToggle, DT_CENTER|DT_VCENTER|DT_SINGLELINE);
-    DrawTextW(hdcMem, flipBoardG ? L"Flip: ON" : L"Flip: OFF", -1, &btnFlip, DT_CENTER|DT_VCENTER|DT_SINGLELINE);
-    DrawTextW(hdcMem, showLegalG ? L"ShowMoves: ON" : L"ShowMoves: OFF", -1, &btnShow, DT_CENTER|DT_VCENTER|DT_SINGLELINE);
-
-    wchar_t depthBuf[64]; 
-    wsprintfW(depthBuf, L"AI depth: %d (use +/-)", aiDepthG);
-    TextOutW(hdcMem, 620, 50, depthBuf, lstrlenW(depthBuf));
-    SelectObject(hdcMem, oldf);
-
-    // draw board squares and pieces
-    for(int by=0; by<8; ++by){
-        for(int bx=0; bx<8; ++bx){
-            int x = bx, y = by;
-            if(flipBoardG){ x = 7-bx; y = 7-by; }
-
-            RECT r = { boardLeft + bx*squareSize, boardTop + by*squareSize,
-                       boardLeft + (bx+1)*squareSize, boardTop + (by+1)*squareSize };
-            bool light = ((x + y) & 1) == 0;
-            HBRUSH br = CreateSolidBrush(light ? RGB(240,217,181) : RGB(181,136,99));
-            FillRect(hdcMem, &r, br);
-            DeleteObject(br);
-
-            Piece p = boardG[y][x];
-            if(p.type != PT_NONE){
-                HFONT old = (HFONT)SelectObject(hdcMem, glyphFont);
-                SetBkMode(hdcMem, TRANSPARENT);
-                SetTextColor(hdcMem, p.color==C_WHITE?RGB(255,255,255):RGB(10,10,10));
-                wchar_t g[2] = { Glyph(p), 0 };
-                DrawTextW(hdcMem, g, 1, &r, DT_CENTER|DT_VCENTER|DT_SINGLELINE);
-                SelectObject(hdcMem, old);
-            }
-        }
-    }
+    RECT r;
+    r = btnNew; DrawTextW(chromeDC, L"New Game", -1, &r, DT_CENTER|DT_VCENTER|DT_SINGLELINE);
+    r = btnUndo; DrawTextW(chromeDC, L"Undo", -1, &r, DT_CENTER|DT_VCENTER|DT_SINGLELINE);
+    r = btnAIToggle; DrawTextW(chromeDC, aiOnG ? L"AI: ON" : L"AI: OFF", -1, &r, DT_CENTER|DT_VCENTER|DT_SINGLELINE);
+    r = btnFlip; DrawTextW(chromeDC, flipBoardG ? L"Flip: ON" : L"Flip: OFF", -1, &r, DT_CENTER|DT_VCENTER|DT_SINGLELINE);
+    r = btnShow; DrawTextW(chromeDC, showLegalG ? L"ShowMoves: ON" : L"ShowMoves: OFF", -1, &r, DT_CENTER|DT_VCENTER|DT_SINGLELINE);
+
+    wchar_t depthBuf[64];
+    wsprintfW(depthBuf, L"AI depth: %d (use +/-)   Ponder: %s", aiDepthG, ponderG ? L"ON" : L"OFF");
+    TextOutW(chromeDC, 620, 50, depthBuf, lstrlenW(depthBuf));
+    SelectObject(chromeDC, oldf);
+    DrawStatus();
+}
 
-    // highlight legal moves if requested
-    if(showLegalG){
-        LPARAM prop = (LPARAM)GetPropW(g_hwnd, L"SELECT");
-        if(prop){
-            int sel = (int)prop;
-            int selBX = (sel>>16)&0xFFFF, selBY = sel&0xFFFF;
-            Piece tmp[8][8]; CopyBoard(boardG,tmp);
-            auto all = GenerateLegalMoves(tmp, sideToMoveG, lastMoveG);
-            for(auto &m : all){
-                if(m.fx==selBX && m.fy==selBY){
-                    int tx=m.tx, ty=m.ty;
-                    if(flipBoardG){ tx = 7-tx; ty = 7-ty; }
-                    RECT r={ boardLeft + tx*squareSize, boardTop + ty*squareSize,
-                             boardLeft + (tx+1)*squareSize, boardTop + (ty+1)*squareSize };
-                    HBRUSH br = CreateSolidBrush(RGB(0,255,0));
-                    FrameRect(hdcMem, &r, br);
-                    DeleteObject(br);
-                }
-            }
-        }
+// Brings the buffers up to date with the game state and invalidates only what changed: the
+// board squares the compositor repainted, the status line, and everything when chrome is set.
+void RefreshView(bool chrome){
+    if(!g_hwnd) return;
+    if(EnsureBuffers()) chrome = true;
+    if(chrome){
+        DrawChrome();
+        rendererG.valid = false;
+        InvalidateRect(g_hwnd, NULL, FALSE);
+    } else {
+        DrawStatus();
+        RECT r = StatusRect();
+        InvalidateRect(g_hwnd, &r, FALSE);
     }
 
-    // game status
-    HFONT sf = (HFONT)SelectObject(hdcMem, uiFont);
-    std::wstring status = gameOverG ? L"Game Over" : (sideToMoveG==C_WHITE?L"White to move":L"Black to move");
-    RECT rStatus = {10, clientH-60, 300, clientH-20};
-    DrawTextW(hdcMem, status.c_str(), -1, &rStatus, DT_LEFT|DT_VCENTER|DT_SINGLELINE);
-    SelectObject(hdcMem, sf);
+    BoardView v;
+    CopyBoard(boardG, v.board);
+    v.flip = flipBoardG;
+    v.targets = showLegalG ? selTargets : 0;
+    std::vector<PixelRect> dirty;
+    RenderBoard(rendererG, v, dirty);
+    if(dirty.empty() || !boardBits) return;
+    GdiFlush();
+    int stride = 8*squareSize;
+    for(auto &d : dirty){
+        for(int y=d.y; y<d.y+d.h; y++)
+            std::memcpy(boardBits + (size_t)y*stride + d.x, &rendererG.pixels[(size_t)y*stride + d.x], d.w*sizeof(uint32_t));
+        RECT r = { boardLeft + d.x, boardTop + d.y, boardLeft + d.x + d.w, boardTop + d.y + d.h };
+        InvalidateRect(g_hwnd, &r, FALSE);
+    }
+}
 
-    // blit memory DC to screen (swap)
-    BitBlt(hdcScreen, 0, 0, rc.right, rc.bottom, hdcMem, 0, 0, SRCCOPY);
+// copies the invalid part of the buffers to the screen
+static void PaintWindow(HDC hdc, const RECT &clip){
+    if(!chromeDC) RefreshView(true);
+    if(!chromeDC) return;
+    BitBlt(hdc, clip.left, clip.top, clip.right-clip.left, clip.bottom-clip.top, chromeDC, clip.left, clip.top, SRCCOPY);
+    RECT board = { boardLeft, boardTop, boardLeft + 8*squareSize, boardTop + 8*squareSize }, part;
+    if(boardDC && IntersectRect(&part, &board, &clip))
+        BitBlt(hdc, part.left, part.top, part.right-part.left, part.bottom-part.top, boardDC, part.left-boardLeft, part.top-boardTop, SRCCOPY);
+}
 
-    // cleanup
-    SelectObject(hdcMem, hOldBitmap);
-    DeleteObject(hbmMem);
-    DeleteDC(hdcMem);
+// select (x,y) and collect its legal destinations, or clear the selection with x = -1
+static void Select(int x, int y){
+    selX = x; selY = y;
+    selTargets = 0;
+    if(x<0) return;
+    for(auto &m : GenerateLegalMoves(boardG, sideToMoveG, lastMoveG))
+        if(m.fx==x && m.fy==y) selTargets |= 1ULL << (m.ty*8 + m.tx);
 }
 
 // map mouse -> board coordinates considering flip
@@ -169,34 +248,53 @@ bool ScreenToBoard(int sx,int sy,int &bx,int &by){
 
 // basic UI actions
 void newGame(){
+	StopPonder();
 	InitStartingBoard();
-	undoStack.clear();
-	InvalidateRect(g_hwnd, NULL, TRUE);
+	ResetHistory(gameHistoryG, CurrentPosition());
+	Select(-1, -1);
+	RefreshView(false);
+}
+
+void undoMove(){
+	Select(-1, -1);
+	DoUndo();
+}
+
+void redoMove(){
+	Select(-1, -1);
+	DoRedo();
 }
 
 void flipBoard(){
 	flipBoardG = !flipBoardG; 
-	InvalidateRect(g_hwnd, NULL, TRUE);
+	RefreshView(true);
 }
 void flipSide(){
+	StopPonder();
 	flipBoardG = !flipBoardG; 
 	humanSide = humanSide==C_WHITE ? C_BLACK : C_WHITE;
-	InvalidateRect(g_hwnd, NULL, TRUE);
+	RefreshView(true);
 }
 
 void toggleAi(){
+	StopPonder();
 	aiOnG = !aiOnG;
-	InvalidateRect(g_hwnd, NULL, TRUE);
+	RefreshView(true);
 }
 
 void toggleShowLegal(){
 	showLegalG=!showLegalG;
-	InvalidateRect(g_hwnd, NULL, TRUE);
+	RefreshView(true);
+}
+
+void togglePonder(){
+	StopPonder();
+	ponderG = !ponderG;
+	RefreshView(true);
 }
 
 // main window proc
 LRESULT CALLBACK WndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam){
-    static int selX=-1, selY=-1;
     switch(msg){
         case WM_CREATE:
             return 0;
@@ -204,13 +302,12 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam){
             int mx = GET_X_LPARAM(lParam);
             int my = GET_Y_LPARAM(lParam);
             // top buttons area (quick hit test)
-            RECT rNew = {10,40,110,80}, rUndo={120,40,220,80}, rAI={230,40,330,80}, rFlip={340,40,440,80}, rShow={450,40,600,80};
             POINT pt = {mx,my};
-            if(PtInRect(&rNew, pt)){newGame();return 0;}
-			else if(PtInRect(&rUndo, pt)){DoUndo();return 0;}
-            else if(PtInRect(&rAI, pt)){toggleAi();return 0;}
-            else if(PtInRect(&rFlip, pt)){flipBoard();return 0;}
-            else if(PtInRect(&rShow, pt)){toggleShowLegal();return 0;}
+            if(PtInRect(&btnNew, pt)){newGame();return 0;}
+			else if(PtInRect(&btnUndo, pt)){undoMove();return 0;}
+            else if(PtInRect(&btnAIToggle, pt)){toggleAi();return 0;}
+            else if(PtInRect(&btnFlip, pt)){flipBoard();return 0;}
+            else if(PtInRect(&btnShow, pt)){toggleShowLegal();return 0;}
 
             // board click:
             int bx, by;
@@ -219,10 +316,8 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam){
             // if nothing selected, select piece if it belongs to user to move
             if(selX==-1){
                 if(boardG[by][bx].type!=PT_NONE && boardG[by][bx].color==sideToMoveG){
-                    selX = bx; selY = by;
-                    // store selection in window prop so drawing can highlight legal moves
-                    SetPropW(g_hwnd, L"SELECT", reinterpret_cast<HANDLE>(static_cast<intptr_t>((selX<<16) | (selY & 0xFFFF))));
-                    InvalidateRect(hWnd,NULL,TRUE);
+                    Select(bx, by);
+                    RefreshView(false);
                 }
             } else {
                 // attempt move from selX,selY -> bx,by
@@ -242,23 +337,14 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam){
                         PieceType chosen = ChoosePromotion(hWnd, boardG[candidate.fy][candidate.fx].color);
                         candidate.promoteTo = chosen;
                     }
-                    PushUndo();
-                    ApplyMoveGlobal(candidate);
-                    selX = selY = -1;
-                    RemovePropW(g_hwnd, L"SELECT");
-                    InvalidateRect(hWnd,NULL,TRUE);
+                    PlayMoveGlobal(candidate);
+                    Select(-1, -1);
+                    RefreshView(false);
                 } else {
                     // select new square if piece belongs to side
-                    if(boardG[by][bx].type!=PT_NONE && boardG[by][bx].color==sideToMoveG){
-                        selX = bx; selY = by;
-                        SetPropW(g_hwnd, L"SELECT", reinterpret_cast<HANDLE>(static_cast<intptr_t>((selX<<16) | (selY & 0xFFFF))));
-
-                        InvalidateRect(hWnd,NULL,TRUE);
-                    } else {
-                        selX = selY = -1;
-                        RemovePropW(g_hwnd, L"SELECT");
-                        InvalidateRect(hWnd,NULL,TRUE);
-                    }
+                    if(boardG[by][bx].type!=PT_NONE && boardG[by][bx].color==sideToMoveG) Select(bx, by);
+                    else Select(-1, -1);
+                    RefreshView(false);
                 }
             }
             return 0;
@@ -266,33 +352,41 @@ LRESULT CALLBACK WndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam){
 		case WM_COMMAND:
 			switch(LOWORD(wParam)) {
 				case ID_NEW_GAME: newGame(); break;
-				case ID_UNDO: DoUndo(); break;
+				case ID_UNDO: undoMove(); break;
+				case ID_REDO: redoMove(); break;
 				case ID_FLIP_BOARD: flipBoard(); break;
 				case ID_FLIP_SIDE: flipSide(); break;
 				case ID_TOGGLE_AI: toggleAi(); break;
 				case ID_SHOW_LEGAL: toggleShowLegal(); break;
+				case ID_TOGGLE_PONDER: togglePonder(); break;
 			}
 			break;
 
         case WM_KEYDOWN:
             if(wParam==VK_ESCAPE) PostQuitMessage(0);
-            else if(wParam==VK_OEM_PLUS || wParam==VK_ADD) { aiDepthG = std::min(6, aiDepthG+1); InvalidateRect(hWnd,NULL,TRUE); }
-            else if(wParam==VK_OEM_MINUS || wParam==VK_SUBTRACT) { aiDepthG = std::max(1, aiDepthG-1); InvalidateRect(hWnd,NULL,TRUE); }
-            else if(wParam=='U'){ DoUndo(); }
+            else if(wParam==VK_OEM_PLUS || wParam==VK_ADD) { aiDepthG = std::min(6, aiDepthG+1); RefreshView(true); }
+            else if(wParam==VK_OEM_MINUS || wParam==VK_SUBTRACT) { aiDepthG = std::max(1, aiDepthG-1); RefreshView(true); }
+            else if(wParam=='U' || wParam==VK_LEFT){ undoMove(); }
+            else if(wParam==VK_RIGHT){ redoMove(); }
+            else if(wParam==VK_HOME){ Select(-1, -1); JumpToPly(0); }
+            else if(wParam==VK_END){ Select(-1, -1); JumpToPly(gameHistoryG.plies.size()); }
 			else if(wParam=='C'){flipSide();}
 			else if(wParam=='F'){flipBoard();}
 			else if(wParam=='A'){toggleAi();}
+			else if(wParam=='P'){togglePonder();}
 			else if(wParam=='R'){newGame();}
             return 0;
         case WM_PAINT:{
 			PAINTSTRUCT ps; 
 			HDC hdc = BeginPaint(hWnd,&ps);
-			DrawBoardAndUI(hdc);
+			PaintWindow(hdc, ps.rcPaint);
 			EndPaint(hWnd,&ps);
 			return 0;
 		}
+		case WM_ERASEBKGND:
+			return 1; // every pixel comes from the buffers
 		case WM_SIZE:
-			InvalidateRect(hWnd,NULL,TRUE);
+			RefreshView(true);
 			return 0;
         case WM_DESTROY: PostQuitMessage(0); return 0;
     }
@@ -307,6 +401,7 @@ void CreateMainMenu(HWND hwnd) {
     // Game Menu Items
     AppendMenuW(hGame, MF_STRING, ID_NEW_GAME, L"New Game");
     AppendMenuW(hGame, MF_STRING, ID_UNDO, L"Undo");
+    AppendMenuW(hGame, MF_STRING, ID_REDO, L"Redo");
     AppendMenuW(hGame, MF_STRING, ID_EXIT, L"Exit");
 
     // Options Menu Items
@@ -314,6 +409,7 @@ void CreateMainMenu(HWND hwnd) {
 	AppendMenuW(hOptions, MF_STRING, ID_FLIP_SIDE, L"Flip Side");
     AppendMenuW(hOptions, MF_STRING, ID_TOGGLE_AI, L"Toggle AI");
     AppendMenuW(hOptions, MF_STRING, ID_SHOW_LEGAL, L"Show Legal Moves");
+    AppendMenuW(hOptions, MF_STRING, ID_TOGGLE_PONDER, L"Ponder");
     
     // Main Menu
     AppendMenuW(hMenu, MF_POPUP, (UINT_PTR)hGame, L"Game");
@@ -323,9 +419,16 @@ void CreateMainMenu(HWND hwnd) {
 }
 
 int WINAPI WinMain(HINSTANCE hInst, HINSTANCE, LPSTR, int){
+    int headless = RunHeadless(__argc, __argv);
+    if(headless >= 0) return headless;
     SetDPIAwareness();
     InitStartingBoard();
+    ResetHistory(gameHistoryG, CurrentPosition());
     CreateFonts();
+    OpenBook("book.bin"); // optional Polyglot book in the working directory
+    LoadEvalWeights("weights.txt", evalWeightsG); // optional tuned weights, likewise
+    SetNnue("nn.bin");                            // and an optional network
+    LoadBitbases(".");
 
     WNDCLASSW wc = {}; wc.lpfnWndProc = WndProc; wc.hInstance = hInst; wc.lpszClassName = L"ChessFullClass";
     wc.hCursor = LoadCursor(NULL, IDC_ARROW); RegisterClassW(&wc);
@@ -358,24 +461,40 @@ int WINAPI WinMain(HINSTANCE hInst, HINSTANCE, LPSTR, int){
 		if (!gameOverG){
 			Piece cur[8][8]; CopyBoard(boardG, cur);
 			auto legal = GenerateLegalMoves(cur, sideToMoveG, lastMoveG);
-			if(legal.empty() || halfmoveClock==100 || IsThreefoldRepetition(undoStack,boardG,sideToMoveG)){
+			if(legal.empty() || halfmoveClock==100 || IsRepetition(gameHistoryG, CurrentPosition())){
 				int kx, ky;
 				if(!FindKing(cur, sideToMoveG, kx, ky)) { MessageBoxW(g_hwnd, L" king not found", L"Error", MB_OK);}
 				else if(IsSquareAttacked(cur, kx, ky, Opp(sideToMoveG))){ MessageBoxW(g_hwnd, sideToMoveG==C_BLACK ? L"Checkmate: White wins":L"Checkmate: Black wins", L"Game Over", MB_OK);}
 				else { MessageBoxW(g_hwnd, L"Stalemate", L"Draw", MB_OK); }
 				gameOverG=true;
-				InvalidateRect(g_hwnd, NULL, TRUE);
+				RefreshView(false);
 				
 			}
 			else if(aiOnG && sideToMoveG!=humanSide){
-				
-				Move best = ChooseBestFromLegal(cur, Opp(humanSide), lastMoveG, aiDepthG);
+				// reuse the ponder search if the human played the expected reply
+				Position pos = CurrentPosition();
+				SearchResult res;
+				if(ProbeBook(pos, res.best)){
+					StopPonder(); // still in book: nothing to search
+				}
+				else if(!TakePonderResult(pos, res)){
+					SearchContext ctx;
+					SearchLimits limits;
+					limits.depth = aiDepthG;
+					PrepareSearch(ctx, limits);
+					res = Think(ctx, pos);
+				}
+				Move best = res.best;
 				if(best.fx!=-1){
-					PushUndo();
-				
 					if(cur[best.fy][best.fx].type==PT_PAWN && (best.ty==0 || best.ty==7)) best.promoteTo = PT_QUEEN;
-					ApplyMoveGlobal(best);
-					InvalidateRect(g_hwnd, NULL, TRUE);
+					PlayMoveGlobal(best);
+					Select(-1, -1);
+					RefreshView(false);
+					// think on the human's time about the reply the search expects
+					if(ponderG && res.ponder.fx!=-1){
+						ApplyMove(pos, best);
+						StartPonder(pos, res.ponder, aiDepthG);
+					}
 				}
 				
 			}
@@ -389,5 +508,6 @@ int WINAPI WinMain(HINSTANCE hInst, HINSTANCE, LPSTR, int){
         }
     }
 
+    StopPonder();
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,133 @@
+#include "chess.h"
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+// Evaluation weights: the hand-written defaults, and a plain-text file format the tuner writes
+// and the engine loads. A file lists "piece" (seven values by PieceType), "mobility" and
+// "pst <piece>" (64 values, a8 first, from White's side); missing entries keep their default.
+
+static const int DEFAULT_PIECE[7] = { 0, 100, 320, 330, 500, 900, 20000 };
+
+// Piece-square tables (from white's perspective). Mirror for black in evaluation.
+static const int DEFAULT_PST[7][8][8] = {
+    {}, // PT_NONE
+    { // pawn
+    {  0,  0,  0,  0,  0,  0,  0,  0},
+    { 50, 50, 50, 50, 50, 50, 50, 50},
+    { 10, 10, 20, 30, 30, 20, 10, 10},
+    {  5,  5, 10, 25, 25, 10,  5,  5},
+    {  0,  0,  0, 20, 20,  0,  0,  0},
+    {  5, -5,-10,  0,  0,-10, -5,  5},
+    {  5, 10, 10,-20,-20, 10, 10,  5},
+    {  0,  0,  0,  0,  0,  0,  0,  0}
+    },
+    { // knight
+    {-50,-40,-30,-30,-30,-30,-40,-50},
+    {-40,-20,  0,  0,  0,  0,-20,-40},
+    {-30,  0, 10, 15, 15, 10,  0,-30},
+    {-30,  5, 15, 20, 20, 15,  5,-30},
+    {-30,  0, 15, 20, 20, 15,  0,-30},
+    {-30,  5, 10, 15, 15, 10,  5,-30},
+    {-40,-20,  0,  5,  5,  0,-20,-40},
+    {-50,-40,-30,-30,-30,-30,-40,-50}
+    },
+    { // bishop
+    {-20,-10,-10,-10,-10,-10,-10,-20},
+    {-10,  0,  0,  0,  0,  0,  0,-10},
+    {-10,  0,  5, 10, 10,  5,  0,-10},
+    {-10,  5,  5, 10, 10,  5,  5,-10},
+    {-10,  0, 10, 10, 10, 10,  0,-10},
+    {-10, 10, 10, 10, 10, 10, 10,-10},
+    {-10,  5,  0,  0,  0,  0,  5,-10},
+    {-20,-10,-10,-10,-10,-10,-10,-20}
+    },
+    { // rook
+    {  0,  0,  0,  5,  5,  0,  0,  0},
+    {-5,  0,  0,  0,  0,  0,  0, -5},
+    {-5,  0,  0,  0,  0,  0,  0, -5},
+    {-5,  0,  0,  0,  0,  0,  0, -5},
+    {-5,  0,  0,  0,  0,  0,  0, -5},
+    {-5,  0,  0,  0,  0,  0,  0, -5},
+    {  5, 10, 10, 10, 10, 10, 10,  5},
+    {  0,  0,  0,  0,  0,  0,  0,  0}
+    },
+    { // queen
+    {-20,-10,-10, -5, -5,-10,-10,-20},
+    {-10,  0,  0,  0,  0,  0,  0,-10},
+    {-10,  0,  5,  5,  5,  5,  0,-10},
+    { -5,  0,  5,  5,  5,  5,  0, -5},
+    {  0,  0,  5,  5,  5,  5,  0, -5},
+    {-10,  5,  5,  5,  5,  5,  0,-10},
+    {-10,  0,  5,  0,  0,  0,  0,-10},
+    {-20,-10,-10, -5, -5,-10,-10,-20}
+    },
+    { // king
+    {-30,-40,-40,-50,-50,-40,-40,-30},
+    {-30,-40,-40,-50,-50,-40,-40,-30},
+    {-30,-40,-40,-50,-50,-40,-40,-30},
+    {-30,-40,-40,-50,-50,-40,-40,-30},
+    {-20,-30,-30,-40,-40,-30,-30,-20},
+    {-10,-20,-20,-20,-20,-20,-20,-10},
+    { 20, 20,  0,  0,  0,  0, 20, 20},
+    { 20, 30, 10,  0,  0, 10, 30, 20}
+    }
+};
+
+static const char *PIECE_NAMES[7] = { "none", "pawn", "knight", "bishop", "rook", "queen", "king" };
+
+EvalWeights DefaultEvalWeights(){
+    EvalWeights w;
+    std::memcpy(w.piece, DEFAULT_PIECE, sizeof(w.piece));
+    std::memcpy(w.pst, DEFAULT_PST, sizeof(w.pst));
+    w.mobility = 4;
+    return w;
+}
+
+EvalWeights evalWeightsG = DefaultEvalWeights();
+
+int &EvalParam(EvalWeights &w, int i){
+    if(i < PST_PARAM) return w.piece[i];
+    if(i < MOBILITY_PARAM){ i -= PST_PARAM; return w.pst[i/64][i/8%8][i%8]; }
+    return w.mobility;
+}
+
+bool LoadEvalWeights(const std::string &path, EvalWeights &out){
+    std::ifstream in(path);
+    if(!in) return false;
+    EvalWeights w = out;
+    std::string line;
+    while(std::getline(in, line)){
+        std::istringstream is(line);
+        std::string key;
+        if(!(is >> key) || key[0]=='#') continue;
+        bool ok = true;
+        if(key=="piece") for(int t=0;t<7;t++) ok = ok && (is >> w.piece[t]);
+        else if(key=="mobility") ok = (bool)(is >> w.mobility);
+        else if(key=="pst"){
+            std::string name;
+            is >> name;
+            int t = (int)(std::find(PIECE_NAMES, PIECE_NAMES+7, name) - PIECE_NAMES);
+            ok = t>0 && t<7;
+            for(int s=0; ok && s<64; s++) ok = (bool)(is >> w.pst[t][s/8][s%8]);
+        }
+        else ok = false;
+        if(!ok) return false;
+    }
+    out = w;
+    return true;
+}
+
+bool SaveEvalWeights(const std::string &path, const EvalWeights &w){
+    FILE *f = std::fopen(path.c_str(), "w");
+    if(!f) return false;
+    std::fprintf(f, "# evaluation weights (centipawns)\npiece");
+    for(int t=0;t<7;t++) std::fprintf(f, " %d", w.piece[t]);
+    std::fprintf(f, "\nmobility %d\n", w.mobility);
+    for(int t=1;t<7;t++){
+        std::fprintf(f, "pst %s", PIECE_NAMES[t]);
+        for(int s=0;s<64;s++) std::fprintf(f, " %d", w.pst[t][s/8][s%8]);
+        std::fprintf(f, "\n");
+    }
+    return std::fclose(f)==0;
+}